@@ -1447,6 +1447,123 @@ quant_paletted(i_quantize *quant, i_img *img) {
   return data;
 }
 
+/*
+=item gif_delta_ok(imgs, localmaps, imgn)
+
+Tests whether image I<imgn> can be written as only the rectangle that
+changed since the previous image.
+
+Both images must use the global map, have the same size, channels
+and position, and both must leave their pixels in place when they're
+replaced.
+
+=cut
+*/
+
+static int
+gif_delta_ok(i_img **imgs, int *localmaps, int imgn) {
+  i_img *img = imgs[imgn];
+  i_img *prev = imgs[imgn-1];
+  int delta, disposal, left, top, prev_left, prev_top;
+
+  if (!i_tags_get_int(&img->tags, "gif_delta", 0, &delta) || !delta)
+    return 0;
+  if (localmaps[imgn] || localmaps[imgn-1])
+    return 0;
+  if (img->xsize != prev->xsize || img->ysize != prev->ysize
+      || img->channels != prev->channels)
+    return 0;
+  if (!i_tags_get_int(&img->tags, "gif_left", 0, &left))
+    left = 0;
+  if (!i_tags_get_int(&img->tags, "gif_top", 0, &top))
+    top = 0;
+  if (!i_tags_get_int(&prev->tags, "gif_left", 0, &prev_left))
+    prev_left = 0;
+  if (!i_tags_get_int(&prev->tags, "gif_top", 0, &prev_top))
+    prev_top = 0;
+  if (left != prev_left || top != prev_top)
+    return 0;
+  if (!i_tags_get_int(&prev->tags, "gif_disposal", 0, &disposal))
+    disposal = 0;
+  if (disposal != 0 && disposal != 1)
+    return 0;
+  /* restoring only the rectangle to the background would leave the
+     rest of the frame showing under the next frame */
+  if (!i_tags_get_int(&img->tags, "gif_disposal", 0, &disposal))
+    disposal = 0;
+
+  return disposal == 0 || disposal == 1;
+}
+
+/*
+=item gif_delta_image(prev, img, &left, &top)
+
+Returns a new image holding the smallest rectangle of I<img> that
+differs from I<prev>, setting I<left> and I<top> to its position
+within I<img>.
+
+Returns NULL if the rectangle is the whole image, so the image should
+be written as is.  If nothing changed a single pixel is returned,
+since each GIF frame needs at least one.
+
+=cut
+*/
+
+static i_img *
+gif_delta_image(i_img *prev, i_img *img, i_img_dim *left, i_img_dim *top) {
+  i_img_dim l = img->xsize, r = 0, t = img->ysize, b = 0;
+  i_img_dim x, y;
+  int chans = img->channels;
+  size_t row_size = sizeof(i_sample_t) * img->xsize * chans;
+  i_sample_t *prev_row = mymalloc(row_size);
+  i_sample_t *row = mymalloc(row_size);
+  i_img *delta;
+
+  for (y = 0; y < img->ysize; ++y) {
+    i_gsamp(prev, 0, prev->xsize, y, prev_row, NULL, chans);
+    i_gsamp(img, 0, img->xsize, y, row, NULL, chans);
+    if (memcmp(prev_row, row, row_size) == 0)
+      continue;
+    if (y < t)
+      t = y;
+    b = y + 1;
+    x = 0;
+    while (x < l && memcmp(prev_row + x * chans, row + x * chans,
+			   sizeof(i_sample_t) * chans) == 0)
+      ++x;
+    if (x < l)
+      l = x;
+    x = img->xsize;
+    while (x > r && memcmp(prev_row + (x - 1) * chans, row + (x - 1) * chans,
+			   sizeof(i_sample_t) * chans) == 0)
+      --x;
+    if (x > r)
+      r = x;
+  }
+  myfree(prev_row);
+  myfree(row);
+
+  if (b == 0) {
+    /* nothing changed */
+    l = t = 0;
+    r = b = 1;
+  }
+  if (l == 0 && t == 0 && r == img->xsize && b == img->ysize)
+    return NULL;
+
+  delta = i_sametype(img, r - l, b - t);
+  if (!delta)
+    return NULL;
+  i_copyto(delta, img, l, t, r, b, 0, 0);
+  *left = l;
+  *top = t;
+
+  mm_log((1, "  delta rectangle (" i_DFp ") - (" i_DFp ")\n",
+	  i_DFcp(l, t), i_DFcp(r, b)));
+
+  return delta;
+}
+
 /*
 =item i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count, i_gif_opts *opts)
 
@@ -1481,6 +1598,9 @@ i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count) {
   int interlace;
   int gif_background;
   int error;
+  i_img *frame; /* the image or part of the image being written */
+  i_img *delta = NULL; /* the changed part of the image */
+  i_img_dim delta_x, delta_y;
 
   mm_log((1, "i_writegif_low(quant %p, gf  %p, imgs %p, count %d)\n", 
 	  quant, gf, imgs, count));
@@ -1701,6 +1821,7 @@ i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count) {
 
   /* that first awful image is out of the way, do the rest */
   for (imgn = 1; imgn < count; ++imgn) {
+    frame = imgs[imgn];
     if (localmaps[imgn]) {
       quant->mc_colors = orig_colors;
       quant->mc_count = orig_count;
@@ -1740,13 +1861,22 @@ i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count) {
     else {
       quant->mc_colors = glob_colors;
       quant->mc_count = glob_color_count;
+      /* only the changed part of the frame needs translating */
+      if (!glob_paletted && gif_delta_ok(imgs, localmaps, imgn))
+        delta = gif_delta_image(imgs[imgn-1], imgs[imgn], &delta_x, &delta_y);
+      if (delta)
+        frame = delta;
       if (glob_paletted)
-        result = quant_paletted(quant, imgs[imgn]);
+        result = quant_paletted(quant, frame);
       else
-        result = i_quant_translate(quant, imgs[imgn]);
+        result = i_quant_translate(quant, frame);
+      if (!result) {
+        mm_log((1, "error in i_quant_translate()"));
+        goto fail_cleanup;
+      }
       want_trans = glob_want_trans && imgs[imgn]->channels == 4;
       if (want_trans) {
-        i_quant_transparent(quant, result, imgs[imgn], quant->mc_count);
+        i_quant_transparent(quant, result, frame, quant->mc_count);
         trans_index = quant->mc_count;
       }
       map = NULL;
@@ -1764,11 +1894,15 @@ i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count) {
       posx = 0;
     if (!i_tags_get_int(&imgs[imgn]->tags, "gif_top", 0, &posy))
       posy = 0;
+    if (delta) {
+      posx += delta_x;
+      posy += delta_y;
+    }
 
     if (!i_tags_get_int(&imgs[imgn]->tags, "gif_interlace", 0, &interlace))
       interlace = 0;
-    if (EGifPutImageDesc(gf, posx, posy, imgs[imgn]->xsize, 
-                         imgs[imgn]->ysize, interlace, map) == GIF_ERROR) {
+    if (EGifPutImageDesc(gf, posx, posy, frame->xsize, 
+                         frame->ysize, interlace, map) == GIF_ERROR) {
       gif_push_error(myGifError(gf));
       i_push_error(0, "Could not save image descriptor");
       if (map)
@@ -1779,11 +1913,15 @@ i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count) {
     if (map)
       FreeMapObject(map);
     
-    if (!do_write(gf, interlace, imgs[imgn], result)) {
+    if (!do_write(gf, interlace, frame, result)) {
       goto fail_cleanup;
     }
     myfree(result);
     result = NULL;
+    if (delta) {
+      i_img_destroy(delta);
+      delta = NULL;
+    }
   }
 
   if (myEGifCloseFile(gf, &error) == GIF_ERROR) {
@@ -1806,6 +1944,8 @@ i_writegif_low(i_quantize *quant, GifFileType *gf, i_img **imgs, int count) {
 
  fail_cleanup:
   quant->mc_colors = orig_colors;
+  if (delta)
+    i_img_destroy(delta);
   myfree(result);
   myfree(glob_colors);
   myfree(localmaps);
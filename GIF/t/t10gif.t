@@ -14,7 +14,7 @@ use strict;
 $|=1;
 use Test::More;
 use Imager qw(:all);
-use Imager::Test qw(is_color3 test_image test_image_raw test_image_mono);
+use Imager::Test qw(is_color3 is_image test_image test_image_raw test_image_mono);
 use Imager::File::GIF;
 
 use Carp 'confess';
@@ -24,7 +24,7 @@ $SIG{__DIE__} = sub { confess @_ };
 
 init_log("testout/t105gif.log",1);
 
-plan tests => 146;
+plan tests => 163;
 
 my $green=i_color_new(0,255,0,255);
 my $blue=i_color_new(0,0,255,255);
@@ -717,6 +717,69 @@ SKIP:
      "check second gif_top");
 }
 
+{
+  # gif_delta writes only the changed part of each frame
+  my $im1 = Imager->new(xsize => 40, ysize => 30);
+  $im1->box(filled => 1, color => "#0000FF");
+  my $im2 = $im1->copy;
+  $im2->box(filled => 1, color => "#FF0000", xmin => 10, ymin => 5,
+	    xmax => 19, ymax => 14);
+  my $im3 = $im2->copy;
+  $_->settag(name => "gif_delta", value => 1) for $im2, $im3;
+
+  my $data;
+  ok(Imager->write_multi({ data => \$data, type => 'gif',
+			   make_colors => 'webmap', translate => 'closest' },
+			 $im1, $im2, $im3),
+     "write with gif_delta")
+    or print "# ", Imager->errstr, "\n";
+  my @result = Imager->read_multi(data => $data);
+  is(@result, 3, "got 3 images back");
+  is($result[1]->tags(name => 'gif_left'), 10, "changed frame left");
+  is($result[1]->tags(name => 'gif_top'), 5, "changed frame top");
+  is($result[1]->getwidth, 10, "changed frame width");
+  is($result[1]->getheight, 10, "changed frame height");
+  is($result[2]->getwidth, 1, "unchanged frame width");
+  is($result[2]->getheight, 1, "unchanged frame height");
+  is_image($result[1]->to_rgb8,
+	   $im2->crop(left => 10, top => 5, width => 10, height => 10),
+	   "changed frame content");
+  is_color3($result[2]->getpixel(x => 0, y => 0), 0, 0, 255,
+	    "unchanged frame content");
+}
+
+{
+  # a frame restored to the background after display is written
+  # whole, or the transparent pixels of the next frame would show the
+  # old content outside the changed rectangle
+  my $im1 = Imager->new(xsize => 40, ysize => 30, channels => 4);
+  $im1->box(filled => 1, color => "#0000FF");
+  my $im2 = $im1->copy;
+  $im2->box(filled => 1, color => "#FF0000", xmin => 10, ymin => 5,
+	    xmax => 19, ymax => 14);
+  $im2->settag(name => "gif_disposal", value => 2);
+  my $im3 = Imager->new(xsize => 40, ysize => 30, channels => 4);
+  $im3->box(filled => 1, color => "#FF0000", xmin => 10, ymin => 5,
+	    xmax => 19, ymax => 14);
+  $_->settag(name => "gif_delta", value => 1) for $im2, $im3;
+
+  my $data;
+  ok(Imager->write_multi({ data => \$data, type => 'gif',
+			   make_colors => 'webmap', translate => 'closest',
+			   transp => 'threshold' },
+			 $im1, $im2, $im3),
+     "write gif_delta with disposal 2")
+    or print "# ", Imager->errstr, "\n";
+  my @result = Imager->read_multi(data => $data);
+  is(@result, 3, "got 3 images back");
+  is($result[1]->tags(name => 'gif_disposal'), 2, "check disposal");
+  is($result[1]->getwidth, 40, "disposal 2 frame written whole");
+  is($result[1]->getheight, 30, "disposal 2 frame written whole (height)");
+  is($result[2]->getwidth, 40, "frame after disposal 2 written whole");
+  is($result[2]->getpixel(x => 0, y => 0)->alpha, 0,
+     "transparent pixel kept");
+}
+
 { # test colors array returns colors
   my $data;
   my $im = test_image();
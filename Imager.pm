@@ -289,13 +289,39 @@ BEGIN {
     };
   $filters{gaussian} = {
                         callseq => [ 'image', 'stddev' ],
-                        defaults => { },
-                        callsub => sub { my %hsh = @_; i_gaussian($hsh{image}, $hsh{stddev}); },
+                        defaults => { method => "exact" },
+                        callsub =>
+                        sub {
+                          my %hsh = @_;
+                          if ($hsh{method} eq "box") {
+                            i_gaussian2_box($hsh{image}, $hsh{stddev}, $hsh{stddev})
+                              or die Imager->_error_as_msg() . "\n";
+                          }
+                          elsif ($hsh{method} eq "exact") {
+                            i_gaussian($hsh{image}, $hsh{stddev});
+                          }
+                          else {
+                            die "gaussian: method must be exact or box\n";
+                          }
+                        },
                        };
   $filters{gaussian2} = {
                         callseq => [ 'image', 'stddevX', 'stddevY' ],
-                        defaults => { },
-                        callsub => sub { my %hsh = @_; i_gaussian2($hsh{image}, $hsh{stddevX}, $hsh{stddevY}); },
+                        defaults => { method => "exact" },
+                        callsub =>
+                        sub {
+                          my %hsh = @_;
+                          if ($hsh{method} eq "box") {
+                            i_gaussian2_box($hsh{image}, $hsh{stddevX}, $hsh{stddevY})
+                              or die Imager->_error_as_msg() . "\n";
+                          }
+                          elsif ($hsh{method} eq "exact") {
+                            i_gaussian2($hsh{image}, $hsh{stddevX}, $hsh{stddevY});
+                          }
+                          else {
+                            die "gaussian2: method must be exact or box\n";
+                          }
+                        },
                        };
   $filters{mosaic} =
     {
@@ -964,7 +990,42 @@ sub img_set {
     }
   }
 
-  if ($hsh{type} eq 'paletted' || $hsh{type} eq 'pseudo') {
+  if ($hsh{tiled}) {
+    if ($hsh{type} ne 'direct') {
+      $self->_set_error("new: tiled images must be direct images");
+      return;
+    }
+    my $bits = $hsh{bits} eq 'double' ? length(pack("d", 1)) * 8 : $hsh{bits};
+    if (defined $hsh{bg}) {
+      my $bg = _color($hsh{bg});
+      unless ($bg) {
+        $self->_set_error("new: bg: $Imager::ERRSTR");
+        return;
+      }
+      unless ($bg->isa("Imager::Color::Float")) {
+        require Imager::Color::Float;
+        $bg = Imager::Color::Float->new(map $_ / 255, $bg->rgba);
+      }
+      $self->{IMG} = i_img_tiled_new($hsh{xsize}, $hsh{ysize},
+                                     $hsh{channels}, $bits, $bg);
+    }
+    else {
+      $self->{IMG} = i_img_tiled_new($hsh{xsize}, $hsh{ysize},
+                                     $hsh{channels}, $bits);
+    }
+  }
+  elsif ($hsh{mmap} || defined $hsh{mmap_file}) {
+    if ($hsh{type} ne 'direct') {
+      $self->_set_error("new: mmap images must be direct images");
+      return;
+    }
+    my $bits = $hsh{bits} eq 'double' ? length(pack("d", 1)) * 8 : $hsh{bits};
+    $self->{IMG} = i_img_mmap_new($hsh{mmap_file}, $hsh{xsize}, $hsh{ysize},
+                                  $hsh{channels}, $bits,
+                                  _first($hsh{mmap_mode}, "create"),
+                                  _first($hsh{mmap_offset}, 0));
+  }
+  elsif ($hsh{type} eq 'paletted' || $hsh{type} eq 'pseudo') {
     $self->{IMG} = i_img_pal_new($hsh{xsize}, $hsh{ysize}, $hsh{channels},
                                  $hsh{maxcolors} || 256);
   }
@@ -1267,6 +1328,20 @@ sub virtual {
   return i_img_virtual($self->{IMG});
 }
 
+sub mmap_flush {
+  my $self = shift;
+
+  $self->_valid_image("mmap_flush")
+    or return;
+
+  unless (i_img_mmap_flush($self->{IMG})) {
+    $self->_set_error("mmap_flush: " . $self->_error_as_msg);
+    return;
+  }
+
+  return $self;
+}
+
 sub is_bilevel {
   my ($self) = @_;
 
@@ -1411,14 +1486,14 @@ sub _get_reader_io {
     return $input->{io}, undef;
   }
   elsif ($input->{fd}) {
-    return io_new_fd($input->{fd});
+    return $self->_io_buffer_size($input, io_new_fd($input->{fd}));
   }
   elsif ($input->{fh}) {
     unless (Scalar::Util::openhandle($input->{fh})) {
       $self->_set_error("Handle in fh option not opened");
       return;
     }
-    return Imager::IO->new_fh($input->{fh});
+    return $self->_io_buffer_size($input, Imager::IO->new_fh($input->{fh}));
   }
   elsif ($input->{file}) {
     my $file = IO::File->new($input->{file}, "r");
@@ -1427,7 +1502,12 @@ sub _get_reader_io {
       return;
     }
     binmode $file;
-    return (io_new_fd(fileno($file)), $file);
+    if ($input->{mmap}) {
+      # map the file if we can, otherwise read it normally
+      my $io = io_new_mmap(fileno($file));
+      $io and return ($io, $file);
+    }
+    return $self->_io_buffer_size($input, io_new_fd(fileno($file)), $file);
   }
   elsif ($input->{data}) {
     return io_new_buffer($input->{data});
@@ -1437,15 +1517,19 @@ sub _get_reader_io {
       $self->_set_error("Need a seekcb parameter");
     }
     if ($input->{maxbuffer}) {
-      return io_new_cb($input->{writecb},
-                       $input->{callback} || $input->{readcb},
-                       $input->{seekcb}, $input->{closecb},
-                       $input->{maxbuffer});
+      return $self->_io_buffer_size
+	($input,
+	 io_new_cb($input->{writecb},
+		   $input->{callback} || $input->{readcb},
+		   $input->{seekcb}, $input->{closecb},
+		   $input->{maxbuffer}));
     }
     else {
-      return io_new_cb($input->{writecb},
-                       $input->{callback} || $input->{readcb},
-                       $input->{seekcb}, $input->{closecb});
+      return $self->_io_buffer_size
+	($input,
+	 io_new_cb($input->{writecb},
+		   $input->{callback} || $input->{readcb},
+		   $input->{seekcb}, $input->{closecb}));
     }
   }
   else {
@@ -1454,6 +1538,24 @@ sub _get_reader_io {
   }
 }
 
+# apply the buffer_size and max_buffer_size parameters to a new I/O
+# layer
+sub _io_buffer_size {
+  my ($self, $input, $io, @extras) = @_;
+
+  $io or return;
+
+  if ($input->{buffer_size} || $input->{max_buffer_size}) {
+    my $size = $input->{buffer_size} || ($io->buffer_size)[0];
+    unless ($io->set_buffer_size($size, $input->{max_buffer_size} || 0)) {
+      $self->_set_error($self->_error_as_msg);
+      return;
+    }
+  }
+
+  return ($io, @extras);
+}
+
 sub _get_writer_io {
   my ($self, $input) = @_;
 
@@ -1504,7 +1606,11 @@ sub _get_writer_io {
     $io->set_buffered(0);
   }
 
-  return ($io, @extras);
+  if ($input->{io}) {
+    return ($io, @extras);
+  }
+
+  return $self->_io_buffer_size($input, $io, @extras);
 }
 
 sub _test_format {
@@ -1634,6 +1740,90 @@ sub read {
   return $self;
 }
 
+# read an image as a stream of rows
+sub read_rows {
+  my ($class, %input) = @_;
+
+  require Imager::RowSource;
+
+  my ($IO, $fh) = $class->_get_reader_io(\%input) or return;
+
+  my $type = $input{'type'};
+  unless ($type) {
+    $type = _test_format($IO);
+  }
+
+  if ($input{file} && !$type) {
+    # guess the type 
+    $type = $FORMATGUESS->($input{file});
+  }
+
+  unless ($type) {
+    my $msg = "type parameter missing and it couldn't be determined from the file contents";
+    $input{file} and $msg .= " or file name";
+    $class->_set_error($msg);
+    return;
+  }
+
+  _reader_autoload($type);
+
+  my $raw;
+  if ($readers{$type} && $readers{$type}{rows}) {
+    $raw = $readers{$type}{rows}->($IO, %input);
+  }
+  elsif ($type eq 'pnm') {
+    $raw = i_readpnm_rows_wiol($IO);
+  }
+  else {
+    $class->_set_error("format '$type' can't be read as rows");
+    return;
+  }
+  unless ($raw) {
+    $class->_set_error($class->_error_as_msg);
+    return;
+  }
+
+  return Imager::RowSource->_new($raw, $IO, $fh);
+}
+
+# create a row sink for Imager::RowSource->write()
+sub _row_sink {
+  my ($class, $xsize, $ysize, $channels, %input) = @_;
+
+  my $type = $input{'type'};
+  if (!$type and $input{file}) { 
+    $type = $FORMATGUESS->($input{file});
+  }
+  unless ($type) { 
+    $class->_set_error('type parameter missing and not possible to guess from extension');
+    return;
+  }
+
+  _writer_autoload($type);
+
+  unless ($writers{$type} && $writers{$type}{rows} || $type eq 'pnm') {
+    $class->_set_error("format '$type' can't be written as rows");
+    return;
+  }
+
+  my ($IO, @extras) = $class->_get_writer_io(\%input)
+    or return;
+
+  my $sink;
+  if ($writers{$type} && $writers{$type}{rows}) {
+    $sink = $writers{$type}{rows}->($IO, $xsize, $ysize, $channels, %input);
+  }
+  else {
+    $sink = i_writepnm_rows_wiol($IO, $xsize, $ysize, $channels);
+  }
+  unless ($sink) {
+    $class->_set_error($class->_error_as_msg);
+    return;
+  }
+
+  return ($sink, $IO, @extras);
+}
+
 sub register_reader {
   my ($class, %opts) = @_;
 
@@ -1652,6 +1842,9 @@ sub register_reader {
   if ($opts{multiple}) {
     $readers{$type}{multiple} = $opts{multiple};
   }
+  if ($opts{rows}) {
+    $readers{$type}{rows} = $opts{rows};
+  }
 
   return 1;
 }
@@ -1674,6 +1867,9 @@ sub register_writer {
   if ($opts{multiple}) {
     $writers{$type}{multiple} = $opts{multiple};
   }
+  if ($opts{rows}) {
+    $writers{$type}{rows} = $opts{rows};
+  }
 
   return 1;
 }
@@ -3743,50 +3939,43 @@ sub _identity {
 }
 
 # general function to convert an image
-sub convert {
-  my ($self, %opts) = @_;
+# work out the convert() matrix for an image or row source with
+# $channels channels
+sub _convert_matrix {
+  my ($self, $channels, %opts) = @_;
   my $matrix;
 
-  $self->_valid_image("convert")
-    or return;
-
-  unless (defined wantarray) {
-    my @caller = caller;
-    warn "convert() called in void context - convert() returns the converted image at $caller[1] line $caller[2]\n";
-    return;
-  }
-
   # the user can either specify a matrix or preset
   # the matrix overrides the preset
   if (!exists($opts{matrix})) {
     unless (exists($opts{preset})) {
-      $self->{ERRSTR} = "convert() needs a matrix or preset";
+      $self->_set_error("convert() needs a matrix or preset");
       return;
     }
     else {
       if ($opts{preset} eq 'gray' || $opts{preset} eq 'grey') {
 	# convert to greyscale, keeping the alpha channel if any
-	if ($self->getchannels == 3) {
+	if ($channels == 3) {
 	  $matrix = [ [ 0.222, 0.707, 0.071 ] ];
 	}
-	elsif ($self->getchannels == 4) {
+	elsif ($channels == 4) {
 	  # preserve the alpha channel
 	  $matrix = [ [ 0.222, 0.707, 0.071, 0 ],
 		      [ 0,     0,     0,     1 ] ];
 	}
 	else {
 	  # an identity
-	  $matrix = _identity($self->getchannels);
+	  $matrix = _identity($channels);
 	}
       }
       elsif ($opts{preset} eq 'noalpha') {
 	# strip the alpha channel
-	if ($self->getchannels == 2 or $self->getchannels == 4) {
-	  $matrix = _identity($self->getchannels);
+	if ($channels == 2 or $channels == 4) {
+	  $matrix = _identity($channels);
 	  pop(@$matrix); # lose the alpha entry
 	}
 	else {
-	  $matrix = _identity($self->getchannels);
+	  $matrix = _identity($channels);
 	}
       }
       elsif ($opts{preset} eq 'red' || $opts{preset} eq 'channel0') {
@@ -3800,40 +3989,40 @@ sub convert {
 	$matrix = [ [ 0, 0, 1 ] ];
       }
       elsif ($opts{preset} eq 'alpha') {
-	if ($self->getchannels == 2 or $self->getchannels == 4) {
-	  $matrix = [ [ (0) x ($self->getchannels-1), 1 ] ];
+	if ($channels == 2 or $channels == 4) {
+	  $matrix = [ [ (0) x ($channels-1), 1 ] ];
 	}
 	else {
 	  # the alpha is just 1 <shrug>
-	  $matrix = [ [ (0) x $self->getchannels, 1 ] ];
+	  $matrix = [ [ (0) x $channels, 1 ] ];
 	}
       }
       elsif ($opts{preset} eq 'rgb') {
-	if ($self->getchannels == 1) {
+	if ($channels == 1) {
 	  $matrix = [ [ 1 ], [ 1 ], [ 1 ] ];
 	}
-	elsif ($self->getchannels == 2) {
+	elsif ($channels == 2) {
 	  # preserve the alpha channel
 	  $matrix = [ [ 1, 0 ], [ 1, 0 ], [ 1, 0 ], [ 0, 1 ] ];
 	}
 	else {
-	  $matrix = _identity($self->getchannels);
+	  $matrix = _identity($channels);
 	}
       }
       elsif ($opts{preset} eq 'addalpha') {
-	if ($self->getchannels == 1) {
+	if ($channels == 1) {
 	  $matrix = _identity(2);
 	}
-	elsif ($self->getchannels == 3) {
+	elsif ($channels == 3) {
 	  $matrix = _identity(4);
 	}
 	else {
-	  $matrix = _identity($self->getchannels);
+	  $matrix = _identity($channels);
 	}
       }
       else {
-	$self->{ERRSTR} = "Unknown convert preset $opts{preset}";
-	return undef;
+	$self->_set_error("Unknown convert preset $opts{preset}");
+	return;
       }
     }
   }
@@ -3841,6 +4030,25 @@ sub convert {
     $matrix = $opts{matrix};
   }
 
+
+  return $matrix;
+}
+
+sub convert {
+  my ($self, %opts) = @_;
+
+  $self->_valid_image("convert")
+    or return;
+
+  unless (defined wantarray) {
+    my @caller = caller;
+    warn "convert() called in void context - convert() returns the converted image at $caller[1] line $caller[2]\n";
+    return;
+  }
+
+  my $matrix = $self->_convert_matrix($self->getchannels, %opts)
+    or return;
+
   my $new = Imager->new;
   $new->{IMG} = i_convert($self->{IMG}, $matrix);
   unless ($new->{IMG}) {
@@ -4254,6 +4462,52 @@ sub check_file_limits {
   return $result;
 }
 
+sub set_thread_count {
+  my ($class, $count) = @_;
+
+  unless (defined $count && $count =~ /^[0-9]+$/) {
+    $class->_set_error("set_thread_count: count must be a positive integer");
+    return;
+  }
+
+  unless (i_set_thread_count($count)) {
+    $class->_set_error($class->_error_as_msg());
+    return;
+  }
+
+  return 1;
+}
+
+sub get_thread_count {
+  i_get_thread_count();
+}
+
+sub set_io_buffer_size {
+  my ($class, %opts) = @_;
+
+  my $size = $opts{size};
+  unless (defined $size && $size =~ /^[0-9]+$/) {
+    $class->_set_error("set_io_buffer_size: size must be a positive integer");
+    return;
+  }
+  my $max_size = $opts{max_size} || 0;
+  unless ($max_size =~ /^[0-9]+$/) {
+    $class->_set_error("set_io_buffer_size: max_size must be a positive integer");
+    return;
+  }
+
+  unless (i_set_io_buffer_size($size, $max_size)) {
+    $class->_set_error($class->_error_as_msg());
+    return;
+  }
+
+  return 1;
+}
+
+sub get_io_buffer_size {
+  i_get_io_buffer_size();
+}
+
 # Shortcuts that can be exported
 
 sub newcolor { Imager::Color->new(@_); }
@@ -4904,6 +5158,8 @@ getcolorusagehash() - L<Imager::ImageTypes/getcolorusagehash()>
 
 get_file_limits() - L<Imager::Files/get_file_limits()>
 
+get_io_buffer_size() - L<Imager::Files/get_io_buffer_size()>
+
 getheight() - L<Imager::ImageTypes/getheight()> - height of the image in
 pixels
 
@@ -4915,6 +5171,8 @@ colors
 getsamples() - L<Imager::Draw/getsamples()> - retrieve samples from a
 row or partial row of pixels.
 
+get_thread_count() - L<Imager::Threads/get_thread_count()>
+
 getscanline() - L<Imager::Draw/getscanline()> - retrieve colors for a
 row or partial row of pixels.
 
@@ -4952,6 +5210,9 @@ matrix_transform() - L<Imager::Engines/matrix_transform()>
 
 maxcolors() - L<Imager::ImageTypes/maxcolors()>
 
+mmap_flush() - L<Imager::ImageTypes/mmap_flush()> - write changes to
+a memory mapped image to its file
+
 NC() - L<Imager::Handy/NC()>
 
 NCF() - L<Imager::Handy/NCF()>
@@ -4991,6 +5252,9 @@ read() - L<Imager::Files/read()> - read a single image from an image file
 read_multi() - L<Imager::Files/read_multi()> - read multiple images from an image
 file
 
+read_rows() - L<Imager::Files/read_rows()> - read an image a few rows
+at a time.
+
 read_types() - L<Imager::Files/read_types()> - list image types Imager
 can read.
 
@@ -5029,6 +5293,12 @@ setsamples() - L<Imager::Draw/setsamples()>
 
 setscanline() - L<Imager::Draw/setscanline()>
 
+set_io_buffer_size() - L<Imager::Files/set_io_buffer_size()> - set
+the default I/O buffer size.
+
+set_thread_count() - L<Imager::Threads/set_thread_count()> - split
+image processing across threads.
+
 settag() - L<Imager::ImageTypes/settag()>
 
 string() - L<Imager::Draw/string()> - draw text on an image
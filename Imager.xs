@@ -131,6 +131,39 @@ calloc_temp(pTHX_ size_t size) {
   return result;
 }
 
+/*
+
+Build a scalar holding the contents of a buffer chain, copying each
+block straight into the scalar's buffer.
+
+*/
+
+static SV *
+bufchain_sv(pTHX_ io_glue *ig) {
+  size_t count = i_io_bufchain_spans(ig, NULL, 0);
+  i_io_vec *spans = malloc_temp(aTHX_ sizeof(i_io_vec) * (count ? count : 1));
+  size_t total = 0;
+  size_t i;
+  SV *sv;
+  char *p;
+
+  i_io_bufchain_spans(ig, spans, count);
+  for (i = 0; i < count; ++i)
+    total += spans[i].size;
+
+  sv = newSV(total + 1);
+  p = SvPVX(sv);
+  for (i = 0; i < count; ++i) {
+    memcpy(p, spans[i].data, spans[i].size);
+    p += spans[i].size;
+  }
+  *p = '\0';
+  SvCUR_set(sv, total);
+  SvPOK_only(sv);
+
+  return sv;
+}
+
 /* for use with the T_AVARRAY typemap */
 #define doublePtr(size) ((double *)calloc_temp(aTHX_ sizeof(double) * (size)))
 #define SvDouble(sv, pname) (SvNV(sv))
@@ -579,6 +612,7 @@ static struct value_name make_color_names[] =
   { "gray", mc_gray, },
   { "gray4", mc_gray4, },
   { "gray16", mc_gray16, },
+  { "wu", mc_wu, },
 };
 
 static struct value_name translate_names[] =
@@ -707,6 +741,11 @@ ip_handle_quant_opts_low(pTHX_ i_quantize *quant, HV *hv, int push_errors)
     if (i <= quant->mc_size && i >= quant->mc_count)
       quant->mc_size = i;
   }
+  if (quant->version >= 2) {
+    sv = hv_fetch(hv, "max_samples", 11, 0);
+    if (sv && *sv)
+      quant->mc_max_samples = SvIV(*sv) > 0 ? SvIV(*sv) : 0;
+  }
 
   quant->translate = pt_closest;
   sv = hv_fetch(hv, "translate", 9, 0);
@@ -734,6 +773,13 @@ ip_handle_quant_opts_low(pTHX_ i_quantize *quant, HV *hv, int push_errors)
       quant->ed_orig = SvIV(*sv);
     if (quant->ed_width > 0 && quant->ed_height > 0) {
       int sum = 0;
+      if (quant->ed_orig < 0 || quant->ed_orig >= quant->ed_width) {
+	if (push_errors) {
+	  i_push_errorf(0, "errdiff_orig must be from 0 to %d", quant->ed_width-1);
+	  return 0;
+	}
+	quant->ed_orig = quant->ed_orig < 0 ? 0 : quant->ed_width - 1;
+      }
       quant->ed_map = mymalloc(sizeof(int)*quant->ed_width*quant->ed_height);
       sv = hv_fetch(hv, "errdiff_map", 11, 0);
       if (sv && *sv && SvROK(*sv) && SvTYPE(SvRV(*sv)) == SVt_PVAV) {
@@ -775,6 +821,7 @@ ip_handle_quant_opts_low(pTHX_ i_quantize *quant, HV *hv, int push_errors)
 
 static void
 ip_cleanup_quant_opts(pTHX_ i_quantize *quant) {
+  i_quant_cleanup(quant);
   myfree(quant->mc_colors);
   if (quant->ed_map)
     myfree(quant->ed_map);
@@ -828,6 +875,14 @@ poly_fill_mode_names[] =
   { "nonzero", i_pfm_nonzero }
 };
 
+static struct value_name
+mmap_mode_names[] =
+{
+  { "read", i_mmap_read },
+  { "update", i_mmap_update },
+  { "create", i_mmap_create }
+};
+
 static i_poly_fill_mode_t
 S_get_poly_fill_mode(pTHX_ SV *sv) {	
   if (looks_like_number(sv)) {
@@ -911,6 +966,55 @@ S_get_polygon_list(pTHX_ i_polygon_list *polys, SV *sv) {
 }
 
 /* loads the segments of a fountain fill into an array */
+/* convert a perl convert() matrix to coefficients for i_convert() and
+   i_row_source_convert() */
+static double *
+load_convert_matrix(pTHX_ AV *avmain, int *poutchan, int *pinchan) {
+  double *coeff;
+  int outchan;
+  int inchan;
+  SV **temp;
+  AV *avsub;
+  int len;
+  int i, j;
+
+  outchan = av_len(avmain)+1;
+  /* find the biggest */
+  inchan = 0;
+  for (j=0; j < outchan; ++j) {
+    temp = av_fetch(avmain, j, 0);
+    if (temp && SvROK(*temp) && SvTYPE(SvRV(*temp)) == SVt_PVAV) {
+      avsub = (AV*)SvRV(*temp);
+      len = av_len(avsub)+1;
+      if (len > inchan)
+	inchan = len;
+    }
+    else {
+      i_push_errorf(0, "invalid matrix: element %d is not an array ref", j);
+      return NULL;
+    }
+  }
+  coeff = mymalloc(sizeof(double) * outchan * inchan);
+  for (j = 0; j < outchan; ++j) {
+    avsub = (AV*)SvRV(*av_fetch(avmain, j, 0));
+    len = av_len(avsub)+1;
+    for (i = 0; i < len; ++i) {
+      temp = av_fetch(avsub, i, 0);
+      if (temp)
+	coeff[i+j*inchan] = SvNV(*temp);
+      else
+	coeff[i+j*inchan] = 0;
+    }
+    while (i < inchan)
+      coeff[i++ + j*inchan] = 0;
+  }
+
+  *poutchan = outchan;
+  *pinchan = inchan;
+
+  return coeff;
+}
+
 static i_fountain_seg *
 load_fount_segs(pTHX_ AV *asegs, int *count) {
   /* Each element of segs must contain:
@@ -1326,6 +1430,17 @@ Imager::IO
 io_new_fd(fd)
                          int     fd
 
+Imager::IO
+io_new_mmap(fd)
+                         int     fd
+	CODE:
+	  i_clear_error();
+	  RETVAL = io_new_mmap(fd);
+	  if (!RETVAL)
+	    XSRETURN(0);
+        OUTPUT:
+          RETVAL
+
 Imager::IO
 io_new_bufchain()
 
@@ -1355,14 +1470,8 @@ io_new_cb(writecb, readcb, seekcb, closecb, maxwrite = CBDATA_BUFSIZE)
 SV *
 io_slurp(ig)
         Imager::IO     ig
-	     PREINIT:
-	      unsigned char*    data;
-	      size_t    tlength;
 	     CODE:
- 	      data    = NULL;
-              tlength = io_slurp(ig, &data);
-              RETVAL = newSVpv((char *)data,tlength);
-              myfree(data);
+	      RETVAL = bufchain_sv(aTHX_ ig);
 	     OUTPUT:
 	      RETVAL
 
@@ -1394,6 +1503,41 @@ i_int_check_image_file_limits(width, height, channels, sample_size)
 	size_t sample_size
   PROTOTYPE: DISABLE
 
+undef_int
+i_set_thread_count(count)
+	int count
+
+int
+i_get_thread_count()
+
+undef_int
+i_set_io_buffer_size(size, max_size)
+	size_t size
+	size_t max_size
+
+void
+i_get_io_buffer_size()
+    PREINIT:
+	size_t size, max_size;
+    PPCODE:
+	i_get_io_buffer_size(&size, &max_size);
+	EXTEND(SP, 2);
+	PUSHs(sv_2mortal(newSVuv(size)));
+	PUSHs(sv_2mortal(newSVuv(max_size)));
+
+void
+i_int_simd_set_limit(limit)
+	int limit
+    CODE:
+	i_simd_set_limit(limit);
+
+const char *
+i_int_conv_kernels_name()
+    CODE:
+	RETVAL = i_conv_kernels_get()->name;
+    OUTPUT:
+	RETVAL
+
 MODULE = Imager		PACKAGE = Imager::IO	PREFIX = io_
 
 Imager::IO
@@ -1404,6 +1548,17 @@ io_new_fd(class, fd)
     OUTPUT:
 	RETVAL
 
+Imager::IO
+io_new_mmap(class, fd)
+	int fd
+    CODE:
+	i_clear_error();
+	RETVAL = io_new_mmap(fd);
+	if (!RETVAL)
+	  XSRETURN(0);
+    OUTPUT:
+	RETVAL
+
 Imager::IO
 io_new_buffer(class, data_sv)
 	SV *data_sv
@@ -1444,14 +1599,8 @@ io__new_perlio(class, io)
 SV *
 io_slurp(class, ig)
         Imager::IO     ig
-    PREINIT:
-	unsigned char*    data;
-	size_t    tlength;
     CODE:
-	data    = NULL;
-	tlength = io_slurp(ig, &data);
-	RETVAL = newSVpv((char *)data,tlength);
-	myfree(data);
+	RETVAL = bufchain_sv(aTHX_ ig);
     OUTPUT:
 	RETVAL
 
@@ -1699,6 +1848,23 @@ i_io_write(ig, data_sv)
       OUTPUT:
 	RETVAL
 
+IV
+i_io_writev(ig, ...)
+	Imager::IO ig
+      PREINIT:
+	i_io_vec *vec;
+	int i;
+      CODE:
+	vec = malloc_temp(aTHX_ sizeof(i_io_vec) * (items > 1 ? items - 1 : 1));
+	for (i = 1; i < items; ++i) {
+	  STRLEN size;
+	  vec[i-1].data = SvPVbyte(ST(i), size);
+	  vec[i-1].size = size;
+	}
+        RETVAL = i_io_writev(ig, vec, items - 1);
+      OUTPUT:
+	RETVAL
+
 void
 i_io_dump(ig, flags = I_IO_DUMP_DEFAULT)
 	Imager::IO ig
@@ -1713,6 +1879,20 @@ bool
 i_io_is_buffered(ig)
 	Imager::IO ig
 
+bool
+i_io_set_buffer_size(ig, size, max_size = 0)
+	Imager::IO ig
+	size_t size
+	size_t max_size
+
+void
+i_io_buffer_size(ig)
+	Imager::IO ig
+    PPCODE:
+	EXTEND(SP, 2);
+	PUSHs(sv_2mortal(newSVuv(ig->buf_size)));
+	PUSHs(sv_2mortal(newSVuv(ig->buf_max)));
+
 bool
 i_io_eof(ig)
 	Imager::IO ig
@@ -2301,6 +2481,12 @@ i_gaussian2(im,stddevX,stddevY)
 	    im_double     stddevX
 	    im_double     stddevY
 
+undef_int
+i_gaussian2_box(im,stddevX,stddevY)
+    Imager::ImgRaw     im
+	    im_double     stddevX
+	    im_double     stddevY
+
 void
 i_unsharp_mask(im,stdev,scale)
     Imager::ImgRaw     im
@@ -2336,46 +2522,32 @@ i_convert(src, avmain)
     	  double *coeff;
 	  int outchan;
 	  int inchan;
-          SV **temp;
-          AV *avsub;
-	  int len;
-	  int i, j;
         CODE:
-	  outchan = av_len(avmain)+1;
-          /* find the biggest */
-          inchan = 0;
-	  for (j=0; j < outchan; ++j) {
-	    temp = av_fetch(avmain, j, 0);
-	    if (temp && SvROK(*temp) && SvTYPE(SvRV(*temp)) == SVt_PVAV) {
-	      avsub = (AV*)SvRV(*temp);
-	      len = av_len(avsub)+1;
-	      if (len > inchan)
-		inchan = len;
-	    }
-	    else {
-	      i_push_errorf(0, "invalid matrix: element %d is not an array ref", j);
-	      XSRETURN(0);
-	    }
-          }
-          coeff = mymalloc(sizeof(double) * outchan * inchan);
-	  for (j = 0; j < outchan; ++j) {
-	    avsub = (AV*)SvRV(*av_fetch(avmain, j, 0));
-	    len = av_len(avsub)+1;
-	    for (i = 0; i < len; ++i) {
-	      temp = av_fetch(avsub, i, 0);
-	      if (temp)
-		coeff[i+j*inchan] = SvNV(*temp);
-	      else
-	 	coeff[i+j*inchan] = 0;
-	    }
-	    while (i < inchan)
-	      coeff[i++ + j*inchan] = 0;
-	  }
+	  coeff = load_convert_matrix(aTHX_ avmain, &outchan, &inchan);
+	  if (!coeff)
+	    XSRETURN(0);
 	  RETVAL = i_convert(src, coeff, outchan, inchan);
           myfree(coeff);
 	OUTPUT:
 	  RETVAL
 
+Imager::RowSourceRaw
+i_row_source_convert(src, avmain)
+    Imager::RowSourceRaw src
+    AV *avmain
+	PREINIT:
+    	  double *coeff;
+	  int outchan;
+	  int inchan;
+        CODE:
+	  coeff = load_convert_matrix(aTHX_ avmain, &outchan, &inchan);
+	  if (!coeff)
+	    XSRETURN(0);
+	  RETVAL = i_row_source_convert(src, coeff, outchan, inchan);
+          myfree(coeff);
+	OUTPUT:
+	  RETVAL
+
 
 undef_int
 i_map(im, pmaps_av)
@@ -2718,6 +2890,17 @@ i_writeppm_wiol(im, ig)
     Imager::ImgRaw     im
         Imager::IO     ig
 
+Imager::RowSourceRaw
+i_readpnm_rows_wiol(ig)
+        Imager::IO     ig
+
+Imager::RowSinkRaw
+i_writepnm_rows_wiol(ig, xsize, ysize, channels)
+        Imager::IO     ig
+	i_img_dim      xsize
+	i_img_dim      ysize
+	int            channels
+
 
 
 
@@ -2789,6 +2972,12 @@ i_scale_mixing(im, width, height)
 	       i_img_dim     width
 	       i_img_dim     height
 
+Imager::RowSourceRaw
+i_row_source_scale(src, width, height)
+    Imager::RowSourceRaw src
+	       i_img_dim     width
+	       i_img_dim     height
+
 Imager::ImgRaw
 i_haar(im)
     Imager::ImgRaw     im
@@ -2909,12 +3098,13 @@ i_transform2(sv_width,sv_height,channels,sv_ops,av_n_regs,av_c_regs,av_in_imgs)
              n_regs = mymalloc(n_regs_count * sizeof(double));
 	     for (i = 0; i < n_regs_count; ++i) {
 	       sv1 = *av_fetch(av_n_regs,i,0);
-	       if (SvOK(sv1))
-	         n_regs[i] = SvNV(sv1);
+	       n_regs[i] = SvOK(sv1) ? SvNV(sv1) : 0;
 	     }
              c_regs_count = av_len(av_c_regs)+1;
              c_regs = mymalloc(c_regs_count * sizeof(i_color));
-             /* I don't bother initializing the colou?r registers */
+             /* registers can keep values between pixels, so they must
+                start with known values */
+             memset(c_regs, 0, c_regs_count * sizeof(i_color));
 
 	     result=i_transform2(width, height, channels, ops, ops_count, 
 				 n_regs, n_regs_count, 
@@ -3289,7 +3479,7 @@ i_img_to_pal(src, quant_hv)
         i_quantize quant;
       CODE:
         memset(&quant, 0, sizeof(quant));
-	quant.version = 1;
+	quant.version = 2;
         quant.mc_size = 256;
 	i_clear_error();
 	if (!ip_handle_quant_opts2(aTHX_ &quant, quant_hv)) {
@@ -3328,7 +3518,7 @@ i_img_make_palette(HV *quant_hv, ...)
           }
 	}
         memset(&quant, 0, sizeof(quant));
-	quant.version = 1;
+	quant.version = 2;
 	quant.mc_size = 256;
         if (!ip_handle_quant_opts2(aTHX_ &quant, quant_hv)) {
 	  XSRETURN_EMPTY;
@@ -3952,6 +4142,55 @@ Imager::ImgRaw
 i_img_to_drgb(im)
        Imager::ImgRaw im
 
+Imager::ImgRaw
+i_img_tiled_new(xsize, ysize, channels, bits, bg = NULL)
+        i_img_dim xsize
+        i_img_dim ysize
+        int channels
+        int bits
+        Imager::Color::Float bg
+
+void
+i_img_tiled_count(im)
+        Imager::ImgRaw im
+      PREINIT:
+        size_t allocated, total;
+      PPCODE:
+        if (i_img_tiled_count(im, &allocated, &total)) {
+          EXTEND(SP, 2);
+          PUSHs(sv_2mortal(newSVuv(allocated)));
+          PUSHs(sv_2mortal(newSVuv(total)));
+        }
+
+Imager::ImgRaw
+i_img_mmap_new(filename_sv, xsize, ysize, channels, bits, mode = "create", offset = 0)
+        SV *filename_sv
+        i_img_dim xsize
+        i_img_dim ysize
+        int channels
+        int bits
+        char *mode
+        off_t offset
+      PREINIT:
+        const char *filename = NULL;
+        int mode_value, failed;
+      CODE:
+        i_clear_error();
+        SvGETMAGIC(filename_sv);
+        if (SvOK(filename_sv))
+          filename = SvPV_nomg_nolen(filename_sv);
+        mode_value = lookup_name(mmap_mode_names, ARRAY_COUNT(mmap_mode_names),
+                                 mode, i_mmap_create, 1, "mmap_mode", &failed);
+        RETVAL = failed ? NULL
+          : i_img_mmap_new(filename, xsize, ysize, channels, bits, mode_value,
+                           offset);
+      OUTPUT:
+        RETVAL
+
+undef_int
+i_img_mmap_flush(im)
+        Imager::ImgRaw im
+
 undef_int
 i_tags_addn(im, name_sv, code, idata)
         Imager::ImgRaw im
@@ -4114,6 +4353,63 @@ i_tags_count(im)
 
 
 
+MODULE = Imager         PACKAGE = Imager::RowSourceRaw PREFIX=i_row_source_
+
+void
+i_row_source_DESTROY(src)
+        Imager::RowSourceRaw src
+    CODE:
+        i_row_source_destroy(src);
+
+int
+i_row_source_CLONE_SKIP(...)
+    CODE:
+        (void)items; /* avoid unused warning for XS variable */
+        RETVAL = 1;
+    OUTPUT:
+        RETVAL
+
+void
+i_row_source_info(src)
+        Imager::RowSourceRaw src
+    PPCODE:
+        EXTEND(SP, 4);
+        PUSHs(sv_2mortal(newSViv(src->xsize)));
+        PUSHs(sv_2mortal(newSViv(src->ysize)));
+        PUSHs(sv_2mortal(newSViv(src->channels)));
+        PUSHs(sv_2mortal(newSViv(src->row)));
+
+MODULE = Imager         PACKAGE = Imager::RowSinkRaw PREFIX=i_row_sink_
+
+void
+i_row_sink_DESTROY(sink)
+        Imager::RowSinkRaw sink
+    CODE:
+        i_row_sink_destroy(sink);
+
+int
+i_row_sink_CLONE_SKIP(...)
+    CODE:
+        (void)items; /* avoid unused warning for XS variable */
+        RETVAL = 1;
+    OUTPUT:
+        RETVAL
+
+MODULE = Imager         PACKAGE = Imager
+
+Imager::RowSourceRaw
+i_row_source_img(im)
+        Imager::ImgRaw im
+
+Imager::ImgRaw
+i_row_source_to_img(src)
+        Imager::RowSourceRaw src
+
+undef_int
+i_rows_copy(src, sink)
+        Imager::RowSourceRaw src
+        Imager::RowSinkRaw sink
+
 MODULE = Imager         PACKAGE = Imager::FillHandle PREFIX=IFILL_
 
 void
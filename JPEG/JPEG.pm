@@ -4,7 +4,7 @@ use strict;
 use Imager;
 
 BEGIN {
-  our $VERSION = "0.94";
+  our $VERSION = "0.95";
 
   require XSLoader;
   XSLoader::load('Imager::File::JPEG', $VERSION);
@@ -17,7 +17,21 @@ Imager->register_reader
    sub { 
      my ($im, $io, %hsh) = @_;
 
-     ($im->{IMG},$im->{IPTCRAW}) = i_readjpeg_wiol( $io );
+     my @size = ( 0, 0 );
+     if ($hsh{jpeg_xpixels} || $hsh{jpeg_ypixels}) {
+       @size = ();
+       for my $name (qw(jpeg_xpixels jpeg_ypixels)) {
+	 my $value = $hsh{$name} || 0;
+	 unless ($value =~ /^\d+$/) {
+	   $im->_set_error("$name must be a non-negative integer");
+	   return;
+	 }
+	 push @size, $value;
+       }
+     }
+
+     ($im->{IMG},$im->{IPTCRAW}) =
+       i_readjpeg_wiol( $io, @size, $hsh{jpeg_orient} ? 1 : 0 );
 
      unless ($im->{IMG}) {
        $im->_set_error(Imager->_error_as_msg);
@@ -25,6 +39,12 @@ Imager->register_reader
      }
      return $im;
    },
+   rows =>
+   sub {
+     my ($io, %hsh) = @_;
+
+     return i_readjpeg_rows_wiol($io);
+   },
   );
 
 Imager->register_writer
@@ -48,6 +68,15 @@ Imager->register_writer
 
      return $im;
    },
+   rows =>
+   sub {
+     my ($io, $xsize, $ysize, $channels, %hsh) = @_;
+
+     my $quality = $hsh{jpegquality};
+     defined $quality or $quality = 75;
+
+     return i_writejpeg_rows_wiol($io, $xsize, $ysize, $channels, $quality);
+   },
   );
 
 __END__
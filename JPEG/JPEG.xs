@@ -22,10 +22,25 @@ i_writejpeg_wiol(im, ig, qfactor)
         Imager::IO     ig
 	       int     qfactor
 
+Imager::RowSourceRaw
+i_readjpeg_rows_wiol(ig)
+        Imager::IO     ig
+
+Imager::RowSinkRaw
+i_writejpeg_rows_wiol(ig, xsize, ysize, channels, qfactor)
+        Imager::IO     ig
+	 i_img_dim     xsize
+	 i_img_dim     ysize
+	       int     channels
+	       int     qfactor
+
 
 void
-i_readjpeg_wiol(ig)
+i_readjpeg_wiol(ig, xpixels = 0, ypixels = 0, orient = 0)
         Imager::IO     ig
+	 i_img_dim     xpixels
+	 i_img_dim     ypixels
+	       int     orient
 	     PREINIT:
 	      char*    iptc_itext;
 	       int     tlength;
@@ -33,7 +48,7 @@ i_readjpeg_wiol(ig)
                 SV*    r;
 	     PPCODE:
  	      iptc_itext = NULL;
-	      rimg = i_readjpeg_wiol(ig,-1,&iptc_itext,&tlength);
+	      rimg = i_readjpeg_scaled_wiol(ig,-1,&iptc_itext,&tlength,xpixels,ypixels,orient);
 	      if (iptc_itext == NULL) {
 		    r = sv_newmortal();
 	            EXTEND(SP,1);
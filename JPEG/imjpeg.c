@@ -217,6 +217,7 @@ wiol_empty_output_buffer(j_compress_ptr cinfo) {
 
   if (rc != JPGS) { /* XXX: Should raise some jpeg error */
     myfree(dest->buffer);
+    dest->buffer = NULL;
     mm_log((1, "wiol_empty_output_buffer: Error: nbytes = %d != rc = %d\n", JPGS, (int)rc));
     ERREXIT(cinfo, JERR_FILE_WRITE);
   }
@@ -234,10 +235,12 @@ wiol_term_destination (j_compress_ptr cinfo) {
 
   if (i_io_write(dest->data, dest->buffer, nbytes) != nbytes) {
     myfree(dest->buffer);
+    dest->buffer = NULL;
     ERREXIT(cinfo, JERR_FILE_WRITE);
   }
 
   myfree(dest->buffer);
+  dest->buffer = NULL;
 }
 
 
@@ -365,9 +368,89 @@ i_libjpeg_version(void) {
 */
 i_img*
 i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
+  return i_readjpeg_scaled_wiol(data, length, iptc_itext, itlength, 0, 0, 0);
+}
+
+/* work out the final size for i_readjpeg_scaled_wiol(), the same way
+   as Imager's scale_calculate() with type min */
+static void
+scaled_size(i_img_dim width, i_img_dim height,
+	    i_img_dim xpixels, i_img_dim ypixels,
+	    i_img_dim *out_width, i_img_dim *out_height) {
+  double scale;
+
+  if (xpixels && ypixels) {
+    double x_scale = (double)xpixels / width;
+    double y_scale = (double)ypixels / height;
+    scale = x_scale < y_scale ? x_scale : y_scale;
+  }
+  else if (xpixels) {
+    scale = (double)xpixels / width;
+  }
+  else {
+    scale = (double)ypixels / height;
+  }
+
+  *out_width = (i_img_dim)(scale * width + 0.5);
+  if (*out_width < 1)
+    *out_width = 1;
+  *out_height = (i_img_dim)(scale * height + 0.5);
+  if (*out_height < 1)
+    *out_height = 1;
+}
+
+/* rows decoded before they're written to an image whose rows are
+   columns of the decoded image */
+#define ORIENT_BLOCK_ROWS 64
+
+static void
+reverse_colors(i_color *colors, i_img_dim count) {
+  i_color *leftp = colors;
+  i_color *rightp = colors + count - 1;
+
+  while (leftp < rightp) {
+    i_color tmp = *leftp;
+    *leftp++ = *rightp;
+    *rightp-- = tmp;
+  }
+}
+
+/*
+=item i_readjpeg_scaled_wiol(data, length, iptc_itext, itlength, xpixels, ypixels, orient)
+
+Read a JPEG image scaled to fit within C<xpixels> by C<ypixels>,
+keeping the aspect ratio.  If either is zero only the other is used
+to calculate the size, if both are zero the image is read at full
+size.
+
+libjpeg is asked to scale the image by the largest of 1/8, 1/4 or 1/2
+that still leaves the image at least as large as the final size,
+which is much cheaper than decoding at full size.  The decoded image
+is then scaled to the final size with i_scale_mixing().
+
+The C<jpeg_scale_denom> tag is set to the reduction libjpeg applied,
+and the C<i_xres> and C<i_yres> tags are scaled with the image so
+they describe the same physical size.
+
+If C<orient> is non-zero and the image has an EXIF Orientation tag,
+each decoded row is stored directly in its final position so the
+image is returned upright, and the C<exif_orientation> tag is set
+to 1.  Images that are turned on their side are decoded
+C<ORIENT_BLOCK_ROWS> rows at a time, and C<xpixels> and C<ypixels>
+apply to the upright image.
+
+=cut
+*/
+i_img*
+i_readjpeg_scaled_wiol(io_glue *data, int length, char** iptc_itext,
+		       int *itlength, i_img_dim xpixels, i_img_dim ypixels,
+		       int orient) {
   i_img * volatile im = NULL;
   int seen_exif = 0;
   i_color * volatile line_buffer = NULL;
+  int orientation = 0;
+  int swap;
+  i_img_dim width, height;
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr jerr;
   JSAMPARRAY buffer;		/* Output row buffer */
@@ -376,8 +459,9 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
   transfer_function_t transfer_f;
   int channels;
   volatile int src_set = 0;
+  i_img_dim out_width = 0, out_height = 0;
 
-  mm_log((1,"i_readjpeg_wiol(data %p, length %d,iptc_itext %p)\n", data, length, iptc_itext));
+  mm_log((1,"i_readjpeg_scaled_wiol(data %p, length %d,iptc_itext %p, xpixels %" i_DF ", ypixels %" i_DF ")\n", data, length, iptc_itext, i_DFc(xpixels), i_DFc(ypixels)));
 
   i_clear_error();
 
@@ -408,6 +492,45 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
   src_set = 1;
 
   (void) jpeg_read_header(&cinfo, TRUE);
+
+  if (orient) {
+    for (markerp = cinfo.marker_list; markerp; markerp = markerp->next) {
+      if (markerp->marker == JPEG_APP1 && markerp->data_length >= 6
+	  && memcmp(markerp->data, "Exif\0\0", 6) == 0) {
+	orientation = im_exif_orientation(markerp->data + 6,
+					  markerp->data_length - 6);
+	break;
+      }
+    }
+  }
+  /* orientations 5 to 8 turn the image on its side */
+  swap = orientation >= 5;
+
+  if (xpixels > 0 || ypixels > 0) {
+    unsigned denom;
+
+    if (swap) {
+      scaled_size(cinfo.image_height, cinfo.image_width, xpixels, ypixels,
+		  &out_width, &out_height);
+    }
+    else {
+      scaled_size(cinfo.image_width, cinfo.image_height, xpixels, ypixels,
+		  &out_width, &out_height);
+    }
+    for (denom = 8; denom > 1; denom /= 2) {
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = denom;
+      jpeg_calc_output_dimensions(&cinfo);
+      if ((i_img_dim)(swap ? cinfo.output_height : cinfo.output_width) >= out_width
+	  && (i_img_dim)(swap ? cinfo.output_width : cinfo.output_height) >= out_height)
+	break;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    mm_log((1, "i_readjpeg: scaling to " i_DFp " with denominator %u\n",
+	    i_DFcp(out_width, out_height), denom));
+  }
+
   (void) jpeg_start_decompress(&cinfo);
 
   channels = cinfo.output_components;
@@ -461,7 +584,9 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
     return NULL;
   }
 
-  if (!i_int_check_image_file_limits(cinfo.output_width, cinfo.output_height,
+  width = cinfo.output_width;
+  height = cinfo.output_height;
+  if (!i_int_check_image_file_limits(width, height,
 				     channels, sizeof(i_sample_t))) {
     mm_log((1, "i_readjpeg: image size exceeds limits\n"));
     wiol_term_source(&cinfo);
@@ -469,7 +594,10 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
     return NULL;
   }
 
-  im = i_img_8_new(cinfo.output_width, cinfo.output_height, channels);
+  if (swap)
+    im = i_img_8_new(height, width, channels);
+  else
+    im = i_img_8_new(width, height, channels);
   if (!im) {
     wiol_term_source(&cinfo);
     jpeg_destroy_decompress(&cinfo);
@@ -477,15 +605,73 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
   }
   row_stride = cinfo.output_width * cinfo.output_components;
   buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-  line_buffer = mymalloc(sizeof(i_color) * cinfo.output_width);
-  while (cinfo.output_scanline < cinfo.output_height) {
-    (void) jpeg_read_scanlines(&cinfo, buffer, 1);
-    transfer_f(line_buffer, buffer, cinfo.output_width);
-    i_plin(im, 0, cinfo.output_width, cinfo.output_scanline-1, line_buffer);
+  if (swap) {
+    /* each decoded row is a column of the image, so collect a block
+       of rows and write them out as short runs along the image's
+       rows */
+    i_color *block, *run;
+
+    line_buffer = mymalloc(sizeof(i_color) * (width + 1) * ORIENT_BLOCK_ROWS);
+    block = line_buffer;
+    run = block + width * ORIENT_BLOCK_ROWS;
+    while ((i_img_dim)cinfo.output_scanline < height) {
+      i_img_dim y0 = cinfo.output_scanline;
+      i_img_dim x;
+      int count = 0, i;
+
+      while (count < ORIENT_BLOCK_ROWS
+	     && (i_img_dim)cinfo.output_scanline < height) {
+	(void) jpeg_read_scanlines(&cinfo, buffer, 1);
+	transfer_f(block + count * width, buffer, width);
+	++count;
+      }
+      for (x = 0; x < width; ++x) {
+	i_img_dim y = orientation == 5 || orientation == 6 ? x : width - 1 - x;
+	if (orientation == 5 || orientation == 8) {
+	  for (i = 0; i < count; ++i)
+	    run[i] = block[i * width + x];
+	  i_plin(im, y0, y0 + count, y, run);
+	}
+	else {
+	  for (i = 0; i < count; ++i)
+	    run[i] = block[(count - 1 - i) * width + x];
+	  i_plin(im, height - y0 - count, height - y0, y, run);
+	}
+      }
+    }
+  }
+  else {
+    line_buffer = mymalloc(sizeof(i_color) * width);
+    while ((i_img_dim)cinfo.output_scanline < height) {
+      i_img_dim y;
+
+      (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+      transfer_f(line_buffer, buffer, width);
+      y = cinfo.output_scanline - 1;
+      if (orientation == 2 || orientation == 3)
+	reverse_colors(line_buffer, width);
+      if (orientation == 3 || orientation == 4)
+	y = height - 1 - y;
+      i_plin(im, 0, width, y, line_buffer);
+    }
   }
   myfree(line_buffer);
   line_buffer = NULL;
 
+  if (out_width && (im->xsize != out_width || im->ysize != out_height)) {
+    i_img *scaled = i_scale_mixing(im, out_width, out_height);
+    if (!scaled) {
+      wiol_term_source(&cinfo);
+      jpeg_destroy_decompress(&cinfo);
+      i_img_destroy(im);
+      return NULL;
+    }
+    i_img_destroy(im);
+    im = scaled;
+  }
+  if (out_width)
+    i_tags_setn(&im->tags, "jpeg_scale_denom", cinfo.scale_denom);
+
   /* check for APP1 marker and save */
   markerp = cinfo.marker_list;
   while (markerp != NULL) {
@@ -509,6 +695,10 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
     markerp = markerp->next;
   }
 
+  /* the pixels are now stored upright */
+  if (orientation > 1)
+    i_tags_setn(&im->tags, "exif_orientation", 1);
+
   i_tags_setn(&im->tags, "jpeg_out_color_space", cinfo.out_color_space);
   i_tags_setn(&im->tags, "jpeg_color_space", cinfo.jpeg_color_space);
 
@@ -533,6 +723,16 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
       yres *= 2.54;
       break;
     }
+    if (swap) {
+      double temp = xres;
+      xres = yres;
+      yres = temp;
+    }
+    if (out_width) {
+      /* keep the physical size of the scaled image */
+      xres = xres * im->xsize / (swap ? cinfo.image_height : cinfo.image_width);
+      yres = yres * im->ysize / (swap ? cinfo.image_width : cinfo.image_height);
+    }
     i_tags_set_float2(&im->tags, "i_xres", 0, xres, 6);
     i_tags_set_float2(&im->tags, "i_yres", 0, yres, 6);
   }
@@ -720,6 +920,279 @@ i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor) {
   return(1);
 }
 
+typedef struct {
+  i_row_source base;
+  struct jpeg_decompress_struct cinfo;
+  struct my_error_mgr jerr;
+  JSAMPARRAY buffer;
+  transfer_function_t transfer_f;
+} jpeg_row_source;
+
+static i_img_dim
+jpeg_source_read(i_row_source *base, i_color *rows, i_img_dim count) {
+  jpeg_row_source *js = (jpeg_row_source *)base;
+  i_img_dim i;
+
+  if (setjmp(js->jerr.setjmp_buffer))
+    return -1;
+
+  for (i = 0; i < count; ++i) {
+    (void) jpeg_read_scanlines(&js->cinfo, js->buffer, 1);
+    js->transfer_f(rows + i * base->xsize, js->buffer, base->xsize);
+  }
+
+  return count;
+}
+
+static void
+jpeg_source_destroy(i_row_source *base) {
+  jpeg_row_source *js = (jpeg_row_source *)base;
+
+  wiol_term_source(&js->cinfo);
+  jpeg_destroy_decompress(&js->cinfo);
+}
+
+/*
+=item i_readjpeg_rows_wiol(data)
+
+Read the header of a JPEG image and return a row source that decodes
+it a row at a time.
+
+CMYK images are converted to RGB as i_readjpeg_wiol() does.
+
+=cut
+*/
+
+i_row_source *
+i_readjpeg_rows_wiol(io_glue *data) {
+  jpeg_row_source *js;
+  jpeg_row_source * volatile vjs;
+  int channels, components;
+  int row_stride;
+
+  mm_log((1,"i_readjpeg_rows_wiol(data %p)\n", data));
+
+  i_clear_error();
+
+  js = vjs = mymalloc(sizeof(jpeg_row_source));
+  memset(js, 0, sizeof(jpeg_row_source));
+  js->cinfo.err = jpeg_std_error(&js->jerr.pub);
+  js->jerr.pub.error_exit     = my_error_exit;
+  js->jerr.pub.output_message = my_output_message;
+
+  if (setjmp(js->jerr.setjmp_buffer)) {
+    jpeg_source_destroy(&vjs->base);
+    myfree(vjs);
+    return NULL;
+  }
+
+  jpeg_create_decompress(&js->cinfo);
+  jpeg_wiol_src(&js->cinfo, data, -1);
+
+  (void) jpeg_read_header(&js->cinfo, TRUE);
+  (void) jpeg_start_decompress(&js->cinfo);
+
+  switch (js->cinfo.out_color_space) {
+  case JCS_GRAYSCALE:
+    js->transfer_f = transfer_gray;
+    components = channels = 1;
+    break;
+
+  case JCS_RGB:
+    js->transfer_f = transfer_rgb;
+    components = channels = 3;
+    break;
+
+  case JCS_CMYK:
+    js->transfer_f = transfer_cmyk_inverted;
+    components = 4;
+    channels = 3;
+    break;
+
+  default:
+    components = channels = 0;
+    break;
+  }
+  if (!channels || js->cinfo.output_components != components) {
+    mm_log((1, "i_readjpeg_rows_wiol: color space %d with %d components\n",
+	    js->cinfo.out_color_space, js->cinfo.output_components));
+    i_push_errorf(0, "Unsupported color space %d with %d components",
+		  js->cinfo.out_color_space, js->cinfo.output_components);
+    jpeg_source_destroy(&js->base);
+    myfree(js);
+    return NULL;
+  }
+
+  if (!i_int_check_image_file_limits(js->cinfo.output_width,
+				     js->cinfo.output_height,
+				     channels, sizeof(i_sample_t))) {
+    mm_log((1, "i_readjpeg_rows_wiol: image size exceeds limits\n"));
+    jpeg_source_destroy(&js->base);
+    myfree(js);
+    return NULL;
+  }
+
+  row_stride = js->cinfo.output_width * js->cinfo.output_components;
+  js->buffer = (*js->cinfo.mem->alloc_sarray)
+    ((j_common_ptr) &js->cinfo, JPOOL_IMAGE, row_stride, 1);
+
+  i_row_source_init(&js->base, js->cinfo.output_width,
+		    js->cinfo.output_height, channels,
+		    jpeg_source_read, jpeg_source_destroy);
+
+  return &js->base;
+}
+
+typedef struct {
+  i_row_sink base;
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  io_glue *ig;
+  int want_channels;
+  i_color *work;
+  JSAMPLE *data;
+} jpeg_row_sink;
+
+static int
+jpeg_sink_write(i_row_sink *base, const i_color *rows, i_img_dim count) {
+  jpeg_row_sink *js = (jpeg_row_sink *)base;
+  i_img_dim width = base->xsize;
+  JSAMPROW row_pointer[1];
+  i_color bg;
+  i_img_dim i, x;
+  int ch;
+
+  /* black, like i_get_file_background() without an i_background tag */
+  bg.channel[0] = bg.channel[1] = bg.channel[2] = 0;
+  bg.channel[3] = 255;
+
+  if (setjmp(js->jerr.setjmp_buffer))
+    return 0;
+
+  for (i = 0; i < count; ++i) {
+    JSAMPLE *outp = js->data;
+
+    memcpy(js->work, rows + i * width, sizeof(i_color) * width);
+    i_adapt_colors_bg(js->want_channels, base->channels, js->work, width,
+		      &bg);
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < js->want_channels; ++ch)
+	*outp++ = js->work[x].channel[ch];
+    }
+    row_pointer[0] = js->data;
+    (void) jpeg_write_scanlines(&js->cinfo, row_pointer, 1);
+  }
+
+  return 1;
+}
+
+static int
+jpeg_sink_close(i_row_sink *base) {
+  jpeg_row_sink *js = (jpeg_row_sink *)base;
+
+  if (setjmp(js->jerr.setjmp_buffer))
+    return 0;
+
+  jpeg_finish_compress(&js->cinfo);
+
+  if (i_io_close(js->ig))
+    return 0;
+
+  return 1;
+}
+
+static void
+jpeg_sink_destroy(i_row_sink *base) {
+  jpeg_row_sink *js = (jpeg_row_sink *)base;
+  wiol_dest_ptr dest = (wiol_dest_ptr)js->cinfo.dest;
+
+  /* normally released by term_destination */
+  if (dest && dest->buffer)
+    myfree(dest->buffer);
+  jpeg_destroy_compress(&js->cinfo);
+  if (js->work)
+    myfree(js->work);
+  if (js->data)
+    myfree(js->data);
+}
+
+/*
+=item i_writejpeg_rows_wiol(ig, xsize, ysize, channels, qfactor)
+
+Start writing a JPEG image and return a row sink that encodes it a
+row at a time.
+
+Any alpha channel is composited against black.
+
+=cut
+*/
+
+i_row_sink *
+i_writejpeg_rows_wiol(io_glue *ig, i_img_dim xsize, i_img_dim ysize,
+		      int channels, int qfactor) {
+  jpeg_row_sink *js;
+  jpeg_row_sink * volatile vjs;
+  int want_channels = channels;
+
+  mm_log((1,"i_writejpeg_rows_wiol(ig %p, xsize %" i_DF ", ysize %" i_DF
+	  ", channels %d, qfactor %d)\n", ig, i_DFc(xsize), i_DFc(ysize),
+	  channels, qfactor));
+  
+  i_clear_error();
+
+  if (xsize < 1 || ysize < 1) {
+    i_push_error(0, "image size must be positive");
+    return NULL;
+  }
+  if (xsize > JPEG_DIM_MAX || ysize > JPEG_DIM_MAX) {
+    i_push_error(0, "image too large for JPEG");
+    return NULL;
+  }
+  if (channels < 1 || channels > 4) {
+    i_push_error(0, "channels must be from 1 to 4");
+    return NULL;
+  }
+  if (!(channels == 1 || channels == 3))
+    want_channels = channels - 1;
+
+  js = vjs = mymalloc(sizeof(jpeg_row_sink));
+  memset(js, 0, sizeof(jpeg_row_sink));
+  js->ig = ig;
+  js->want_channels = want_channels;
+  js->work = NULL;
+  js->data = NULL;
+  js->cinfo.err = jpeg_std_error(&js->jerr.pub);
+  js->jerr.pub.error_exit = my_error_exit;
+  js->jerr.pub.output_message = my_output_message;
+  
+  jpeg_create_compress(&js->cinfo);
+
+  if (setjmp(js->jerr.setjmp_buffer)) {
+    jpeg_sink_destroy(&vjs->base);
+    myfree(vjs);
+    return NULL;
+  }
+
+  jpeg_wiol_dest(&js->cinfo, ig);
+
+  js->cinfo.image_width = xsize;
+  js->cinfo.image_height = ysize;
+  js->cinfo.input_components = want_channels;
+  js->cinfo.in_color_space = want_channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+
+  jpeg_set_defaults(&js->cinfo);
+  jpeg_set_quality(&js->cinfo, qfactor, TRUE);  /* limit to baseline-JPEG values */
+
+  jpeg_start_compress(&js->cinfo, TRUE);
+
+  js->work = mymalloc(sizeof(i_color) * xsize);
+  js->data = mymalloc(xsize * want_channels);
+  i_row_sink_init(&js->base, xsize, ysize, channels, jpeg_sink_write,
+		  jpeg_sink_close, jpeg_sink_destroy);
+
+  return &js->base;
+}
+
 /*
 =back
 
@@ -6,9 +6,21 @@
 i_img*
 i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength);
 
+i_img*
+i_readjpeg_scaled_wiol(io_glue *data, int length, char** iptc_itext,
+		       int *itlength, i_img_dim xpixels, i_img_dim ypixels,
+		       int orient);
+
 undef_int
 i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor);
 
+i_row_source *
+i_readjpeg_rows_wiol(io_glue *data);
+
+i_row_sink *
+i_writejpeg_rows_wiol(io_glue *ig, i_img_dim xsize, i_img_dim ysize,
+		      int channels, int qfactor);
+
 extern const char *
 i_libjpeg_version(void);
 
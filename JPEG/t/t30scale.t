@@ -0,0 +1,102 @@
+#!perl -w
+use strict;
+use Imager;
+use Test::More;
+use Imager::Test qw(test_image is_image_similar);
+
+# reading scaled JPEG images
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t30scale.log");
+
+$Imager::formats{"jpeg"}
+  or plan skip_all => "no jpeg support";
+
+my $src = test_image()->scale(xpixels => 640, ypixels => 480,
+			      type => "nonprop");
+$src->settag(name => "jpeg_comment", value => "scale me");
+my $data;
+ok($src->write(data => \$data, type => "jpeg", jpegquality => 95),
+   "write source image");
+
+my $full = Imager->new;
+ok($full->read(data => $data, type => "jpeg"), "read at full size");
+is($full->tags(name => "jpeg_scale_denom"), undef,
+   "no scale tag for a full size read");
+
+{
+  my $im = Imager->new;
+  ok($im->read(data => $data, type => "jpeg", jpeg_xpixels => 100),
+     "read scaled by width");
+  is($im->getwidth, 100, "check width");
+  is($im->getheight, 75, "check height");
+  is($im->tags(name => "jpeg_scale_denom"), 4,
+     "decoded at 1/4 since 1/8 would be too small");
+  is($im->tags(name => "jpeg_comment"), "scale me", "tags still set");
+  my $cmp = $full->scale(xpixels => 100, qtype => "mixing");
+  is_image_similar($im, $cmp, 100 * 75 * 3 * 4,
+		   "similar to reading then scaling");
+}
+
+{
+  my $im = Imager->new;
+  ok($im->read(data => $data, type => "jpeg", jpeg_ypixels => 60),
+     "read scaled to exactly 1/8 by height");
+  is($im->getwidth, 80, "check width");
+  is($im->getheight, 60, "check height");
+  is($im->tags(name => "jpeg_scale_denom"), 8, "decoded at 1/8");
+}
+
+{
+  my $im = Imager->new;
+  ok($im->read(data => $data, type => "jpeg", jpeg_xpixels => 200,
+	       jpeg_ypixels => 200), "read to fit a box");
+  is($im->getwidth, 200, "check width");
+  is($im->getheight, 150, "check height");
+  is($im->tags(name => "jpeg_scale_denom"), 2, "decoded at 1/2");
+}
+
+{
+  my $im = Imager->new;
+  ok($im->read(data => $data, type => "jpeg", jpeg_xpixels => 1000),
+     "read larger than the image");
+  is($im->getwidth, 1000, "check width");
+  is($im->getheight, 750, "check height");
+  is($im->tags(name => "jpeg_scale_denom"), 1, "decoded at full size");
+}
+
+{
+  # the resolution is scaled with the image
+  my $res = $src->copy;
+  $res->settag(name => "i_xres", value => 300);
+  $res->settag(name => "i_yres", value => 150);
+  my $res_data;
+  ok($res->write(data => \$res_data, type => "jpeg"),
+     "write with a resolution");
+  my $im = Imager->new;
+  ok($im->read(data => $res_data, type => "jpeg", jpeg_xpixels => 100),
+     "read scaled");
+  is($im->tags(name => "i_xres"), 300 * 100 / 640, "check x resolution");
+  is($im->tags(name => "i_yres"), 150 * 75 / 480, "check y resolution");
+}
+
+{
+  my $im = Imager->new;
+  ok(!$im->read(data => $data, type => "jpeg", jpeg_xpixels => -1),
+     "negative size fails");
+  like($im->errstr, qr/jpeg_xpixels must be a non-negative integer/,
+       "check message");
+}
+
+{
+  # the size limits apply to the decoded image
+  ok(Imager->set_file_limits(width => 200), "limit width to 200");
+  my $im = Imager->new;
+  ok(!$im->read(data => $data, type => "jpeg"), "full size read fails");
+  ok($im->read(data => $data, type => "jpeg", jpeg_xpixels => 100),
+     "scaled read succeeds");
+  Imager->set_file_limits(reset => 1);
+}
+
+done_testing();
@@ -0,0 +1,71 @@
+#!perl -w
+use strict;
+use Imager;
+use Imager::RowSource;
+use Test::More;
+use Imager::Test qw(test_image is_image);
+
+# reading and writing JPEG images as rows
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t40rows.log");
+
+$Imager::formats{"jpeg"}
+  or plan skip_all => "no jpeg support";
+
+for my $file (qw(209_yonge.jpg scmyk.jpg exiftest.jpg)) {
+  my $whole = Imager->new(file => "testimg/$file");
+  ok($whole, "$file: read whole image")
+    or diag(Imager->errstr);
+  my $src = Imager->read_rows(file => "testimg/$file");
+  ok($src, "$file: read_rows")
+    or diag(Imager->errstr);
+  is_image($src->image, $whole, "$file: rows match whole image");
+}
+
+{
+  my $gray = test_image()->convert(preset => "gray");
+  my $data;
+  ok($gray->write(data => \$data, type => "jpeg"), "write gray jpeg");
+  my $whole = Imager->new(data => $data);
+  my $src = Imager->read_rows(data => $data);
+  is($src->getchannels, 1, "gray read as one channel");
+  is_image($src->image, $whole, "gray rows match");
+}
+
+for my $preset (qw(gray noalpha addalpha)) {
+  # output matches the whole image writer
+  my $im = test_image()->convert(preset => $preset);
+  my ($whole, $rows);
+  ok($im->write(data => \$whole, type => "jpeg", jpegquality => 90),
+     "$preset: write whole image");
+  ok(Imager::RowSource->new(image => $im)
+     ->write(data => \$rows, type => "jpeg", jpegquality => 90),
+     "$preset: write rows")
+    or diag(Imager->errstr);
+  is_image(Imager->new(data => $rows), Imager->new(data => $whole),
+	   "$preset: same result");
+}
+
+{
+  # thumbnail a jpeg
+  my $src = Imager->read_rows(file => "testimg/209_yonge.jpg");
+  my $data;
+  ok($src->scale(xpixels => 50)->write(data => \$data, type => "jpeg"),
+     "scale rows to jpeg");
+  my $expect;
+  Imager->new(file => "testimg/209_yonge.jpg")
+      ->scale(xpixels => 50, qtype => "mixing")
+	->write(data => \$expect, type => "jpeg");
+  is_image(Imager->new(data => $data), Imager->new(data => $expect),
+	   "matches whole image scale");
+}
+
+{
+  ok(!Imager->read_rows(data => "\xFF\xD8\xFF\xE0junk", type => "jpeg"),
+     "bad jpeg fails");
+  ok(Imager->errstr, "got a message");
+}
+
+done_testing();
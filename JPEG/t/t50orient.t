@@ -0,0 +1,109 @@
+#!perl -w
+use strict;
+use Imager;
+use Test::More;
+use Imager::Test qw(test_image is_image);
+
+# reading JPEG images upright according to the EXIF orientation
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t50orient.log");
+
+$Imager::formats{"jpeg"}
+  or plan skip_all => "no jpeg support";
+
+# an odd size so the middle row and column, and partial blocks of
+# rows, are exercised
+my $src = test_image()->scale(xpixels => 157, ypixels => 131,
+			      type => "nonprop");
+my $plain;
+ok($src->write(data => \$plain, type => "jpeg", jpegquality => 100,
+	       i_xres => 72, i_yres => 300),
+   "write source image");
+
+# insert an EXIF APP1 block with just the orientation tag after SOI
+sub with_orientation {
+  my ($jpeg, $orientation, $order) = @_;
+
+  my $tiff = $order eq "MM"
+    ? "MM" . pack("nN", 42, 8) . pack("n", 1)
+      . pack("nnNnn", 274, 3, 1, $orientation, 0) . pack("N", 0)
+    : "II" . pack("vV", 42, 8) . pack("v", 1)
+      . pack("vvVvv", 274, 3, 1, $orientation, 0) . pack("V", 0);
+  my $app1 = "Exif\0\0" . $tiff;
+  return substr($jpeg, 0, 2) . "\xFF\xE1" . pack("n", length($app1) + 2)
+    . $app1 . substr($jpeg, 2);
+}
+
+my $base = Imager->new;
+ok($base->read(data => $plain, type => "jpeg"), "read the plain image");
+
+# what each orientation should look like upright
+my %upright =
+  (
+   1 => sub { $_[0] },
+   2 => sub { my $im = $_[0]->copy; $im->flip(dir => "h"); $im },
+   3 => sub { $_[0]->rotate(right => 180) },
+   4 => sub { my $im = $_[0]->copy; $im->flip(dir => "v"); $im },
+   5 => sub { my $im = $_[0]->rotate(right => 90); $im->flip(dir => "h"); $im },
+   6 => sub { $_[0]->rotate(right => 90) },
+   7 => sub { my $im = $_[0]->rotate(right => 90); $im->flip(dir => "v"); $im },
+   8 => sub { $_[0]->rotate(right => 270) },
+  );
+
+for my $orientation (1 .. 8) {
+  for my $order (qw(MM II)) {
+    my $data = with_orientation($plain, $orientation, $order);
+
+    my $raw = Imager->new;
+    ok($raw->read(data => $data, type => "jpeg"),
+       "$orientation/$order: read without orienting");
+    is($raw->tags(name => "exif_orientation"), $orientation,
+       "$orientation/$order: orientation tag set");
+    is_image($raw, $base, "$orientation/$order: pixels as stored");
+
+    my $im = Imager->new;
+    ok($im->read(data => $data, type => "jpeg", jpeg_orient => 1),
+       "$orientation/$order: read upright");
+    is_image($im, $upright{$orientation}->($base),
+	     "$orientation/$order: check pixels");
+    is($im->tags(name => "exif_orientation"), 1,
+       "$orientation/$order: orientation tag is now 1");
+  }
+}
+
+{
+  my $data = with_orientation($plain, 6, "MM");
+  my $im = Imager->new;
+  ok($im->read(data => $data, type => "jpeg", jpeg_orient => 1),
+     "read sideways image");
+  is($im->tags(name => "i_xres"), 300, "x resolution swapped");
+  is($im->tags(name => "i_yres"), 72, "y resolution swapped");
+
+  # the size applies to the upright image
+  my $small = Imager->new;
+  ok($small->read(data => $data, type => "jpeg", jpeg_orient => 1,
+		  jpeg_xpixels => 50),
+     "read sideways image scaled");
+  is($small->getwidth, 50, "check width");
+  is($small->getheight, 60, "check height");
+}
+
+{
+  # no EXIF data at all
+  my $im = Imager->new;
+  ok($im->read(data => $plain, type => "jpeg", jpeg_orient => 1),
+     "orient an image without EXIF");
+  is_image($im, $base, "unchanged");
+  is($im->tags(name => "exif_orientation"), undef, "no orientation tag");
+
+  # an invalid orientation is ignored
+  my $bad = Imager->new;
+  ok($bad->read(data => with_orientation($plain, 9, "MM"), type => "jpeg",
+		jpeg_orient => 1),
+     "read with an invalid orientation");
+  is_image($bad, $base, "unchanged");
+}
+
+done_testing();
@@ -4,7 +4,7 @@ use strict;
 use Imager;
 
 BEGIN {
-  our $VERSION = "0.95";
+  our $VERSION = "0.96";
 
   require XSLoader;
   XSLoader::load('Imager::File::PNG', $VERSION);
@@ -27,6 +27,14 @@ Imager->register_reader
      }
      return $im;
    },
+   rows =>
+   sub {
+     my ($io, %hsh) = @_;
+     my $flags = 0;
+     $hsh{png_ignore_benign_errors}
+       and $flags |= IMPNG_READ_IGNORE_BENIGN_ERRORS;
+     return i_readpng_rows_wiol($io, $flags);
+   },
   );
 
 Imager->register_writer
@@ -45,6 +53,12 @@ Imager->register_writer
      }
      return $im;
    },
+   rows =>
+   sub {
+     my ($io, $xsize, $ysize, $channels, %hsh) = @_;
+
+     return i_writepng_rows_wiol($io, $xsize, $ysize, $channels);
+   },
   );
 
 __END__
@@ -23,6 +23,18 @@ i_writepng_wiol(im, ig)
     Imager::ImgRaw     im
         Imager::IO     ig
 
+Imager::RowSourceRaw
+i_readpng_rows_wiol(ig, flags=0)
+        Imager::IO     ig
+	int 	       flags
+
+Imager::RowSinkRaw
+i_writepng_rows_wiol(ig, xsize, ysize, channels)
+        Imager::IO     ig
+	i_img_dim      xsize
+	i_img_dim      ysize
+	int            channels
+
 unsigned
 i_png_lib_version()
 
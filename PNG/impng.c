@@ -1387,3 +1387,318 @@ cleanup_read_state(i_png_read_statep rs) {
   if (rs->warnings)
     myfree(rs->warnings);
 }
+
+typedef struct {
+  i_row_source base;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  i_png_read_state rs;
+  int bit_depth;
+  int png_channels;
+  unsigned char *line;
+} png_row_source;
+
+static i_img_dim
+png_source_read(i_row_source *base, i_color *rows, i_img_dim count) {
+  png_row_source *ps = (png_row_source *)base;
+  i_img_dim width = base->xsize;
+  int channels = ps->png_channels;
+  i_img_dim i, x;
+  int ch;
+
+  if (setjmp(png_jmpbuf(ps->png_ptr))) {
+    mm_log((1, "png_source_read: error.\n"));
+    return -1;
+  }
+
+  for (i = 0; i < count; ++i) {
+    i_color *outp = rows + i * width;
+    unsigned char *inp = ps->line;
+
+    png_read_row(ps->png_ptr, (png_bytep)ps->line, NULL);
+    if (ps->bit_depth == 16) {
+      /* the same conversion as fetching 8-bit samples from a 16-bit
+	 image */
+      for (x = 0; x < width; ++x) {
+	for (ch = 0; ch < channels; ++ch) {
+	  unsigned sample = (inp[0] << 8) + inp[1];
+	  outp[x].channel[ch] = (sample + 127) / 257;
+	  inp += 2;
+	}
+      }
+    }
+    else {
+      for (x = 0; x < width; ++x) {
+	for (ch = 0; ch < channels; ++ch)
+	  outp[x].channel[ch] = *inp++;
+      }
+    }
+  }
+
+  return count;
+}
+
+static void
+png_source_destroy(i_row_source *base) {
+  png_row_source *ps = (png_row_source *)base;
+
+  png_destroy_read_struct(&ps->png_ptr, &ps->info_ptr, (png_infopp)NULL);
+  cleanup_read_state(&ps->rs);
+  if (ps->line)
+    myfree(ps->line);
+}
+
+/*
+=item i_readpng_rows_wiol(ig, flags)
+
+Read the header of a PNG image and return a row source that decodes
+it a row at a time.
+
+Paletted and low bit depth images are expanded, and 16-bit samples
+are scaled to 8-bits the same way fetching 8-bit samples from the
+image read by i_readpng_wiol() does.
+
+Interlaced images can't be decoded a row at a time and are rejected.
+
+=cut
+*/
+
+i_row_source *
+i_readpng_rows_wiol(io_glue *ig, int flags) {
+  png_row_source * volatile vps = NULL;
+  png_row_source *ps;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_uint_32 width, height;
+  int bit_depth, color_type, interlace_type;
+  int channels;
+
+  mm_log((1,"i_readpng_rows_wiol(ig %p, flags %d)\n", ig, flags));
+  i_clear_error();
+
+  ps = vps = mymalloc(sizeof(png_row_source));
+  ps->rs.warnings = NULL;
+  ps->line = NULL;
+
+  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &ps->rs, 
+				   error_handler, read_warn_handler);
+  if (!png_ptr) {
+    i_push_error(0, "Cannot create PNG read structure");
+    myfree(ps);
+    return NULL;
+  }
+  png_set_read_fn(png_ptr, (png_voidp) (ig), wiol_read_data);
+
+#if defined(PNG_BENIGN_ERRORS_SUPPORTED)
+  png_set_benign_errors(png_ptr, (flags & IMPNG_READ_IGNORE_BENIGN_ERRORS) ? 1 : 0);
+#else
+  if (flags & IMPNG_READ_IGNORE_BENIGN_ERRORS) {
+    i_push_error(0, "libpng not configured to ignore benign errors");
+    png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+    myfree(ps);
+    return NULL;
+  }
+#endif
+
+  info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) {
+    png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+    i_push_error(0, "Cannot create PNG info structure");
+    myfree(ps);
+    return NULL;
+  }
+  ps->png_ptr = png_ptr;
+  ps->info_ptr = info_ptr;
+  
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    mm_log((1,"i_readpng_rows_wiol: error.\n"));
+    png_source_destroy(&vps->base);
+    myfree(vps);
+    return NULL;
+  }
+
+  /* we do our own limit checks */
+  png_set_user_limits(png_ptr, PNG_DIM_MAX, PNG_DIM_MAX);
+
+  png_read_info(png_ptr, info_ptr);
+  png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, &interlace_type, NULL, NULL);
+  
+  mm_log((1, "png_get_IHDR results: width %u, height %u, bit_depth %d, color_type %d, interlace_type %d\n",
+	  (unsigned)width, (unsigned)height, bit_depth,color_type,interlace_type));
+
+  if (interlace_type != PNG_INTERLACE_NONE) {
+    i_push_error(0, "interlaced PNG images can't be read as rows");
+    png_source_destroy(&ps->base);
+    myfree(ps);
+    return NULL;
+  }
+
+  if (color_type == PNG_COLOR_TYPE_PALETTE
+      || (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+      || png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+    png_set_expand(png_ptr);
+
+  png_read_update_info(png_ptr, info_ptr);
+
+  channels = png_get_channels(png_ptr, info_ptr);
+  ps->png_channels = channels;
+  ps->bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+
+  mm_log((1,"i_readpng_rows_wiol: channels %d\n",channels));
+
+  if (!i_int_check_image_file_limits(width, height, channels, sizeof(i_sample_t))) {
+    mm_log((1, "i_readpng_rows_wiol: image size exceeds limits\n"));
+    png_source_destroy(&ps->base);
+    myfree(ps);
+    return NULL;
+  }
+
+  ps->line = mymalloc(png_get_rowbytes(png_ptr, info_ptr));
+  i_row_source_init(&ps->base, width, height, channels,
+		    png_source_read, png_source_destroy);
+
+  return &ps->base;
+}
+
+typedef struct {
+  i_row_sink base;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  io_glue *ig;
+  unsigned char *line;
+} png_row_sink;
+
+static int
+png_sink_write(i_row_sink *base, const i_color *rows, i_img_dim count) {
+  png_row_sink *ps = (png_row_sink *)base;
+  i_img_dim width = base->xsize;
+  int channels = base->channels;
+  i_img_dim i, x;
+  int ch;
+
+  if (setjmp(png_jmpbuf(ps->png_ptr)))
+    return 0;
+
+  for (i = 0; i < count; ++i) {
+    const i_color *inp = rows + i * width;
+    unsigned char *outp = ps->line;
+
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < channels; ++ch)
+	*outp++ = inp[x].channel[ch];
+    }
+    png_write_row(ps->png_ptr, (png_bytep)ps->line);
+  }
+
+  return 1;
+}
+
+static int
+png_sink_close(i_row_sink *base) {
+  png_row_sink *ps = (png_row_sink *)base;
+
+  if (setjmp(png_jmpbuf(ps->png_ptr)))
+    return 0;
+
+  png_write_end(ps->png_ptr, ps->info_ptr);
+
+  if (i_io_close(ps->ig))
+    return 0;
+
+  return 1;
+}
+
+static void
+png_sink_destroy(i_row_sink *base) {
+  png_row_sink *ps = (png_row_sink *)base;
+
+  png_destroy_write_struct(&ps->png_ptr, &ps->info_ptr);
+  if (ps->line)
+    myfree(ps->line);
+}
+
+/*
+=item i_writepng_rows_wiol(ig, xsize, ysize, channels)
+
+Write a PNG header for an 8-bit image with 1 to 4 channels and return
+a row sink that encodes it a row at a time.
+
+=cut
+*/
+
+i_row_sink *
+i_writepng_rows_wiol(io_glue *ig, i_img_dim xsize, i_img_dim ysize,
+		     int channels) {
+  png_row_sink * volatile vps = NULL;
+  png_row_sink *ps;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  int cspace;
+
+  mm_log((1,"i_writepng_rows_wiol(ig %p, xsize %" i_DF ", ysize %" i_DF
+	  ", channels %d)\n", ig, i_DFc(xsize), i_DFc(ysize), channels));
+
+  i_clear_error();
+
+  if (xsize < 1 || ysize < 1) {
+    i_push_error(0, "image size must be positive");
+    return NULL;
+  }
+  if (xsize > PNG_DIM_MAX || ysize > PNG_DIM_MAX) {
+    i_push_error(0, "Image too large for PNG");
+    return NULL;
+  }
+
+  switch (channels) {
+  case 1:
+    cspace = PNG_COLOR_TYPE_GRAY;
+    break;
+  case 2:
+    cspace = PNG_COLOR_TYPE_GRAY_ALPHA;
+    break;
+  case 3:
+    cspace = PNG_COLOR_TYPE_RGB;
+    break;
+  case 4:
+    cspace = PNG_COLOR_TYPE_RGB_ALPHA;
+    break;
+  default:
+    i_push_error(0, "channels must be from 1 to 4");
+    return NULL;
+  }
+
+  png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, 
+				    error_handler, write_warn_handler);
+  if (png_ptr == NULL)
+    return NULL;
+
+  info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return NULL;
+  }
+
+  ps = vps = mymalloc(sizeof(png_row_sink));
+  ps->png_ptr = png_ptr;
+  ps->info_ptr = info_ptr;
+  ps->ig = ig;
+  ps->line = NULL;
+  
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    png_sink_destroy(&vps->base);
+    myfree(vps);
+    return NULL;
+  }
+  
+  png_set_write_fn(png_ptr, (png_voidp) (ig), wiol_write_data, wiol_flush_data);
+  png_set_user_limits(png_ptr, xsize, ysize);
+  png_set_IHDR(png_ptr, info_ptr, xsize, ysize, 8, cspace,
+	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+  png_write_info(png_ptr, info_ptr);
+
+  ps->line = mymalloc(xsize * channels);
+  i_row_sink_init(&ps->base, xsize, ysize, channels, png_sink_write,
+		  png_sink_close, png_sink_destroy);
+
+  return &ps->base;
+}
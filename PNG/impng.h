@@ -8,6 +8,9 @@ i_img    *i_readpng_wiol(io_glue *ig, int flags);
 #define IMPNG_READ_IGNORE_BENIGN_ERRORS 1
 
 undef_int i_writepng_wiol(i_img *im, io_glue *ig);
+
+i_row_source *i_readpng_rows_wiol(io_glue *ig, int flags);
+i_row_sink *i_writepng_rows_wiol(io_glue *ig, i_img_dim xsize, i_img_dim ysize, int channels);
 unsigned i_png_lib_version(void);
 
 extern const char * const *
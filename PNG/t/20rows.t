@@ -0,0 +1,71 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::RowSource;
+use Imager::Test qw(test_image is_image);
+
+# reading and writing PNG images as rows
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t20rows.log");
+
+for my $name (qw(bilevel gray graya pal palette paltrans rgb8 rgb16
+		 cover cover16 coverpal)) {
+  my $file = "testimg/$name.png";
+  my $whole = Imager->new(file => $file);
+  ok($whole, "$name: read whole image")
+    or diag(Imager->errstr);
+  my $src = Imager->read_rows(file => $file);
+  ok($src, "$name: read_rows")
+    or diag(Imager->errstr);
+  is($src->getchannels, $whole->getchannels, "$name: check channels");
+  is_image($src->image, $whole->to_rgb8, "$name: rows match whole image");
+}
+
+{
+  ok(!Imager->read_rows(file => "testimg/coveri.png"),
+     "interlaced images can't be read as rows");
+  like(Imager->errstr, qr/interlaced/, "check message");
+}
+
+{
+  my $rgba = test_image()->convert(preset => "addalpha");
+  $rgba->box(filled => 1, xmax => 20, color => [ 255, 0, 0, 128 ]);
+  my $graya = $rgba->convert(matrix => [ [ 0.222, 0.707, 0.071, 0 ],
+					  [ 0, 0, 0, 1 ] ]);
+  for my $case ([ gray => $rgba->convert(preset => "gray") ],
+		[ graya => $graya ],
+		[ rgb => $rgba->convert(preset => "noalpha") ],
+		[ rgba => $rgba ]) {
+    my ($preset, $im) = @$case;
+    my $data;
+    ok(Imager::RowSource->new(image => $im)->write(data => \$data,
+						   type => "png"),
+       "$preset: write rows")
+      or diag(Imager->errstr);
+    my $back = Imager->new(data => $data, type => "png");
+    ok($back, "$preset: read it back")
+      or diag(Imager->errstr);
+    is_image($back, $im, "$preset: round trip");
+  }
+}
+
+{
+  # scale from png to png
+  my $src = Imager->read_rows(file => "testimg/cover.png");
+  my $data;
+  ok($src->scale(scalefactor => 0.5)->write(data => \$data, type => "png"),
+     "scale rows to png");
+  my $expect = Imager->new(file => "testimg/cover.png")
+    ->scale(scalefactor => 0.5, qtype => "mixing");
+  is_image(Imager->new(data => $data), $expect, "matches whole image scale");
+}
+
+{
+  ok(!Imager->read_rows(file => "testimg/badcrc.png"), "bad crc fails");
+  ok(Imager->errstr, "got a message");
+}
+
+done_testing();
@@ -451,6 +451,28 @@ int write_bmphead(io_glue *ig, i_img *im, int bit_count, int data_size) {
   return 1;
 }
 
+/*
+=item write_strip(ig, strip, line_size, rows)
+
+Writes a strip of C<rows> lines of image data built by the
+write_*_data() functions, passing it directly to the I/O layer rather
+than copying it through the buffer.
+
+Returns non-zero on success.
+
+=cut
+*/
+static int
+write_strip(io_glue *ig, const unsigned char *strip, int line_size,
+	    i_img_dim rows) {
+  i_io_vec vec;
+
+  vec.data = strip;
+  vec.size = (size_t)line_size * rows;
+
+  return i_io_writev(ig, &vec, 1) >= 0;
+}
+
 /*
 =item write_1bit_data(ig, im)
 
@@ -463,13 +485,14 @@ Returns non-zero on success.
 static int
 write_1bit_data(io_glue *ig, i_img *im) {
   i_palidx *line;
-  unsigned char *packed;
+  unsigned char *strip;
   int byte;
   int mask;
   unsigned char *out;
   int line_size = (im->xsize+7) / 8;
   int x, y;
   int unpacked_size;
+  i_img_dim rows, row;
   dIMCTXim(im);
 
   /* round up to nearest multiple of four */
@@ -487,36 +510,41 @@ write_1bit_data(io_glue *ig, i_img *im) {
   line = mymalloc(unpacked_size); /* checked 29jun05 tonyc */
   memset(line + im->xsize, 0, 8);
 
-  /* size allocated here is always much smaller than xsize, hence
-     can't overflow int */
-  packed = mymalloc(line_size); /* checked 29jun05 tonyc */
-  memset(packed, 0, line_size);
+  /* lines are written bottom up, each strip holds rows lines ending
+     at y */
+  rows = im_int_io_strip_rows(line_size, im->ysize);
+  strip = mymalloc((size_t)line_size * rows);
+  memset(strip, 0, (size_t)line_size * rows);
   
-  for (y = im->ysize-1; y >= 0; --y) {
-    i_gpal(im, 0, im->xsize, y, line);
-    mask = 0x80;
-    byte = 0;
-    out = packed;
-    for (x = 0; x < im->xsize; ++x) {
-      if (line[x])
-	byte |= mask;
-      if ((mask >>= 1) == 0) {
+  for (y = im->ysize-1; y >= 0; y -= rows) {
+    if (rows > y + 1)
+      rows = y + 1;
+    for (row = 0; row < rows; ++row) {
+      i_gpal(im, 0, im->xsize, y - row, line);
+      mask = 0x80;
+      byte = 0;
+      out = strip + (size_t)line_size * row;
+      for (x = 0; x < im->xsize; ++x) {
+	if (line[x])
+	  byte |= mask;
+	if ((mask >>= 1) == 0) {
+	  *out++ = byte;
+	  byte = 0;
+	  mask = 0x80;
+	}
+      }
+      if (mask != 0x80) {
 	*out++ = byte;
-	byte = 0;
-	mask = 0x80;
       }
     }
-    if (mask != 0x80) {
-      *out++ = byte;
-    }
-    if (i_io_write(ig, packed, line_size) < 0) {
-      myfree(packed);
+    if (!write_strip(ig, strip, line_size, rows)) {
+      myfree(strip);
       myfree(line);
       i_push_error(0, "writing 1 bit/pixel packed data");
       return 0;
     }
   }
-  myfree(packed);
+  myfree(strip);
   myfree(line);
 
   if (i_io_close(ig))
@@ -537,11 +565,12 @@ Returns non-zero on success.
 static int
 write_4bit_data(io_glue *ig, i_img *im) {
   i_palidx *line;
-  unsigned char *packed;
+  unsigned char *strip;
   unsigned char *out;
   int line_size = (im->xsize+1) / 2;
   int x, y;
   int unpacked_size;
+  i_img_dim rows, row;
   dIMCTXim(im);
 
   /* round up to nearest multiple of four */
@@ -559,25 +588,28 @@ write_4bit_data(io_glue *ig, i_img *im) {
   line = mymalloc(unpacked_size); /* checked 29jun05 tonyc */
   memset(line + im->xsize, 0, 2);
   
-  /* size allocated here is always much smaller than xsize, hence
-     can't overflow int */
-  packed = mymalloc(line_size); /* checked 29jun05 tonyc */
-  memset(packed, 0, line_size);
+  rows = im_int_io_strip_rows(line_size, im->ysize);
+  strip = mymalloc((size_t)line_size * rows);
+  memset(strip, 0, (size_t)line_size * rows);
   
-  for (y = im->ysize-1; y >= 0; --y) {
-    i_gpal(im, 0, im->xsize, y, line);
-    out = packed;
-    for (x = 0; x < im->xsize; x += 2) {
-      *out++ = (line[x] << 4) + line[x+1];
+  for (y = im->ysize-1; y >= 0; y -= rows) {
+    if (rows > y + 1)
+      rows = y + 1;
+    for (row = 0; row < rows; ++row) {
+      i_gpal(im, 0, im->xsize, y - row, line);
+      out = strip + (size_t)line_size * row;
+      for (x = 0; x < im->xsize; x += 2) {
+	*out++ = (line[x] << 4) + line[x+1];
+      }
     }
-    if (i_io_write(ig, packed, line_size) < 0) {
-      myfree(packed);
+    if (!write_strip(ig, strip, line_size, rows)) {
+      myfree(strip);
       myfree(line);
       i_push_error(0, "writing 4 bit/pixel packed data");
       return 0;
     }
   }
-  myfree(packed);
+  myfree(strip);
   myfree(line);
 
   if (i_io_close(ig))
@@ -597,10 +629,10 @@ Returns non-zero on success.
 */
 static int
 write_8bit_data(io_glue *ig, i_img *im) {
-  i_palidx *line;
+  unsigned char *strip;
   int line_size = im->xsize;
   int y;
-  int unpacked_size;
+  i_img_dim rows, row;
   dIMCTXim(im);
 
   /* round up to nearest multiple of four */
@@ -610,23 +642,29 @@ write_8bit_data(io_glue *ig, i_img *im) {
     return 0;
 
   /* this shouldn't be an issue, but let's be careful */
-  unpacked_size = im->xsize + 4;
-  if (unpacked_size < im->xsize) {
+  if (line_size < im->xsize) {
     i_push_error(0, "integer overflow during memory allocation");
     return 0;
   }
-  line = mymalloc(unpacked_size); /* checked 29jun05 tonyc */
-  memset(line + im->xsize, 0, 4);
+
+  /* the indexes are fetched straight into the strip, the padding
+     stays zero */
+  rows = im_int_io_strip_rows(line_size, im->ysize);
+  strip = mymalloc((size_t)line_size * rows);
+  memset(strip, 0, (size_t)line_size * rows);
   
-  for (y = im->ysize-1; y >= 0; --y) {
-    i_gpal(im, 0, im->xsize, y, line);
-    if (i_io_write(ig, line, line_size) < 0) {
-      myfree(line);
+  for (y = im->ysize-1; y >= 0; y -= rows) {
+    if (rows > y + 1)
+      rows = y + 1;
+    for (row = 0; row < rows; ++row)
+      i_gpal(im, 0, im->xsize, y - row, strip + (size_t)line_size * row);
+    if (!write_strip(ig, strip, line_size, rows)) {
+      myfree(strip);
       i_push_error(0, "writing 8 bit/pixel packed data");
       return 0;
     }
   }
-  myfree(line);
+  myfree(strip);
 
   if (i_io_close(ig))
     return 0;
@@ -646,8 +684,10 @@ Returns non-zero on success.
 static int
 write_24bit_data(io_glue *ig, i_img *im) {
   unsigned char *samples;
+  unsigned char *strip;
   int y;
   int line_size = 3 * im->xsize;
+  i_img_dim rows, row;
   i_color bg;
   dIMCTXim(im);
 
@@ -664,25 +704,37 @@ write_24bit_data(io_glue *ig, i_img *im) {
   
   if (!write_bmphead(ig, im, 24, line_size * im->ysize))
     return 0;
+  /* i_gsamp_bg() may fetch all of the channels before removing alpha,
+     so fetch into a full line and swap into the strip */
   samples = mymalloc(4 * im->xsize);
-  memset(samples, 0, line_size);
-  for (y = im->ysize-1; y >= 0; --y) {
-    unsigned char *samplep = samples;
-    int x;
-    i_gsamp_bg(im, 0, im->xsize, y, samples, 3, &bg);
-    for (x = 0; x < im->xsize; ++x) {
-      unsigned char tmp = samplep[2];
-      samplep[2] = samplep[0];
-      samplep[0] = tmp;
-      samplep += 3;
+  rows = im_int_io_strip_rows(line_size, im->ysize);
+  strip = mymalloc((size_t)line_size * rows);
+  memset(strip, 0, (size_t)line_size * rows);
+  for (y = im->ysize-1; y >= 0; y -= rows) {
+    if (rows > y + 1)
+      rows = y + 1;
+    for (row = 0; row < rows; ++row) {
+      unsigned char *samplep = samples;
+      unsigned char *out = strip + (size_t)line_size * row;
+      int x;
+      i_gsamp_bg(im, 0, im->xsize, y - row, samples, 3, &bg);
+      for (x = 0; x < im->xsize; ++x) {
+	out[0] = samplep[2];
+	out[1] = samplep[1];
+	out[2] = samplep[0];
+	samplep += 3;
+	out += 3;
+      }
     }
-    if (i_io_write(ig, samples, line_size) < 0) {
+    if (!write_strip(ig, strip, line_size, rows)) {
       i_push_error(0, "writing image data");
       myfree(samples);
+      myfree(strip);
       return 0;
     }
   }
   myfree(samples);
+  myfree(strip);
 
   if (i_io_close(ig))
     return 0;
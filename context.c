@@ -47,6 +47,18 @@ im_context_new(void) {
 
   ctx->file_magic = NULL;
 
+  ctx->thread_count = 1;
+  ctx->workers = NULL;
+
+  ctx->io_buf_size = IO_BUF_SIZE;
+  ctx->io_buf_max = IO_BUF_SIZE;
+
+  ctx->bchain_pool = NULL;
+  ctx->bchain_pool_count = 0;
+
+  ctx->scratch_first = NULL;
+  ctx->scratch_cur = NULL;
+
   ctx->refcount = 1;
 
 #ifdef IMAGER_TRACE_CONTEXT
@@ -117,6 +129,12 @@ im_context_refdec(im_context_t ctx, const char *where) {
 
   free(ctx->slots);
 
+  im_workers_destroy(ctx->workers);
+
+  im_int_bchain_pool_free(ctx);
+
+  im_int_scratch_free(ctx);
+
   for (i = 0; i < IM_ERROR_COUNT; ++i) {
     if (ctx->error_stack[i].msg)
       myfree(ctx->error_stack[i].msg);
@@ -205,6 +223,19 @@ im_context_clone(im_context_t ctx, const char *where) {
   nctx->max_height = ctx->max_height;
   nctx->max_bytes = ctx->max_bytes;
 
+  /* the new context gets its own pool when it needs one */
+  nctx->thread_count = ctx->thread_count;
+  nctx->workers = NULL;
+
+  nctx->io_buf_size = ctx->io_buf_size;
+  nctx->io_buf_max = ctx->io_buf_max;
+
+  nctx->bchain_pool = NULL;
+  nctx->bchain_pool_count = 0;
+
+  nctx->scratch_first = NULL;
+  nctx->scratch_cur = NULL;
+
   nctx->refcount = 1;
 
   {
@@ -344,6 +375,107 @@ im_context_slot_get(im_context_t ctx, im_slot_t slot) {
   return ctx->slots[slot];
 }
 
+/*
+=item im_set_thread_count(ctx, count)
+
+Set the number of threads used to process an image by operations that
+can split their work across threads, such as i_conv() and
+i_gaussian2().
+
+The default of 1 processes images on the calling thread only.
+
+Returns true on success.
+
+Also callable as C<i_set_thread_count(count)>.
+
+=cut
+*/
+
+int
+im_set_thread_count(im_context_t ctx, int count) {
+  im_clear_error(ctx);
+
+  if (count < 1) {
+    im_push_error(ctx, 0, "thread count must be positive");
+    return 0;
+  }
+  if (count > IM_MAX_THREADS) {
+    im_push_errorf(ctx, 0, "thread count must be at most %d", IM_MAX_THREADS);
+    return 0;
+  }
+
+  ctx->thread_count = count;
+
+  return 1;
+}
+
+/*
+=item im_get_thread_count(ctx)
+
+Retrieve the thread count set by im_set_thread_count().
+
+Also callable as C<i_get_thread_count()>.
+
+=cut
+*/
+
+int
+im_get_thread_count(im_context_t ctx) {
+  return ctx->thread_count;
+}
+
+/*
+=item im_set_io_buffer_size(ctx, size, max_size)
+X<im_set_io_buffer_size API>X<i_set_io_buffer_size API>
+=category I/O Layers
+=synopsis im_set_io_buffer_size(aIMCTX, 65536, 1048576);
+
+Set the buffer size, and maximum adaptive buffer size, for I/O layers
+created after the call.  See i_io_set_buffer_size() for the meaning
+of the sizes.
+
+The default is a fixed 8192 byte buffer.
+
+Returns true on success.
+
+Also callable as C<i_set_io_buffer_size(size, max_size)>.
+
+=cut
+*/
+
+int
+im_set_io_buffer_size(im_context_t ctx, size_t size, size_t max_size) {
+  im_clear_error(ctx);
+
+  if (!im_int_check_io_buffer_size(ctx, size, &max_size))
+    return 0;
+
+  ctx->io_buf_size = size;
+  ctx->io_buf_max = max_size;
+
+  return 1;
+}
+
+/*
+=item im_get_io_buffer_size(ctx, &size, &max_size)
+X<im_get_io_buffer_size API>X<i_get_io_buffer_size API>
+=category I/O Layers
+=synopsis size_t size, max_size;
+=synopsis im_get_io_buffer_size(aIMCTX, &size, &max_size);
+
+Retrieve the buffer sizes set by im_set_io_buffer_size().
+
+Also callable as C<i_get_io_buffer_size(&size, &max_size)>.
+
+=cut
+*/
+
+void
+im_get_io_buffer_size(im_context_t ctx, size_t *size, size_t *max_size) {
+  *size = ctx->io_buf_size;
+  *max_size = ctx->io_buf_max;
+}
+
 /*
 =item im_add_file_magic(ctx, name, bits, mask, length)
 
@@ -383,3 +515,166 @@ im_add_file_magic(im_context_t ctx, const char *name,
 
   return 1;
 }
+
+/* the arena is a list of blocks, each followed by its storage */
+struct im_scratch_block_tag {
+  im_scratch_block_t *next;
+  size_t size; /* storage following the header */
+  size_t used;
+};
+
+/* allocations are aligned for the SIMD kernels */
+#define SCRATCH_ALIGN 32
+#define SCRATCH_HEAD \
+  ((sizeof(im_scratch_block_t) + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1))
+#define SCRATCH_DATA(block) ((unsigned char *)(block) + SCRATCH_HEAD)
+
+/* smallest block allocated */
+#define SCRATCH_BLOCK_SIZE 65536
+
+/* storage kept once the arena is empty again */
+#define SCRATCH_KEEP 0x100000
+
+/*
+=item im_scratch_mark(ctx)
+
+Return the current position in the context's scratch arena, to be
+passed to im_scratch_release() once the operation is done with any
+buffers allocated by im_scratch_alloc() after the call.
+
+Marks must be released in the reverse of the order they were taken.
+
+=cut
+*/
+
+im_scratch_mark_t
+im_scratch_mark(im_context_t ctx) {
+  im_scratch_mark_t mark;
+
+  mark.block = ctx->scratch_cur;
+  mark.used = ctx->scratch_cur ? ctx->scratch_cur->used : 0;
+
+  return mark;
+}
+
+/*
+=item im_scratch_alloc(ctx, size)
+
+Allocate I<size> bytes from the context's scratch arena, aligned for
+any type and for the SIMD kernels.
+
+This is normally a pointer increment, new storage is only allocated
+when the blocks already held are full.  The memory is only released
+by im_scratch_release() with a mark taken before the allocation.
+
+Since contexts are per thread this must not be called from band
+functions run by im_run_bands(), allocate buffers for them before
+starting the bands.
+
+=cut
+*/
+
+void *
+im_scratch_alloc(im_context_t ctx, size_t size) {
+  im_scratch_block_t *block = ctx->scratch_cur;
+  size_t rounded = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+  void *result;
+
+  if (rounded < size)
+    i_fatal(3, "Unable to allocate %lu bytes of scratch", (unsigned long)size);
+
+  if (!block || block->size - block->used < rounded) {
+    /* blocks after the current one are left from earlier operations */
+    im_scratch_block_t *next = block ? block->next : ctx->scratch_first;
+
+    if (next && next->size >= rounded) {
+      next->used = 0;
+      block = next;
+    }
+    else {
+      size_t block_size = rounded > SCRATCH_BLOCK_SIZE
+	? rounded : SCRATCH_BLOCK_SIZE;
+      im_scratch_block_t *new_block;
+
+      if (block_size + SCRATCH_HEAD < block_size)
+	i_fatal(3, "Unable to allocate %lu bytes of scratch",
+		(unsigned long)size);
+      new_block = mymalloc(block_size + SCRATCH_HEAD);
+      new_block->size = block_size;
+      new_block->used = 0;
+      new_block->next = next;
+      if (block)
+	block->next = new_block;
+      else
+	ctx->scratch_first = new_block;
+      block = new_block;
+    }
+    ctx->scratch_cur = block;
+  }
+
+  result = SCRATCH_DATA(block) + block->used;
+  block->used += rounded;
+
+  return result;
+}
+
+/*
+=item im_scratch_release(ctx, mark)
+
+Release everything allocated from the context's scratch arena since
+I<mark> was returned by im_scratch_mark().
+
+The blocks are kept for the next operation, except that once the arena
+is empty any storage beyond a small reserve is freed.
+
+=cut
+*/
+
+void
+im_scratch_release(im_context_t ctx, im_scratch_mark_t mark) {
+  im_scratch_block_t *block = mark.block;
+
+  if (block) {
+    block->used = mark.used;
+    ctx->scratch_cur = block;
+  }
+  else {
+    /* the outermost operation is done, trim what we keep */
+    im_scratch_block_t **blockp = &ctx->scratch_first;
+    size_t kept = 0;
+
+    ctx->scratch_cur = NULL;
+    while (*blockp) {
+      block = *blockp;
+      if (kept + block->size > SCRATCH_KEEP) {
+	*blockp = block->next;
+	myfree(block);
+      }
+      else {
+	kept += block->size;
+	blockp = &block->next;
+      }
+    }
+  }
+}
+
+/*
+=item im_int_scratch_free(ctx)
+
+Release the blocks of the context's scratch arena, called when the
+context is destroyed.
+
+=cut
+*/
+
+void
+im_int_scratch_free(im_context_t ctx) {
+  im_scratch_block_t *block = ctx->scratch_first;
+
+  while (block) {
+    im_scratch_block_t *next = block->next;
+    myfree(block);
+    block = next;
+  }
+  ctx->scratch_first = ctx->scratch_cur = NULL;
+}
@@ -0,0 +1,291 @@
+/*
+=head1 NAME
+
+convsimd.c - row kernels for separable convolution
+
+=head1 SYNOPSIS
+
+  const i_conv_kernels *kernels = i_conv_kernels_get();
+
+  kernels->conv_8(out, taps, coeff, tap_count, count, pc, 0.5);
+
+=head1 DESCRIPTION
+
+Implements the inner loops of i_conv() and i_gaussian2() for images
+with 8-bit and double samples stored directly in memory.
+
+Each kernel calculates:
+
+  out[i] = clamp(sum(coeff[c] * taps[c][i]) / pc + round)
+
+for C<i> from 0 to C<count>-1, where C<taps> is an array of
+C<tap_count> pointers into the sample data.  For a horizontal pass the
+tap pointers are the same row offset by a pixel each, for a vertical
+pass they point at the rows above and below.
+
+The scalar kernels match the results of the per-pixel code exactly.
+The SSE2 and AVX2 kernels for double samples also match exactly, the
+8-bit kernels accumulate in single precision, and may differ by one in
+the final sample value.
+
+The best kernels supported by the CPU are selected at runtime.
+
+=over
+
+=cut
+*/
+
+#define IMAGER_NO_CONTEXT
+#include "imageri.h"
+
+#ifdef IMAGER_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static int simd_limit = IM_SIMD_AVX2;
+
+/* also used for the samples left over by the vector kernels */
+static void
+conv_8_tail(i_sample_t *out, const i_sample_t *const *taps,
+	    const double *coeff, int tap_count, size_t i, size_t count,
+	    double pc, double round) {
+  int c;
+
+  for (; i < count; ++i) {
+    double res = 0;
+    double temp;
+    for (c = 0; c < tap_count; ++c)
+      res += taps[c][i] * coeff[c];
+    temp = res / pc + round;
+    out[i] = temp < 0 ? 0 : temp > 255 ? 255 : (i_sample_t)temp;
+  }
+}
+
+static void
+conv_double_tail(double *out, const double *const *taps,
+		 const double *coeff, int tap_count, size_t i, size_t count,
+		 double pc) {
+  int c;
+
+  for (; i < count; ++i) {
+    double res = 0;
+    double temp;
+    for (c = 0; c < tap_count; ++c)
+      res += taps[c][i] * coeff[c];
+    temp = res / pc;
+    out[i] = temp < 0 ? 0 : temp > 1.0 ? 1.0 : temp;
+  }
+}
+
+static void
+conv_8_scalar(i_sample_t *out, const i_sample_t *const *taps,
+	      const double *coeff, int tap_count, size_t count,
+	      double pc, double round) {
+  conv_8_tail(out, taps, coeff, tap_count, 0, count, pc, round);
+}
+
+static void
+conv_double_scalar(double *out, const double *const *taps,
+		   const double *coeff, int tap_count, size_t count,
+		   double pc) {
+  conv_double_tail(out, taps, coeff, tap_count, 0, count, pc);
+}
+
+static const i_conv_kernels
+scalar_kernels =
+  {
+    "scalar",
+    IM_SIMD_NONE,
+    conv_8_scalar,
+    conv_double_scalar
+  };
+
+#ifdef IMAGER_SIMD_X86
+
+/* 8-bit samples are accumulated in single precision, which is plenty
+   for 255 * the coefficients */
+__attribute__((target("sse2")))
+static void
+conv_8_sse2(i_sample_t *out, const i_sample_t *const *taps,
+	    const double *coeff, int tap_count, size_t count,
+	    double pc, double round) {
+  size_t i = 0;
+  int c;
+  const __m128 vpc = _mm_set1_ps((float)pc);
+  const __m128 vround = _mm_set1_ps((float)round);
+  const __m128 vzero = _mm_setzero_ps();
+  const __m128 vmax = _mm_set1_ps(255.0f);
+  const __m128i izero = _mm_setzero_si128();
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 acc = _mm_setzero_ps();
+    __m128i packed;
+    int result;
+    for (c = 0; c < tap_count; ++c) {
+      int raw;
+      __m128i in;
+      memcpy(&raw, taps[c] + i, 4);
+      in = _mm_cvtsi32_si128(raw);
+      in = _mm_unpacklo_epi8(in, izero);
+      in = _mm_unpacklo_epi16(in, izero);
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(in),
+				       _mm_set1_ps((float)coeff[c])));
+    }
+    acc = _mm_add_ps(_mm_div_ps(acc, vpc), vround);
+    acc = _mm_min_ps(_mm_max_ps(acc, vzero), vmax);
+    packed = _mm_cvttps_epi32(acc);
+    packed = _mm_packs_epi32(packed, packed);
+    packed = _mm_packus_epi16(packed, packed);
+    result = _mm_cvtsi128_si32(packed);
+    memcpy(out + i, &result, 4);
+  }
+
+  conv_8_tail(out, taps, coeff, tap_count, i, count, pc, round);
+}
+
+__attribute__((target("sse2")))
+static void
+conv_double_sse2(double *out, const double *const *taps,
+		 const double *coeff, int tap_count, size_t count,
+		 double pc) {
+  size_t i = 0;
+  int c;
+  const __m128d vpc = _mm_set1_pd(pc);
+  const __m128d vzero = _mm_setzero_pd();
+  const __m128d vmax = _mm_set1_pd(1.0);
+
+  for (; i + 2 <= count; i += 2) {
+    __m128d acc = _mm_setzero_pd();
+    for (c = 0; c < tap_count; ++c)
+      acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(taps[c] + i),
+				       _mm_set1_pd(coeff[c])));
+    acc = _mm_div_pd(acc, vpc);
+    _mm_storeu_pd(out + i, _mm_min_pd(_mm_max_pd(acc, vzero), vmax));
+  }
+  conv_double_tail(out, taps, coeff, tap_count, i, count, pc);
+}
+
+static const i_conv_kernels
+sse2_kernels =
+  {
+    "sse2",
+    IM_SIMD_SSE2,
+    conv_8_sse2,
+    conv_double_sse2
+  };
+
+__attribute__((target("avx2")))
+static void
+conv_8_avx2(i_sample_t *out, const i_sample_t *const *taps,
+	    const double *coeff, int tap_count, size_t count,
+	    double pc, double round) {
+  size_t i = 0;
+  int c;
+  const __m256 vpc = _mm256_set1_ps((float)pc);
+  const __m256 vround = _mm256_set1_ps((float)round);
+  const __m256 vzero = _mm256_setzero_ps();
+  const __m256 vmax = _mm256_set1_ps(255.0f);
+
+  for (; i + 8 <= count; i += 8) {
+    __m256 acc = _mm256_setzero_ps();
+    __m256i work;
+    __m128i packed;
+    for (c = 0; c < tap_count; ++c) {
+      __m256i in = _mm256_cvtepu8_epi32
+	(_mm_loadl_epi64((const __m128i *)(taps[c] + i)));
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_cvtepi32_ps(in),
+					     _mm256_set1_ps((float)coeff[c])));
+    }
+    acc = _mm256_add_ps(_mm256_div_ps(acc, vpc), vround);
+    acc = _mm256_min_ps(_mm256_max_ps(acc, vzero), vmax);
+    work = _mm256_cvttps_epi32(acc);
+    packed = _mm_packus_epi32(_mm256_castsi256_si128(work),
+			      _mm256_extracti128_si256(work, 1));
+    packed = _mm_packus_epi16(packed, packed);
+    _mm_storel_epi64((__m128i *)(out + i), packed);
+  }
+
+  conv_8_tail(out, taps, coeff, tap_count, i, count, pc, round);
+}
+
+__attribute__((target("avx2")))
+static void
+conv_double_avx2(double *out, const double *const *taps,
+		 const double *coeff, int tap_count, size_t count,
+		 double pc) {
+  size_t i = 0;
+  int c;
+  const __m256d vpc = _mm256_set1_pd(pc);
+  const __m256d vzero = _mm256_setzero_pd();
+  const __m256d vmax = _mm256_set1_pd(1.0);
+
+  /* the multiply and add are kept separate, since a fused
+     multiply-add would round differently to the scalar code */
+  for (; i + 4 <= count; i += 4) {
+    __m256d acc = _mm256_setzero_pd();
+    for (c = 0; c < tap_count; ++c)
+      acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(taps[c] + i),
+					     _mm256_set1_pd(coeff[c])));
+    acc = _mm256_div_pd(acc, vpc);
+    _mm256_storeu_pd(out + i, _mm256_min_pd(_mm256_max_pd(acc, vzero), vmax));
+  }
+  conv_double_tail(out, taps, coeff, tap_count, i, count, pc);
+}
+
+static const i_conv_kernels
+avx2_kernels =
+  {
+    "avx2",
+    IM_SIMD_AVX2,
+    conv_8_avx2,
+    conv_double_avx2
+  };
+
+#endif
+
+/*
+=item i_conv_kernels_get()
+
+Return the best set of convolution kernels supported by the CPU, and
+allowed by i_simd_set_limit().
+
+=cut
+*/
+
+const i_conv_kernels *
+i_conv_kernels_get(void) {
+#ifdef IMAGER_SIMD_X86
+  if (simd_limit >= IM_SIMD_AVX2 && __builtin_cpu_supports("avx2"))
+    return &avx2_kernels;
+  if (simd_limit >= IM_SIMD_SSE2 && __builtin_cpu_supports("sse2"))
+    return &sse2_kernels;
+#endif
+
+  return &scalar_kernels;
+}
+
+/*
+=item i_simd_set_limit(limit)
+
+Limit the kernels selected by i_conv_kernels_get() to at most
+C<limit>, one of C<IM_SIMD_NONE>, C<IM_SIMD_SSE2> or C<IM_SIMD_AVX2>.
+
+This is process wide and intended for testing.
+
+=cut
+*/
+
+void
+i_simd_set_limit(int limit) {
+  simd_limit = limit;
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+conv.im, gaussian.im
+
+=cut
+*/
@@ -1199,6 +1199,7 @@ void
 i_box_filled(i_img *im,i_img_dim x1,i_img_dim y1,i_img_dim x2,i_img_dim y2, const i_color *val) {
   i_img_dim x, y, width;
   i_palidx index;
+  im_scratch_mark_t mark;
   dIMCTXim(im);
 
   im_log((aIMCTX,1,"i_box_filled(im* %p, p1(" i_DFp "), p2(" i_DFp "),val %p)\n",
@@ -1220,29 +1221,27 @@ i_box_filled(i_img *im,i_img_dim x1,i_img_dim y1,i_img_dim x2,i_img_dim y2, cons
 
   width = x2 - x1 + 1;
 
+  mark = im_scratch_mark(aIMCTX);
   if (im->type == i_palette_type
       && i_findcolor(im, val, &index)) {
-    i_palidx *line = mymalloc(sizeof(i_palidx) * width);
+    i_palidx *line = im_scratch_alloc(aIMCTX, sizeof(i_palidx) * width);
 
     for (x = 0; x < width; ++x)
       line[x] = index;
 
     for (y = y1; y <= y2; ++y)
       i_ppal(im, x1, x2+1, y, line);
-
-    myfree(line);
   }
   else {
-    i_color *line = mymalloc(sizeof(i_color) * width);
+    i_color *line = im_scratch_alloc(aIMCTX, sizeof(i_color) * width);
 
     for (x = 0; x < width; ++x)
       line[x] = *val;
 
     for (y = y1; y <= y2; ++y)
       i_plin(im, x1, x2+1, y, line);
-
-    myfree(line);
   }
+  im_scratch_release(aIMCTX, mark);
 }
 
 /*
@@ -1291,7 +1290,8 @@ i_box_filledf(i_img *im,i_img_dim x1,i_img_dim y1,i_img_dim x2,i_img_dim y2, con
     i_box_filled(im, x1, y1, x2, y2, &c);
   }
   else {
-    i_fcolor *line = mymalloc(sizeof(i_fcolor) * width);
+    im_scratch_mark_t mark = im_scratch_mark(aIMCTX);
+    i_fcolor *line = im_scratch_alloc(aIMCTX, sizeof(i_fcolor) * width);
     
     for (x = 0; x < width; ++x)
       line[x] = *val;
@@ -1299,7 +1299,7 @@ i_box_filledf(i_img *im,i_img_dim x1,i_img_dim y1,i_img_dim x2,i_img_dim y2, con
     for (y = y1; y <= y2; ++y)
       i_plinf(im, x1, x2+1, y, line);
     
-    myfree(line);
+    im_scratch_release(aIMCTX, mark);
   }
   
   return 1;
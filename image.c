@@ -247,6 +247,12 @@ void i_fcolor_destroy(i_fcolor *cl) {
   myfree(cl);
 }
 
+/* reference count for image storage shared between images by i_copy(),
+   kept in im_data of each image sharing the storage */
+typedef struct {
+  size_t refs;
+} i_img_shared_t;
+
 /* 
 =item i_img_exorcise(im)
 
@@ -264,6 +270,18 @@ i_img_exorcise(i_img *im) {
   i_tags_destroy(&im->tags);
   if (im->i_f_destroy)
     (im->i_f_destroy)(im);
+  if (im->im_data) {
+    /* storage shared by i_copy(), only the last reference frees it */
+    i_img_shared_t *shared = im->im_data;
+    if (shared->refs > 1) {
+      --shared->refs;
+      im->idata = NULL;
+    }
+    else {
+      myfree(shared);
+    }
+    im->im_data = NULL;
+  }
   if (im->idata != NULL) { myfree(im->idata); }
   im->idata    = NULL;
   im->xsize    = 0;
@@ -522,6 +540,76 @@ i_copyto_trans(i_img *im,i_img *src,i_img_dim x1,i_img_dim y1,i_img_dim x2,i_img
     }
 }
 
+/*
+=item i_img_unshare_storage(im)
+
+Gives im its own copy of image storage it shares with other images
+after i_copy().
+
+Called through the i_img_unshare() macro by the write functions of the
+built-in image types and by code that writes to idata directly.
+
+=cut
+*/
+
+void
+i_img_unshare_storage(i_img *im) {
+  i_img_shared_t *shared = im->im_data;
+
+  if (shared->refs > 1) {
+    unsigned char *data = mymalloc(im->bytes);
+    memcpy(data, im->idata, im->bytes);
+    im->idata = data;
+    --shared->refs;
+  }
+  else {
+    /* the other images have been destroyed */
+    myfree(shared);
+  }
+  im->im_data = NULL;
+}
+
+/*
+=item img_share(src)
+
+Create a new image sharing the storage of src.
+
+Only valid for the non-virtual built-in image types.
+
+=cut
+*/
+
+static i_img *
+img_share(i_img *src) {
+  dIMCTXim(src);
+  i_img *im = im_img_alloc(aIMCTX);
+  i_img_shared_t *shared = src->im_data;
+
+  *im = *src;
+  i_tags_new(&im->tags);
+  im->ch_mask = ~0U;
+  if (src->type == i_palette_type) {
+    i_img_pal_ext *src_ext = src->ext_data;
+    i_img_pal_ext *ext = mymalloc(sizeof(i_img_pal_ext));
+
+    *ext = *src_ext;
+    ext->pal = mymalloc(sizeof(i_color) * ext->alloc);
+    memcpy(ext->pal, src_ext->pal, sizeof(i_color) * ext->count);
+    im->ext_data = ext;
+  }
+  im_img_init(aIMCTX, im);
+
+  if (!shared) {
+    shared = mymalloc(sizeof(i_img_shared_t));
+    shared->refs = 1;
+    src->im_data = shared;
+  }
+  ++shared->refs;
+  im->im_data = shared;
+
+  return im;
+}
+
 /*
 =item i_copy(source)
 
@@ -531,6 +619,10 @@ Creates a new image that is a copy of the image C<source>.
 
 Tags are not copied, only the image data.
 
+For the built-in image types the new image shares the image storage
+with C<source> until either image is written to, so the copy is cheap
+until then.  For tiled images only the tiles written to are copied.
+
 Returns: i_img *
 
 =cut
@@ -540,10 +632,19 @@ i_img *
 i_copy(i_img *src) {
   i_img_dim y, y1, x1;
   dIMCTXim(src);
-  i_img *im = i_sametype(src, src->xsize, src->ysize);
+  i_img *im;
 
   im_log((aIMCTX,1,"i_copy(src %p)\n", src));
 
+  if ((im = i_img_tiled_share(src)) != NULL)
+    return im;
+
+  if (!src->virtual
+      && (i_img_8_cow(src) || i_img_16_cow(src) || i_img_double_cow(src)
+	  || i_img_pal_cow(src)))
+    return img_share(src);
+
+  im = i_sametype(src, src->xsize, src->ysize);
   if (!im)
     return NULL;
 
@@ -605,19 +706,32 @@ Lanczos(float x) {
 }
 
 
-/*
-=item i_scaleaxis(im, value, axis)
-
-Returns a new image object which is I<im> scaled by I<value> along
-wither the x-axis (I<axis> == 0) or the y-axis (I<axis> == 1).
-
-=cut
-*/
-
-i_img*
-i_scaleaxis(i_img *im, double Value, int Axis) {
-  i_img_dim hsize, vsize, i, j, k, l, lMax, iEnd, jEnd;
+typedef struct {
+  i_img *im;
+  i_img *new_img;
+  int axis;
+  double value;
+  i_img_dim iEnd;
   i_img_dim LanczosWidthFactor;
+  i_img_dim lMax;
+  int has_alpha;
+  int color_chans;
+} scaleaxis_state;
+
+/* calculate output columns (XAXIS) or rows (YAXIS) start to end-1 */
+static void
+scaleaxis_band(void *p, i_img_dim start, i_img_dim end) {
+  scaleaxis_state *state = p;
+  i_img *im = state->im;
+  i_img *new_img = state->new_img;
+  int Axis = state->axis;
+  double Value = state->value;
+  i_img_dim iEnd = state->iEnd;
+  i_img_dim LanczosWidthFactor = state->LanczosWidthFactor;
+  i_img_dim lMax = state->lMax;
+  int has_alpha = state->has_alpha;
+  int color_chans = state->color_chans;
+  i_img_dim i, j, k, l;
   float *l0, *l1;
   double OldLocation;
   i_img_dim T; 
@@ -625,51 +739,11 @@ i_scaleaxis(i_img *im, double Value, int Axis) {
   float F, PictureValue[MAXCHANNELS];
   short psave;
   i_color val,val1,val2;
-  i_img *new_img;
-  int has_alpha = i_img_has_alpha(im);
-  int color_chans = i_img_color_channels(im);
-  dIMCTXim(im);
-
-  i_clear_error();
-  im_log((aIMCTX, 1,"i_scaleaxis(im %p,Value %.2f,Axis %d)\n",im,Value,Axis));
 
-  if (Axis == XAXIS) {
-    hsize = (i_img_dim)(0.5 + im->xsize * Value);
-    if (hsize < 1) {
-      hsize = 1;
-      Value = 1.0 / im->xsize;
-    }
-    vsize = im->ysize;
-    
-    jEnd = hsize;
-    iEnd = vsize;
-  } else {
-    hsize = im->xsize;
-    vsize = (i_img_dim)(0.5 + im->ysize * Value);
-
-    if (vsize < 1) {
-      vsize = 1;
-      Value = 1.0 / im->ysize;
-    }
-
-    jEnd = vsize;
-    iEnd = hsize;
-  }
+  l0 = im_band_alloc(lMax * sizeof(float));
+  l1 = im_band_alloc(lMax * sizeof(float));
   
-  new_img = i_img_8_new(hsize, vsize, im->channels);
-  if (!new_img) {
-    i_push_error(0, "cannot create output image");
-    return NULL;
-  }
-  
-  /* 1.4 is a magic number, setting it to 2 will cause rather blurred images */
-  LanczosWidthFactor = (Value >= 1) ? 1 : (i_img_dim) (1.4/Value); 
-  lMax = LanczosWidthFactor << 1;
-  
-  l0 = mymalloc(lMax * sizeof(float));
-  l1 = mymalloc(lMax * sizeof(float));
-  
-  for (j=0; j<jEnd; j++) {
+  for (j=start; j<end; j++) {
     OldLocation = ((double) j) / Value;
     T = (i_img_dim) (OldLocation);
     F = OldLocation - T;
@@ -803,8 +877,79 @@ i_scaleaxis(i_img *im, double Value, int Axis) {
       
     }
   }
-  myfree(l0);
-  myfree(l1);
+  im_band_free(l0);
+  im_band_free(l1);
+}
+
+/*
+=item i_scaleaxis(im, value, axis)
+
+Returns a new image object which is I<im> scaled by I<value> along
+wither the x-axis (I<axis> == 0) or the y-axis (I<axis> == 1).
+
+Output columns or rows may be split across the context's worker
+threads.
+
+=cut
+*/
+
+i_img*
+i_scaleaxis(i_img *im, double Value, int Axis) {
+  i_img_dim hsize, vsize, iEnd, jEnd;
+  i_img_dim LanczosWidthFactor;
+  i_img *new_img;
+  scaleaxis_state state;
+  dIMCTXim(im);
+
+  i_clear_error();
+  im_log((aIMCTX, 1,"i_scaleaxis(im %p,Value %.2f,Axis %d)\n",im,Value,Axis));
+
+  if (Axis == XAXIS) {
+    hsize = (i_img_dim)(0.5 + im->xsize * Value);
+    if (hsize < 1) {
+      hsize = 1;
+      Value = 1.0 / im->xsize;
+    }
+    vsize = im->ysize;
+    
+    jEnd = hsize;
+    iEnd = vsize;
+  } else {
+    hsize = im->xsize;
+    vsize = (i_img_dim)(0.5 + im->ysize * Value);
+
+    if (vsize < 1) {
+      vsize = 1;
+      Value = 1.0 / im->ysize;
+    }
+
+    jEnd = vsize;
+    iEnd = hsize;
+  }
+  
+  new_img = i_img_8_new(hsize, vsize, im->channels);
+  if (!new_img) {
+    i_push_error(0, "cannot create output image");
+    return NULL;
+  }
+  
+  /* 1.4 is a magic number, setting it to 2 will cause rather blurred images */
+  LanczosWidthFactor = (Value >= 1) ? 1 : (i_img_dim) (1.4/Value); 
+
+  state.im = im;
+  state.new_img = new_img;
+  state.axis = Axis;
+  state.value = Value;
+  state.iEnd = iEnd;
+  state.LanczosWidthFactor = LanczosWidthFactor;
+  state.lMax = LanczosWidthFactor << 1;
+  state.has_alpha = i_img_has_alpha(im);
+  state.color_chans = i_img_color_channels(im);
+
+  if (i_img_band_safe(im))
+    im_run_bands(aIMCTX, 0, jEnd, scaleaxis_band, &state);
+  else
+    scaleaxis_band(&state, 0, jEnd);
 
   im_log((aIMCTX, 1,"(%p) <- i_scaleaxis\n", new_img));
 
@@ -950,16 +1095,21 @@ L<transform.c/i_transform2>.
 
 Returns the new image.
 
-The operators for this function are defined in L<stackmach.c>.
+The operators for this function are defined in L<stackmach.c>.  They
+are evaluated for a row of output pixels at a time with
+i_op_run_batch(), and the source pixels are fetched with i_glin() where
+a run of output pixels comes from one source row.
 
 =cut
 */
 i_img*
 i_transform(i_img *im, int *opx,int opxl,int *opy,int opyl,double parm[],int parmlen) {
-  double rx,ry;
   i_img_dim nxsize,nysize,nx,ny;
   i_img *new_img;
   i_color val;
+  double *xs, *ys, *rxs, *rys;
+  i_img_dim *sxs, *sys;
+  i_color *line, *src;
   dIMCTXim(im);
   
   im_log((aIMCTX, 1,"i_transform(im %p, opx %p, opxl %d, opy %p, opyl %d, parm %p, parmlen %d)\n",im,opx,opxl,opy,opyl,parm,parmlen));
@@ -968,22 +1118,85 @@ i_transform(i_img *im, int *opx,int opxl,int *opy,int opyl,double parm[],int par
   nysize = im->ysize ;
   
   new_img=i_img_empty_ch(NULL,nxsize,nysize,im->channels);
-  /*   fprintf(stderr,"parm[2]=%f\n",parm[2]);   */
-  for(ny=0;ny<nysize;ny++) for(nx=0;nx<nxsize;nx++) {
-    /*     parm[parmlen-2]=(double)nx;
-	   parm[parmlen-1]=(double)ny; */
+  if (!new_img)
+    return NULL;
 
-    parm[0]=(double)nx;
-    parm[1]=(double)ny;
+  /* the programs are evaluated for a row at a time, and runs of
+     pixels that come from a single source row are fetched with one
+     i_glin() call */
+  xs = mymalloc(sizeof(double) * nxsize * 4);
+  ys = xs + nxsize;
+  rxs = ys + nxsize;
+  rys = rxs + nxsize;
+  sxs = mymalloc(sizeof(i_img_dim) * nxsize * 2);
+  sys = sxs + nxsize;
+  line = mymalloc(sizeof(i_color) * nxsize * 2);
+  src = line + nxsize;
+  for (nx = 0; nx < nxsize; ++nx)
+    xs[nx] = nx;
+
+  /* pixels outside the source image are left to i_gpix(), which
+     doesn't set val for some image types */
+  memset(&val, 0, sizeof(val));
+  for(ny=0;ny<nysize;ny++) {
+    for (nx = 0; nx < nxsize; ++nx)
+      ys[nx] = ny;
+    i_op_run_batch(opx, opxl, parm, parmlen, xs, ys, nxsize, rxs);
+    i_op_run_batch(opy, opyl, parm, parmlen, xs, ys, nxsize, rys);
+    for (nx = 0; nx < nxsize; ++nx) {
+      sxs[nx] = rxs[nx];
+      sys[nx] = rys[nx];
+    }
 
-    /*     fprintf(stderr,"(%d,%d) ->",nx,ny);  */
-    rx=i_op_run(opx,opxl,parm,parmlen);
-    ry=i_op_run(opy,opyl,parm,parmlen);
-    /*    fprintf(stderr,"(%f,%f)\n",rx,ry); */
-    i_gpix(im,rx,ry,&val);
-    i_ppix(new_img,nx,ny,&val);
+    nx = 0;
+    while (nx < nxsize) {
+      i_img_dim sy = sys[nx];
+      i_img_dim end = nx;
+      i_img_dim minx = im->xsize, maxx = -1;
+
+      /* find the run of pixels from source row sy, and the source
+	 columns they cover */
+      if (sy >= 0 && sy < im->ysize) {
+	while (end < nxsize && sys[end] == sy) {
+	  i_img_dim sx = sxs[end];
+	  if (sx >= 0 && sx < im->xsize) {
+	    if (sx < minx)
+	      minx = sx;
+	    if (sx > maxx)
+	      maxx = sx;
+	  }
+	  ++end;
+	}
+      }
+      else {
+	++end;
+      }
+
+      if (maxx >= minx && maxx - minx < (end - nx) * 4 + 16) {
+	i_glin(im, minx, maxx+1, sy, src);
+	for (; nx < end; ++nx) {
+	  i_img_dim sx = sxs[nx];
+	  if (sx >= 0 && sx < im->xsize)
+	    val = src[sx - minx];
+	  else
+	    i_gpix(im, sx, sy, &val);
+	  line[nx] = val;
+	}
+      }
+      else {
+	for (; nx < end; ++nx) {
+	  i_gpix(im, sxs[nx], sys[nx], &val);
+	  line[nx] = val;
+	}
+      }
+    }
+    i_plin(new_img, 0, nxsize, ny, line);
   }
 
+  myfree(xs);
+  myfree(sxs);
+  myfree(line);
+
   im_log((aIMCTX, 1,"(%p) <- i_transform\n",new_img));
   return new_img;
 }
@@ -180,11 +180,25 @@ undef_int i_flood_cfill_border(i_img *im, i_img_dim seedx, i_img_dim seedy, i_fi
 
 int i_gaussian    (i_img *im, double stddev);
 int i_gaussian2    (i_img *im, double stddevX, double stddevY);
+int i_gaussian2_box(i_img *im, double stddevX, double stddevY);
 int i_conv        (i_img *im,const double *coeff,int len);
 void i_unsharp_mask(i_img *im, double stddev, double scale);
 
+/* row streams */
+extern void im_row_source_init(pIMCTX, i_row_source *src, i_img_dim xsize, i_img_dim ysize, int channels, i_row_source_read_f f_read, i_row_source_destroy_f f_destroy);
+extern void im_row_sink_init(pIMCTX, i_row_sink *sink, i_img_dim xsize, i_img_dim ysize, int channels, i_row_sink_write_f f_write, i_row_sink_close_f f_close, i_row_sink_destroy_f f_destroy);
+extern i_img_dim i_row_source_read(i_row_source *src, i_color *rows, i_img_dim count);
+extern void i_row_source_destroy(i_row_source *src);
+extern int i_row_sink_write(i_row_sink *sink, const i_color *rows, i_img_dim count);
+extern int i_row_sink_close(i_row_sink *sink);
+extern void i_row_sink_destroy(i_row_sink *sink);
+extern i_row_source *i_row_source_img(i_img *im);
+extern i_img *i_row_source_to_img(i_row_source *src);
+extern int i_rows_copy(i_row_source *src, i_row_sink *sink);
+
 /* colour manipulation */
 extern i_img *i_convert(i_img *src, const double *coeff, int outchan, int inchan);
+extern i_row_source *i_row_source_convert(i_row_source *src, const double *coeff, int outchan, int inchan);
 extern void i_map(i_img *im, unsigned char (*maps)[256], unsigned int mask);
 
 float i_img_diff   (i_img *im1,i_img *im2);
@@ -214,6 +228,7 @@ size_t i_tt_glyph_name(TT_Fonthandle *handle, unsigned long ch, char *name_buf,
 extern void i_quant_makemap(i_quantize *quant, i_img **imgs, int count);
 extern i_palidx *i_quant_translate(i_quantize *quant, i_img *img);
 extern void i_quant_transparent(i_quantize *quant, i_palidx *indices, i_img *img, i_palidx trans_index);
+extern void i_quant_cleanup(i_quantize *quant);
 
 i_img *im_img_pal_new(pIMCTX, i_img_dim x, i_img_dim y, int ch, int maxpal);
 
@@ -225,6 +240,13 @@ extern i_img *im_img_16_new(pIMCTX, i_img_dim x, i_img_dim y, int ch);
 extern i_img *i_img_to_rgb16(i_img *im);
 extern i_img *im_img_double_new(pIMCTX, i_img_dim x, i_img_dim y, int ch);
 extern i_img *i_img_to_drgb(i_img *im);
+extern i_img *im_img_tiled_new(pIMCTX, i_img_dim x, i_img_dim y, int ch,
+			       int bits, const i_fcolor *bg);
+extern int i_img_tiled_count(i_img *im, size_t *allocated, size_t *total);
+extern i_img *im_img_mmap_new(pIMCTX, const char *filename, i_img_dim x,
+			      i_img_dim y, int ch, int bits, int mode,
+			      off_t offset);
+extern int i_img_mmap_flush(i_img *im);
 
 extern int i_img_is_monochrome(i_img *im, int *zero_is_white);
 extern int i_get_file_background(i_img *im, i_color *bg);
@@ -246,6 +268,8 @@ undef_int i_writeraw_wiol(i_img* im, io_glue *ig);
 i_img   * i_readpnm_wiol(io_glue *ig, int allow_incomplete);
 i_img   ** i_readpnm_multi_wiol(io_glue *ig, int *count, int allow_incomplete);
 undef_int i_writeppm_wiol(i_img *im, io_glue *ig);
+i_row_source *i_readpnm_rows_wiol(io_glue *ig);
+i_row_sink *i_writepnm_rows_wiol(io_glue *ig, i_img_dim xsize, i_img_dim ysize, int channels);
 
 extern int    i_writebmp_wiol(i_img *im, io_glue *ig);
 extern i_img *i_readbmp_wiol(io_glue *ig, int allow_incomplete);
@@ -261,6 +285,7 @@ undef_int i_writergb_wiol(i_img *img, io_glue *ig, int wierdpack, int compress,
 i_img * i_scaleaxis(i_img *im, double Value, int Axis);
 i_img * i_scale_nn(i_img *im, double scx, double scy);
 i_img * i_scale_mixing(i_img *src, i_img_dim width, i_img_dim height);
+i_row_source *i_row_source_scale(i_row_source *src, i_img_dim width, i_img_dim height);
 i_img * i_haar(i_img *im);
 int     i_count_colors(i_img *im,int maxc);
 int i_get_anonymous_color_histo(i_img *im, unsigned int **col_usage, int maxc);
@@ -407,6 +432,10 @@ extern im_context_t im_context_clone(im_context_t ctx, const char *where);
 extern im_slot_t im_context_slot_new(im_slot_destroy_t);
 extern void *im_context_slot_get(im_context_t ctx, im_slot_t slot);
 extern int im_context_slot_set(im_context_t ctx, im_slot_t slot, void *);
+extern int im_set_thread_count(im_context_t ctx, int count);
+extern int im_get_thread_count(im_context_t ctx);
+extern int im_set_io_buffer_size(im_context_t ctx, size_t size, size_t max_size);
+extern void im_get_io_buffer_size(im_context_t ctx, size_t *size, size_t *max_size);
 
 extern im_context_t (*im_get_context)(void);
 
@@ -128,6 +128,19 @@ struct im_file_magic {
   im_file_magic *next;
 };
 
+/* worker thread pool, see workpthr.c */
+typedef struct im_workers_tag im_workers_t;
+
+/* processes rows start to end-1 */
+typedef void (*im_band_func_t)(void *data, i_img_dim start, i_img_dim end);
+
+/* processes columns x_start to x_end-1 of row y */
+typedef void (*im_wave_func_t)(void *data, i_img_dim y, i_img_dim x_start,
+			       i_img_dim x_end);
+
+/* scratch arena storage, see context.c */
+typedef struct im_scratch_block_tag im_scratch_block_t;
+
 #define IM_ERROR_COUNT 20
 typedef struct im_context_tag {
   int error_sp;
@@ -157,11 +170,108 @@ typedef struct im_context_tag {
   /* registered file type magic */
   im_file_magic *file_magic;
 
+  /* threads to split image processing across, and the pool doing it */
+  int thread_count;
+  im_workers_t *workers;
+
+  /* default buffer sizes for new I/O layers */
+  size_t io_buf_size;
+  size_t io_buf_max;
+
+  /* free buffer chain blocks kept for reuse */
+  void *bchain_pool;
+  size_t bchain_pool_count;
+
+  /* scratch arena blocks, and the block being allocated from */
+  im_scratch_block_t *scratch_first;
+  im_scratch_block_t *scratch_cur;
+
   ptrdiff_t refcount;
 } im_context_struct;
 
 #define DEF_BYTES_LIMIT 0x40000000
 
+#define IM_MAX_THREADS 256
+
+/* default, minimum and maximum I/O layer buffer sizes */
+#define IO_BUF_SIZE 8192
+#define IO_MIN_BUF_SIZE 256
+#define IO_MAX_BUF_SIZE 0x4000000
+
+extern int
+im_int_check_io_buffer_size(im_context_t ctx, size_t size, size_t *max_size);
+extern i_img_dim
+im_int_io_strip_rows(size_t row_size, i_img_dim height);
+extern void
+im_int_bchain_pool_free(im_context_t ctx);
+
+/* temporary buffers released together at the end of an operation,
+   only for the thread calling into Imager, not band functions */
+extern im_scratch_mark_t im_scratch_mark(im_context_t ctx);
+extern void *im_scratch_alloc(im_context_t ctx, size_t size);
+extern void im_scratch_release(im_context_t ctx, im_scratch_mark_t mark);
+extern void im_int_scratch_free(im_context_t ctx);
+
+extern void
+im_run_bands(im_context_t ctx, i_img_dim start, i_img_dim end,
+	     im_band_func_t func, void *data);
+extern void
+im_run_wavefront(im_context_t ctx, i_img_dim width, i_img_dim height,
+		 i_img_dim step, i_img_dim lead, im_wave_func_t func,
+		 void *data);
+extern void im_workers_destroy(im_workers_t *workers);
+extern void *im_band_alloc(size_t size);
+extern void im_band_free(void *p);
+
+/* true if rows of the image can be read and written from multiple
+   threads, as long as each row is only written by one thread */
+#define i_img_band_safe(im) ((im)->type == i_direct_type && !(im)->virtual)
+
+/* true if the image samples can be accessed directly through idata
+   as i_sample_t or i_fsample_t, without regard to the channel mask */
+#define i_img_direct_samples(im) \
+  (!(im)->virtual && (im)->type == i_direct_type \
+   && ((im)->bits == i_8_bits || (im)->bits == i_double_bits) \
+   && I_ALL_CHANNELS_WRITABLE(im))
+
+/* the number of bytes per pixel if the image's pixels can be moved
+   around as blocks of memory through idata, or zero */
+#define i_img_pixel_bytes(im) \
+  ((im)->virtual ? 0 \
+   : (im)->type == i_palette_type ? sizeof(i_palidx) \
+   : I_ALL_CHANNELS_WRITABLE(im) ? (size_t)(im)->channels * ((im)->bits / 8) \
+   : 0)
+
+/* copy-on-write storage: i_copy() shares idata between images of the
+   built-in types, and they call i_img_unshare() before writing to it */
+#define i_img_unshare(im) \
+  ((im)->im_data ? i_img_unshare_storage(im) : (void)0)
+extern void i_img_unshare_storage(i_img *im);
+extern int i_img_8_cow(const i_img *im);
+extern int i_img_16_cow(const i_img *im);
+extern int i_img_double_cow(const i_img *im);
+extern int i_img_pal_cow(const i_img *im);
+extern i_img *i_img_tiled_share(i_img *src);
+
+/* row kernels for separable convolution, see convsimd.c */
+#define IM_SIMD_NONE 0
+#define IM_SIMD_SSE2 1
+#define IM_SIMD_AVX2 2
+
+typedef struct {
+  const char *name;
+  int level;
+  void (*conv_8)(i_sample_t *out, const i_sample_t *const *taps,
+		 const double *coeff, int tap_count, size_t count,
+		 double pc, double round);
+  void (*conv_double)(double *out, const double *const *taps,
+		      const double *coeff, int tap_count, size_t count,
+		      double pc);
+} i_conv_kernels;
+
+extern const i_conv_kernels *i_conv_kernels_get(void);
+extern void i_simd_set_limit(int limit);
+
 #define im_size_t_max (~(size_t)0)
 
 #endif
@@ -172,6 +172,13 @@ typedef enum {
   i_double_bits = sizeof(double) * 8
 } i_img_bits_t;
 
+/* how im_img_mmap_new() maps a named file */
+typedef enum {
+  i_mmap_read, /* existing file, changes aren't written back */
+  i_mmap_update, /* existing file, changes are written back */
+  i_mmap_create /* created or extended as needed, changes written back */
+} i_mmap_mode_t;
+
 typedef struct {
   char *name; /* name of a given tag, might be NULL */
   int code; /* number of a given tag, -1 if it has no meaning */
@@ -630,6 +637,91 @@ typedef struct i_fill_tag
   i_fill_combinef_f combinef;
 } i_fill_t;
 
+typedef struct i_row_source_tag i_row_source;
+typedef struct i_row_sink_tag i_row_sink;
+
+typedef i_img_dim (*i_row_source_read_f)(i_row_source *src, i_color *rows,
+					 i_img_dim count);
+typedef void (*i_row_source_destroy_f)(i_row_source *src);
+
+typedef int (*i_row_sink_write_f)(i_row_sink *sink, const i_color *rows,
+				  i_img_dim count);
+typedef int (*i_row_sink_close_f)(i_row_sink *sink);
+typedef void (*i_row_sink_destroy_f)(i_row_sink *sink);
+
+/*
+=item i_row_source
+=category Data Types
+=synopsis i_row_source *src = i_readpnm_rows_wiol(ig);
+
+The base type for a stream of 8-bit/sample rows, read from the top
+of an image to the bottom.
+
+Use i_row_source_read() to fetch rows and i_row_source_destroy() to
+release the source.
+
+To implement a new source, embed C<i_row_source> as the first member
+of your own structure, initialize it with i_row_source_init() and
+supply a read and a destroy function.
+
+=cut
+*/
+
+struct i_row_source_tag {
+  im_context_t context;
+  i_img_dim xsize;
+  i_img_dim ysize;
+  int channels;
+
+  /* the number of rows read so far */
+  i_img_dim row;
+
+  /* read count rows into rows, count is never more than the rows
+     remaining.  Returns the number of rows read or -1 on error */
+  i_row_source_read_f f_read;
+
+  /* release any resources, but not the source itself */
+  i_row_source_destroy_f f_destroy;
+};
+
+/*
+=item i_row_sink
+=category Data Types
+=synopsis i_row_sink *sink = i_writepnm_rows_wiol(ig, xsize, ysize, channels);
+
+The base type for a destination for 8-bit/sample rows, written from
+the top of an image to the bottom.
+
+Use i_row_sink_write() to write rows, i_row_sink_close() once all of
+the rows have been written, and i_row_sink_destroy() to release the
+sink.
+
+=cut
+*/
+
+struct i_row_sink_tag {
+  im_context_t context;
+  i_img_dim xsize;
+  i_img_dim ysize;
+  int channels;
+
+  /* the number of rows written so far */
+  i_img_dim row;
+
+  /* non-zero once i_row_sink_close() has been called */
+  int closed;
+
+  /* write count rows, returns non-zero on success */
+  i_row_sink_write_f f_write;
+
+  /* finish writing the file after the last row, returns non-zero on
+     success */
+  i_row_sink_close_f f_close;
+
+  /* release any resources, but not the sink itself */
+  i_row_sink_destroy_f f_destroy;
+};
+
 typedef enum {
   ic_none,
   ic_normal,
@@ -756,6 +848,11 @@ C<mc_median_cut> - use median cut
 
 =item *
 
+C<mc_wu> - use Wu's variance minimizing quantizer, keeping any
+existing fixed colors.
+
+=item *
+
 C<mono> - use a fixed black and white map.
 
 =item *
@@ -784,6 +881,7 @@ typedef enum i_make_colors_tag {
   mc_gray, /* 256 gray map */
   mc_gray4, /* four step gray map */
   mc_gray16, /* sixteen step gray map */
+  mc_wu, /* Wu's variance minimizing quantizer */
   mc_mask = 0xFF /* (mask for generator) */
 } i_make_colors;
 
@@ -1015,6 +1113,18 @@ row.
 C<perturb> - the amount to perturb pixels when C<translate> is
 C<mc_perturb>.
 
+=item *
+
+C<inverse_map> - version 2 and later only.  A lookup table built by
+i_quant_translate() and kept for later translations with the same
+palette.  Must be NULL initially, release it with i_quant_cleanup().
+
+=item *
+
+C<mc_max_samples> - version 2 and later only.  If non-zero, C<mc_wu>
+only examines about this many pixels, taken from a regular grid over
+the images.
+
 =back
 
 =cut
@@ -1058,6 +1168,12 @@ typedef struct i_quantize_tag {
   /* the amount of perturbation to use for translate is mc_perturb */
   int perturb;
   /* version 2 members after here */
+
+  /* cached lookup table for translation, released by i_quant_cleanup() */
+  void *inverse_map;
+
+  /* if non-zero, the approximate number of pixels mc_wu examines */
+  i_img_dim mc_max_samples;
 } i_quantize;
 
 /* distance measures used by some filters */
@@ -1079,6 +1195,12 @@ typedef struct {
 
 typedef struct i_render_tag i_render;
 
+/* a position in a context's scratch arena, see im_scratch_mark() */
+typedef struct {
+  void *block;
+  size_t used;
+} im_scratch_mark_t;
+
 /*
 =item i_color_model_t
 =category Data Types
@@ -326,6 +326,49 @@ im_decode_exif(i_img *im, const unsigned char *data, size_t length) {
   return 1;
 }
 
+/*
+=item im_exif_orientation
+
+=category Files
+=synopsis int orientation = im_exif_orientation(data_base, data_size);
+
+Scan the EXIF data from C<data_base> for C<data_size> bytes for the
+Orientation tag, without decoding anything else.
+
+This lets a file reader find the orientation before it creates the
+image, so it can store pixels in their final orientation as it
+decodes them.
+
+Returns the orientation, from 1 to 8, or 0 if the data is invalid or
+the tag isn't present or has an invalid value.
+
+=cut
+*/
+
+int
+im_exif_orientation(const unsigned char *data, size_t length) {
+  imtiff tiff;
+  int orientation = 0;
+  int i;
+
+  if (!tiff_init(&tiff, data, length))
+    return 0;
+
+  if (tiff_load_ifd(&tiff, tiff.first_ifd_offset)) {
+    for (i = 0; i < tiff.ifd_size; ++i) {
+      if (tiff.ifd[i].tag == tag_orientation) {
+	if (!tiff_get_tag_int(&tiff, i, &orientation)
+	    || orientation < 1 || orientation > 8)
+	  orientation = 0;
+	break;
+      }
+    }
+  }
+  tiff_final(&tiff);
+
+  return orientation;
+}
+
 /*
 
 =back
@@ -218,9 +218,48 @@ im_ext_funcs imager_function_table =
     i_img_color_channels,
 
     /* level 10 */
-    im_decode_exif
+    im_decode_exif,
 
     /* level 11 */
+    i_scale_mixing,
+
+    /* level 12 */
+    im_row_source_init,
+    im_row_sink_init,
+    i_row_source_read,
+    i_row_source_destroy,
+    i_row_sink_write,
+    i_row_sink_close,
+    i_row_sink_destroy,
+    i_adapt_colors_bg,
+
+    /* level 13 */
+    im_io_new_mmap,
+
+    /* level 14 */
+    i_io_set_buffer_size,
+    im_set_io_buffer_size,
+    im_get_io_buffer_size,
+
+    /* level 15 */
+    i_io_writev,
+
+    /* level 16 */
+    i_io_bufchain_spans,
+
+    /* level 17 */
+    im_exif_orientation,
+
+    /* level 18 */
+    im_img_tiled_new,
+
+    /* level 19 */
+    im_img_mmap_new,
+
+    /* level 20 */
+    i_quant_cleanup
+
+    /* level 21 */
   };
 
 /* in general these functions aren't called by Imager internally, but
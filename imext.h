@@ -249,6 +249,46 @@ extern im_ext_funcs *imager_function_ext_table;
 
 #define im_decode_exif(im, data, len) ((im_extt->f_im_decode_exif)((im), (data), (len)))
 
+#define i_scale_mixing(src, width, height) ((im_extt->f_i_scale_mixing)((src), (width), (height)))
+
+#define im_row_source_init(ctx, src, xsize, ysize, channels, f_read, f_destroy) \
+  ((im_extt->f_im_row_source_init)((ctx), (src), (xsize), (ysize), (channels), (f_read), (f_destroy)))
+#define im_row_sink_init(ctx, sink, xsize, ysize, channels, f_write, f_close, f_destroy) \
+  ((im_extt->f_im_row_sink_init)((ctx), (sink), (xsize), (ysize), (channels), (f_write), (f_close), (f_destroy)))
+#define i_row_source_read(src, rows, count) ((im_extt->f_i_row_source_read)((src), (rows), (count)))
+#define i_row_source_destroy(src) ((im_extt->f_i_row_source_destroy)(src))
+#define i_row_sink_write(sink, rows, count) ((im_extt->f_i_row_sink_write)((sink), (rows), (count)))
+#define i_row_sink_close(sink) ((im_extt->f_i_row_sink_close)(sink))
+#define i_row_sink_destroy(sink) ((im_extt->f_i_row_sink_destroy)(sink))
+#define i_adapt_colors_bg(dest_channels, src_channels, colors, count, bg) \
+  ((im_extt->f_i_adapt_colors_bg)((dest_channels), (src_channels), (colors), (count), (bg)))
+
+#define im_io_new_mmap(ctx, fd) ((im_extt->f_im_io_new_mmap)((ctx), (fd)))
+
+#define i_io_set_buffer_size(ig, size, max_size) \
+  ((im_extt->f_i_io_set_buffer_size)((ig), (size), (max_size)))
+#define im_set_io_buffer_size(ctx, size, max_size) \
+  ((im_extt->f_im_set_io_buffer_size)((ctx), (size), (max_size)))
+#define im_get_io_buffer_size(ctx, size, max_size) \
+  ((im_extt->f_im_get_io_buffer_size)((ctx), (size), (max_size)))
+
+#define i_io_writev(ig, vec, count) \
+  ((im_extt->f_i_io_writev)((ig), (vec), (count)))
+
+#define i_io_bufchain_spans(ig, spans, max_spans) \
+  ((im_extt->f_i_io_bufchain_spans)((ig), (spans), (max_spans)))
+
+#define im_exif_orientation(data, length) \
+  ((im_extt->f_im_exif_orientation)((data), (length)))
+
+#define im_img_tiled_new(ctx, xsize, ysize, channels, bits, bg) \
+  ((im_extt->f_im_img_tiled_new)((ctx), (xsize), (ysize), (channels), (bits), (bg)))
+
+#define im_img_mmap_new(ctx, filename, xsize, ysize, channels, bits, mode, offset) \
+  ((im_extt->f_im_img_mmap_new)((ctx), (filename), (xsize), (ysize), (channels), (bits), (mode), (offset)))
+
+#define i_quant_cleanup(quant) ((im_extt->f_i_quant_cleanup)(quant))
+
 #ifdef IMAGER_LOG
 #ifndef IMAGER_NO_CONTEXT
 #define mm_log(x) { i_lhead(__FILE__,__LINE__); i_loog x; } 
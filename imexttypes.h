@@ -34,7 +34,7 @@
  will result in an increment of IMAGER_API_LEVEL.
 */
 
-#define IMAGER_API_LEVEL 10
+#define IMAGER_API_LEVEL 20
 
 typedef struct {
   int version;
@@ -274,6 +274,45 @@ typedef struct {
   int (*f_im_decode_exif)(i_img *im, const unsigned char *data, size_t length);
 
   /* IMAGER_API_LEVEL 11 functions will be added here */
+  i_img *(*f_i_scale_mixing)(i_img *src, i_img_dim width, i_img_dim height);
+
+  /* IMAGER_API_LEVEL 12 */
+  void (*f_im_row_source_init)(im_context_t ctx, i_row_source *src, i_img_dim xsize, i_img_dim ysize, int channels, i_row_source_read_f f_read, i_row_source_destroy_f f_destroy);
+  void (*f_im_row_sink_init)(im_context_t ctx, i_row_sink *sink, i_img_dim xsize, i_img_dim ysize, int channels, i_row_sink_write_f f_write, i_row_sink_close_f f_close, i_row_sink_destroy_f f_destroy);
+  i_img_dim (*f_i_row_source_read)(i_row_source *src, i_color *rows, i_img_dim count);
+  void (*f_i_row_source_destroy)(i_row_source *src);
+  int (*f_i_row_sink_write)(i_row_sink *sink, const i_color *rows, i_img_dim count);
+  int (*f_i_row_sink_close)(i_row_sink *sink);
+  void (*f_i_row_sink_destroy)(i_row_sink *sink);
+  void (*f_i_adapt_colors_bg)(int dest_channels, int src_channels, i_color *colors, size_t count, i_color const *bg);
+
+  /* IMAGER_API_LEVEL 13 */
+  i_io_glue_t *(*f_im_io_new_mmap)(im_context_t ctx, int fd);
+
+  /* IMAGER_API_LEVEL 14 */
+  int (*f_i_io_set_buffer_size)(i_io_glue_t *ig, size_t size, size_t max_size);
+  int (*f_im_set_io_buffer_size)(im_context_t ctx, size_t size, size_t max_size);
+  void (*f_im_get_io_buffer_size)(im_context_t ctx, size_t *size, size_t *max_size);
+
+  /* IMAGER_API_LEVEL 15 */
+  ssize_t (*f_i_io_writev)(i_io_glue_t *ig, const i_io_vec *vec, int count);
+
+  /* IMAGER_API_LEVEL 16 */
+  size_t (*f_i_io_bufchain_spans)(i_io_glue_t *ig, i_io_vec *spans, size_t max_spans);
+
+  /* IMAGER_API_LEVEL 17 */
+  int (*f_im_exif_orientation)(const unsigned char *data, size_t length);
+
+  /* IMAGER_API_LEVEL 18 */
+  i_img *(*f_im_img_tiled_new)(im_context_t ctx, i_img_dim xsize, i_img_dim ysize, int channels, int bits, const i_fcolor *bg);
+
+  /* IMAGER_API_LEVEL 19 */
+  i_img *(*f_im_img_mmap_new)(im_context_t ctx, const char *filename, i_img_dim xsize, i_img_dim ysize, int channels, int bits, int mode, off_t offset);
+
+  /* IMAGER_API_LEVEL 20 */
+  void (*f_i_quant_cleanup)(i_quantize *quant);
+
+  /* IMAGER_API_LEVEL 21 functions will be added here */
 } im_ext_funcs;
 
 #define PERL_FUNCTION_TABLE_NAME "Imager::__ext_func_table"
@@ -245,6 +245,20 @@ i_img_to_rgb16(i_img *im) {
   return targ;
 }
 
+/*
+=item i_img_16_cow(im)
+
+True if im is a 16-bit/sample image, so that i_copy() can share its
+storage.
+
+=cut
+*/
+
+int
+i_img_16_cow(const i_img *im) {
+  return im->i_f_ppix == i_ppix_d16 && !im->i_f_destroy;
+}
+
 static int i_ppix_d16(i_img *im, i_img_dim x, i_img_dim y, const i_color *val) {
   i_img_dim off;
   int ch;
@@ -252,6 +266,8 @@ static int i_ppix_d16(i_img *im, i_img_dim x, i_img_dim y, const i_color *val) {
   if (x < 0 || x >= im->xsize || y < 0 || y >= im->ysize) 
     return -1;
 
+  i_img_unshare(im);
+
   off = (x + y * im->xsize) * im->channels;
   if (I_ALL_CHANNELS_WRITABLE(im)) {
     for (ch = 0; ch < im->channels; ++ch)
@@ -287,6 +303,8 @@ static int i_ppixf_d16(i_img *im, i_img_dim x, i_img_dim y, const i_fcolor *val)
   if (x < 0 || x >= im->xsize || y < 0 || y >= im->ysize) 
     return -1;
 
+  i_img_unshare(im);
+
   off = (x + y * im->xsize) * im->channels;
   if (I_ALL_CHANNELS_WRITABLE(im)) {
     for (ch = 0; ch < im->channels; ++ch)
@@ -342,6 +360,7 @@ static i_img_dim i_plin_d16(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, co
   i_img_dim count, i;
   i_img_dim off;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     off = (l+y*im->xsize) * im->channels;
@@ -397,6 +416,7 @@ static i_img_dim i_plinf_d16(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, c
   i_img_dim count, i;
   i_img_dim off;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     off = (l+y*im->xsize) * im->channels;
@@ -604,6 +624,7 @@ i_psamp_bits_d16(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, unsigned cons
   }
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     off = (l+y*im->xsize) * im->channels;
@@ -677,6 +698,7 @@ i_psamp_d16(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
     i_img_dim offset;
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     offset = (l+y*im->xsize) * im->channels;
@@ -769,6 +791,7 @@ i_psampf_d16(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
     i_img_dim offset;
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     offset = (l+y*im->xsize) * im->channels;
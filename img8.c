@@ -187,6 +187,22 @@ im_img_empty_ch(pIMCTX, i_img *im,i_img_dim x,i_img_dim y,int ch) {
   return im;
 }
 
+/*
+=item i_img_8_cow(im)
+
+True if im is an 8-bit direct image, which unshares storage shared by
+i_copy() before writing to it.  Images using the same functions with
+storage from elsewhere, such as memory mapped images, set i_f_destroy
+and aren't included.
+
+=cut
+*/
+
+int
+i_img_8_cow(const i_img *im) {
+  return im->i_f_ppix == i_ppix_d && !im->i_f_destroy;
+}
+
 /*
 =head2 8-bit per sample image internal functions
 
@@ -211,6 +227,7 @@ i_ppix_d(i_img *im, i_img_dim x, i_img_dim y, const i_color *val) {
   int ch;
   
   if ( x>-1 && x<im->xsize && y>-1 && y<im->ysize ) {
+    i_img_unshare(im);
     for(ch=0;ch<im->channels;ch++)
       if (im->ch_mask&(1<<ch)) 
 	im->idata[(x+y*im->xsize)*im->channels+ch]=val->channel[ch];
@@ -305,6 +322,7 @@ i_plin_d(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, const i_color *vals)
   i_img_dim count, i;
   unsigned char *data;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     data = im->idata + (l+y*im->xsize) * im->channels;
@@ -334,6 +352,7 @@ i_ppixf_d(i_img *im, i_img_dim x, i_img_dim y, const i_fcolor *val) {
   int ch;
   
   if ( x>-1 && x<im->xsize && y>-1 && y<im->ysize ) {
+    i_img_unshare(im);
     for(ch=0;ch<im->channels;ch++)
       if (im->ch_mask&(1<<ch)) {
 	im->idata[(x+y*im->xsize)*im->channels+ch] = 
@@ -424,6 +443,7 @@ i_plinf_d(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, const i_fcolor *vals
   i_img_dim count, i;
   unsigned char *data;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     data = im->idata + (l+y*im->xsize) * im->channels;
@@ -526,12 +546,6 @@ i_gsampf_d(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, i_fsample_t *samps,
   int ch;
   i_img_dim count, i, w;
   unsigned char *data;
-  for (ch = 0; ch < chan_count; ++ch) {
-    if (chans[ch] < 0 || chans[ch] >= im->channels) {
-      dIMCTXim(im);
-      im_push_errorf(aIMCTX, 0, "No channel %d in this image", chans[ch]);
-    }
-  }
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
     if (r > im->xsize)
       r = im->xsize;
@@ -600,6 +614,7 @@ i_psamp_d(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
   unsigned char *data;
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     data = im->idata + (l+y*im->xsize) * im->channels;
@@ -691,6 +706,7 @@ i_psampf_d(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
   unsigned char *data;
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     data = im->idata + (l+y*im->xsize) * im->channels;
@@ -141,6 +141,20 @@ im_img_double_new(pIMCTX, i_img_dim x, i_img_dim y, int ch) {
   return im;
 }
 
+/*
+=item i_img_double_cow(im)
+
+True if im is a double/sample image, so that i_copy() can share its
+storage.
+
+=cut
+*/
+
+int
+i_img_double_cow(const i_img *im) {
+  return im->i_f_ppix == i_ppix_ddoub && !im->i_f_destroy;
+}
+
 static int i_ppix_ddoub(i_img *im, i_img_dim x, i_img_dim y, const i_color *val) {
   i_img_dim off;
   int ch;
@@ -148,6 +162,8 @@ static int i_ppix_ddoub(i_img *im, i_img_dim x, i_img_dim y, const i_color *val)
   if (x < 0 || x >= im->xsize || y < 0 || y >= im->ysize) 
     return -1;
 
+  i_img_unshare(im);
+
   off = (x + y * im->xsize) * im->channels;
   if (I_ALL_CHANNELS_WRITABLE(im)) {
     for (ch = 0; ch < im->channels; ++ch)
@@ -183,6 +199,8 @@ static int i_ppixf_ddoub(i_img *im, i_img_dim x, i_img_dim y, const i_fcolor *va
   if (x < 0 || x >= im->xsize || y < 0 || y >= im->ysize) 
     return -1;
 
+  i_img_unshare(im);
+
   off = (x + y * im->xsize) * im->channels;
   if (I_ALL_CHANNELS_WRITABLE(im)) {
     for (ch = 0; ch < im->channels; ++ch)
@@ -238,6 +256,7 @@ static i_img_dim i_plin_ddoub(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
   i_img_dim count, i;
   i_img_dim off;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     off = (l+y*im->xsize) * im->channels;
@@ -293,6 +312,7 @@ static i_img_dim i_plinf_ddoub(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
   i_img_dim count, i;
   i_img_dim off;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     off = (l+y*im->xsize) * im->channels;
@@ -449,6 +469,7 @@ i_psamp_ddoub(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
     i_img_dim offset;
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     offset = (l+y*im->xsize) * im->channels;
@@ -543,6 +564,7 @@ i_psampf_ddoub(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y,
 
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
     i_img_dim offset;
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     offset = (l+y*im->xsize) * im->channels;
@@ -0,0 +1,392 @@
+/*
+=head1 NAME
+
+imgmmap.c - implements direct images stored in memory mapped files
+
+=head1 SYNOPSIS
+
+  i_img *im = i_img_mmap_new(filename, width, height, channels, bits,
+                             i_mmap_create, offset);
+  # use like a normal image
+  i_img_mmap_flush(im);
+
+=head1 DESCRIPTION
+
+Implements 8-bit, 16-bit and double/sample direct images whose sample
+buffer is a memory mapping of a file rather than heap memory.
+
+Apart from where idata comes from these are the same as the images
+created by i_img_8_new(), i_img_16_new() and i_img_double_new(), so
+every fast path that works with the image data directly still applies.
+
+Since the kernel can write pages back to the file and drop them, an
+image much larger than physical memory can be processed with a
+resident set much smaller than the image.
+
+The file is either a scratch file, created in the temporary directory
+and removed immediately, or a named file holding the samples in the
+same layout as Imager's raw format: rows of interleaved samples with
+no padding, starting at a given offset in the file.
+
+=over
+
+=cut
+*/
+
+#define IMAGER_NO_CONTEXT
+
+#include "imager.h"
+#include "imageri.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#ifdef IMAGER_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+=item i_img_mmap_ext
+
+A pointer to this type of object is kept in the ext_data of a memory
+mapped image.
+
+=cut
+*/
+
+typedef struct {
+  void *map; /* start of the mapping, before any offset rounding */
+  size_t map_len;
+  int shared; /* writes go to the file */
+} i_img_mmap_ext;
+
+#define MMAPEXT(im) ((i_img_mmap_ext *)((im)->ext_data))
+
+static void
+destroy_mmap(i_img *im) {
+#ifdef IMAGER_MMAP
+  i_img_mmap_ext *ext = MMAPEXT(im);
+
+  munmap(ext->map, ext->map_len);
+  myfree(ext);
+#endif
+  /* not ours to free */
+  im->idata = NULL;
+  im->ext_data = NULL;
+}
+
+#ifdef IMAGER_MMAP
+
+static const char *
+my_strerror(int err) {
+  const char *result = strerror(err);
+
+  if (!result)
+    result = "Unknown error";
+
+  return result;
+}
+
+/* open an unlinked scratch file in the temporary directory */
+static int
+scratch_open(pIMCTX) {
+  const char *dir = getenv("TMPDIR");
+  char *name;
+  int fd;
+
+  if (!dir || !*dir)
+    dir = "/tmp";
+  name = mymalloc(strlen(dir) + 20);
+  sprintf(name, "%s/imagerXXXXXX", dir);
+  fd = mkstemp(name);
+  if (fd < 0) {
+    im_push_errorf(aIMCTX, errno, "cannot create scratch file in %s: %s (%d)",
+		   dir, my_strerror(errno), errno);
+    myfree(name);
+    return -1;
+  }
+  unlink(name);
+  myfree(name);
+
+  return fd;
+}
+
+#endif
+
+/*
+=item im_img_mmap_new(ctx, filename, x, y, ch, bits, mode, offset)
+X<im_img_mmap_new API>X<i_img_mmap_new API>
+=category Image creation/destruction
+=synopsis i_img *img = im_img_mmap_new(aIMCTX, "big.raw", width, height, channels, bits, i_mmap_create, 0);
+=synopsis i_img *img = i_img_mmap_new(NULL, width, height, channels, bits, i_mmap_create, 0);
+
+Creates a new direct colour image I<x> pixels wide and I<y> pixels
+high with I<ch> channels and I<bits> bits per sample, one of
+C<i_8_bits>, C<i_16_bits> or C<i_double_bits>, with the samples kept
+in a memory mapping of a file.
+
+If I<filename> is NULL the samples are kept in a scratch file in the
+directory named by the C<TMPDIR> environment variable, or F</tmp>,
+which is removed immediately.  The image starts as all zero and
+I<mode> and I<offset> are ignored.
+
+Otherwise the samples start I<offset> bytes into I<filename>, laid out
+as rows of interleaved samples in native byte order, and I<mode> is
+one of:
+
+=over
+
+=item *
+
+C<i_mmap_read> - the file must already be large enough to hold the
+image.  Changes to the image aren't written to the file.
+
+=item *
+
+C<i_mmap_update> - the file must already be large enough to hold the
+image.  Changes to the image are written to the file.
+
+=item *
+
+C<i_mmap_create> - the file is created if needed and extended to hold
+the image.  Changes to the image are written to the file.
+
+=back
+
+The image is not virtual and behaves like the image returned by
+i_img_8_new(), i_img_16_new() or i_img_double_new() of the same size,
+but isn't limited by the memory available.
+
+Fails if memory mapped files aren't supported on the platform.
+
+Also callable as C<i_img_mmap_new(filename, x, y, ch, bits, mode,
+offset)>.
+
+=cut
+*/
+
+i_img *
+im_img_mmap_new(pIMCTX, const char *filename, i_img_dim x, i_img_dim y,
+		int ch, int bits, int mode, off_t offset) {
+#ifdef IMAGER_MMAP
+  i_img *im;
+  i_img_mmap_ext *ext;
+  size_t sample_size, bytes, line_bytes, page_size, skip;
+  off_t map_start, need;
+  struct stat st;
+  void *map;
+  int fd, shared;
+
+  im_log((aIMCTX, 1,"im_img_mmap_new(filename %s, x %" i_DF ", y %" i_DF ", ch %d, bits %d, mode %d, offset %ld)\n",
+	  filename ? filename : "(scratch)", i_DFc(x), i_DFc(y), ch, bits,
+	  mode, (long)offset));
+
+  im_clear_error(aIMCTX);
+
+  if (x < 1 || y < 1) {
+    im_push_error(aIMCTX, 0, "Image sizes must be positive");
+    return NULL;
+  }
+  if (ch < 1 || ch > MAXCHANNELS) {
+    im_push_errorf(aIMCTX, 0, "channels must be between 1 and %d", MAXCHANNELS);
+    return NULL;
+  }
+  switch (bits) {
+  case i_8_bits:
+    sample_size = 1;
+    break;
+  case i_16_bits:
+    sample_size = 2; /* as for i_img_16_new() */
+    break;
+  case i_double_bits:
+    sample_size = sizeof(double);
+    break;
+  default:
+    im_push_errorf(aIMCTX, 0, "bits must be 8, 16 or %d", i_double_bits);
+    return NULL;
+  }
+  if (filename && mode != i_mmap_read && mode != i_mmap_update
+      && mode != i_mmap_create) {
+    im_push_errorf(aIMCTX, 0, "unknown mmap mode %d", mode);
+    return NULL;
+  }
+  if (offset < 0) {
+    im_push_error(aIMCTX, 0, "offset must be non-negative");
+    return NULL;
+  }
+
+  /* check this multiplication doesn't overflow */
+  bytes = x * y * ch * sample_size;
+  if (bytes / y / ch / sample_size != x) {
+    im_push_error(aIMCTX, 0, "integer overflow calculating image allocation");
+    return NULL;
+  }
+
+  /* basic assumption: we can always allocate a buffer representing a
+     line from the image, otherwise we're going to have trouble
+     working with the image */
+  line_bytes = sizeof(i_fcolor) * x;
+  if (line_bytes / x != sizeof(i_fcolor)) {
+    im_push_error(aIMCTX, 0, "integer overflow calculating scanline allocation");
+    return NULL;
+  }
+
+  /* mappings must start on a page boundary */
+  page_size = sysconf(_SC_PAGESIZE);
+  if (!filename)
+    offset = 0;
+  skip = offset % page_size;
+  map_start = offset - skip;
+  need = offset + (off_t)bytes;
+  if (need < offset || (size_t)(need - map_start) != bytes + skip) {
+    im_push_error(aIMCTX, 0, "image too large to map");
+    return NULL;
+  }
+
+  if (filename) {
+    int flags = mode == i_mmap_read ? O_RDONLY : O_RDWR;
+    if (mode == i_mmap_create)
+      flags |= O_CREAT;
+#ifdef O_BINARY
+    flags |= O_BINARY;
+#endif
+    fd = open(filename, flags, 0666);
+    if (fd < 0) {
+      im_push_errorf(aIMCTX, errno, "cannot open %s: %s (%d)", filename,
+		     my_strerror(errno), errno);
+      return NULL;
+    }
+    shared = mode != i_mmap_read;
+  }
+  else {
+    fd = scratch_open(aIMCTX);
+    if (fd < 0)
+      return NULL;
+    mode = i_mmap_create;
+    shared = 1;
+  }
+
+  if (fstat(fd, &st) < 0) {
+    im_push_errorf(aIMCTX, errno, "fstat() failure: %s (%d)",
+		   my_strerror(errno), errno);
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size < need) {
+    if (mode != i_mmap_create) {
+      im_push_error(aIMCTX, 0, "file too small for image");
+      close(fd);
+      return NULL;
+    }
+    /* leaves a sparse file on most systems, so untouched parts of the
+       image cost no disk space */
+    if (ftruncate(fd, need) < 0) {
+      im_push_errorf(aIMCTX, errno, "cannot extend file: %s (%d)",
+		     my_strerror(errno), errno);
+      close(fd);
+      return NULL;
+    }
+  }
+
+  map = mmap(NULL, bytes + skip, PROT_READ | PROT_WRITE,
+	     shared ? MAP_SHARED : MAP_PRIVATE, fd, map_start);
+  /* the mapping keeps its own reference to the file */
+  close(fd);
+  if (map == MAP_FAILED) {
+    im_push_errorf(aIMCTX, errno, "mmap() failure: %s (%d)",
+		   my_strerror(errno), errno);
+    return NULL;
+  }
+
+  /* the smallest image of the type supplies everything but the
+     samples */
+  switch (bits) {
+  case i_8_bits:
+    im = im_img_8_new(aIMCTX, 1, 1, ch);
+    break;
+  case i_16_bits:
+    im = im_img_16_new(aIMCTX, 1, 1, ch);
+    break;
+  default:
+    im = im_img_double_new(aIMCTX, 1, 1, ch);
+    break;
+  }
+  if (!im) {
+    munmap(map, bytes + skip);
+    return NULL;
+  }
+  myfree(im->idata);
+
+  ext = mymalloc(sizeof(i_img_mmap_ext));
+  ext->map = map;
+  ext->map_len = bytes + skip;
+  ext->shared = shared;
+
+  im->xsize = x;
+  im->ysize = y;
+  im->bytes = bytes;
+  im->idata = (unsigned char *)map + skip;
+  im->ext_data = ext;
+  im->i_f_destroy = destroy_mmap;
+
+  im_log((aIMCTX, 1, "(%p) <- im_img_mmap_new\n", im));
+
+  return im;
+#else
+  im_push_error(aIMCTX, 0, "memory mapped files aren't supported");
+  return NULL;
+#endif
+}
+
+/*
+=item i_img_mmap_flush(im)
+
+If I<im> is a memory mapped image that writes to its file, wait for
+changes to the image to be written to the file.
+
+Returns true on success, or if the image doesn't write to a file.
+Returns false with an error if I<im> isn't a memory mapped image or the
+file can't be written.
+
+=cut
+*/
+
+int
+i_img_mmap_flush(i_img *im) {
+  dIMCTXim(im);
+
+  im_clear_error(aIMCTX);
+
+  if (im->i_f_destroy != destroy_mmap) {
+    im_push_error(aIMCTX, 0, "not a memory mapped image");
+    return 0;
+  }
+
+#ifdef IMAGER_MMAP
+  if (MMAPEXT(im)->shared
+      && msync(MMAPEXT(im)->map, MMAPEXT(im)->map_len, MS_SYNC) < 0) {
+    im_push_errorf(aIMCTX, errno, "msync() failure: %s (%d)",
+		   my_strerror(errno), errno);
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+
+/*
+=back
+
+=head1 AUTHOR
+
+Tony Cook <tony@develop-help.com>
+
+=head1 SEE ALSO
+
+Imager(3)
+
+=cut
+*/
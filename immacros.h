@@ -132,6 +132,13 @@ returns -1 and pushes an error.
 #define i_img_16_new(xsize, ysize, channels) im_img_16_new(aIMCTX, (xsize), (ysize), (channels))
 #define i_img_double_new(xsize, ysize, channels) im_img_double_new(aIMCTX, (xsize), (ysize), (channels))
 #define i_img_pal_new(xsize, ysize, channels, maxpal) im_img_pal_new(aIMCTX, (xsize), (ysize), (channels), (maxpal))
+#define i_img_tiled_new(xsize, ysize, channels, bits, bg) im_img_tiled_new(aIMCTX, (xsize), (ysize), (channels), (bits), (bg))
+#define i_img_mmap_new(filename, xsize, ysize, channels, bits, mode, offset) im_img_mmap_new(aIMCTX, (filename), (xsize), (ysize), (channels), (bits), (mode), (offset))
+
+#define i_row_source_init(src, xsize, ysize, channels, f_read, f_destroy) \
+  im_row_source_init(aIMCTX, (src), (xsize), (ysize), (channels), (f_read), (f_destroy))
+#define i_row_sink_init(sink, xsize, ysize, channels, f_write, f_close, f_destroy) \
+  im_row_sink_init(aIMCTX, (sink), (xsize), (ysize), (channels), (f_write), (f_close), (f_destroy))
 
 #define i_img_alloc() im_img_alloc(aIMCTX)
 #define i_img_init(im) im_img_init(aIMCTX, im)
@@ -140,12 +147,20 @@ returns -1 and pushes an error.
 #define i_get_image_file_limits(width, height, bytes) im_get_image_file_limits(aIMCTX, width, height, bytes)
 #define i_int_check_image_file_limits(width, height, channels, sample_size) im_int_check_image_file_limits(aIMCTX, width, height, channels, sample_size)
 
+#define i_set_thread_count(count) im_set_thread_count(aIMCTX, (count))
+#define i_get_thread_count() im_get_thread_count(aIMCTX)
+#define i_set_io_buffer_size(size, max_size) \
+  im_set_io_buffer_size(aIMCTX, (size), (max_size))
+#define i_get_io_buffer_size(size, max_size) \
+  im_get_io_buffer_size(aIMCTX, (size), (max_size))
+
 #define i_clear_error() im_clear_error(aIMCTX)
 #define i_push_errorvf(code, fmt, args) im_push_errorvf(aIMCTX, code, fmt, args)
 #define i_push_error(code, msg) im_push_error(aIMCTX, code, msg)
 #define i_errors() im_errors(aIMCTX)
 
 #define io_new_fd(fd) im_io_new_fd(aIMCTX, (fd))
+#define io_new_mmap(fd) im_io_new_mmap(aIMCTX, (fd))
 #define io_new_bufchain() im_io_new_bufchain(aIMCTX)
 #define io_new_buffer(data, len, closecb, closectx) im_io_new_buffer(aIMCTX, (data), (len), (closecb), (closectx))
 #define io_new_cb(p, readcb, writecb, seekcb, closecb, destroycb) \
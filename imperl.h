@@ -28,4 +28,7 @@ typedef i_fill_t* Imager__FillHandle;
 
 typedef io_glue *Imager__IO;
 
+typedef i_row_source *Imager__RowSourceRaw;
+typedef i_row_sink *Imager__RowSinkRaw;
+
 #endif
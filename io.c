@@ -279,6 +279,26 @@ myrealloc_file_line(void *block, size_t newsize, char *file, int size) {
 
 #endif /* IMAGER_MALLOC_DEBUG */
 
+/* memory for band functions run by im_run_bands(), which can't use
+   mymalloc() since it logs through the context, and the debug malloc
+   isn't thread safe */
+
+void *
+im_band_alloc(size_t size) {
+  void *buf;
+
+  if ((buf = malloc(size)) == NULL) {
+    fprintf(stderr, "Unable to malloc %ld.\n", (long)size);
+    exit(3);
+  }
+  return buf;
+}
+
+void
+im_band_free(void *p) {
+  free(p);
+}
+
 
 
 
@@ -11,13 +11,29 @@
 #include <string.h>
 #include <errno.h>
 #include "imageri.h"
+#ifdef IMAGER_MMAP
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#ifdef IMAGER_WRITEV
+#include <sys/uio.h>
+#endif
 
 #define IOL_DEB(x)
 #define IOL_DEBs stderr
 
-#define IO_BUF_SIZE 8192
+/* number of consecutive fills or flushes before an adaptive buffer
+   doubles in size */
+#define IO_ADAPT_COUNT 4
+
+/* most blocks passed to a single writev() call, well under any
+   platform's IOV_MAX */
+#define IO_WRITEV_MAX 64
 
-char *io_type_names[] = { "FDSEEK", "FDNOSEEK", "BUFFER", "CBSEEK", "CBNOSEEK", "BUFCHAIN" };
+/* most free buffer chain blocks kept for reuse by each context */
+#define IO_BCHAIN_POOL_MAX 64
+
+char *io_type_names[] = { "FDSEEK", "FDNOSEEK", "BUFFER", "CBSEEK", "CBNOSEEK", "BUFCHAIN", "MMAP" };
 
 typedef struct io_blink {
   char buf[BBSIZ];
@@ -42,6 +58,13 @@ typedef struct {
   off_t cpos;
 } io_buffer;
 
+typedef struct {
+  i_io_glue_t   base;
+  unsigned char	*data;		/* the mapped file */
+  size_t	len;
+  off_t		cpos;
+} io_mmap;
+
 typedef struct {
   i_io_glue_t   base;
   void		*p;		/* Callback data */
@@ -119,11 +142,17 @@ i_io_init(pIMCTX, io_glue *ig, int type, i_io_readp_t readcb,
 
 static ssize_t fd_read(io_glue *ig, void *buf, size_t count);
 static ssize_t fd_write(io_glue *ig, const void *buf, size_t count);
+#ifdef IMAGER_WRITEV
+static ssize_t fd_writev(io_glue *ig, const i_io_vec *vec, int count);
+#endif
 static off_t fd_seek(io_glue *ig, off_t offset, int whence);
 static int fd_close(io_glue *ig);
 static ssize_t fd_size(io_glue *ig);
 static const char *my_strerror(int err);
 static void i_io_setup_buffer(io_glue *ig);
+static void i_io_setup_read_buffer(io_glue *ig);
+static void i_io_grow_buffer(io_glue *ig);
+static int i_io_raw_writev(io_glue *ig, const i_io_vec *vec, int count);
 static void
 i_io_start_write(io_glue *ig);
 static int
@@ -140,9 +169,17 @@ static ssize_t buffer_write(io_glue *ig, const void *buf, size_t count);
 static int buffer_close(io_glue *ig);
 static off_t buffer_seek(io_glue *igo, off_t offset, int whence);
 static void buffer_destroy(io_glue *igo);
-static io_blink*io_blink_new(void);
-static void io_bchain_advance(io_ex_bchain *ieb);
-static void io_destroy_bufchain(io_ex_bchain *ieb);
+static ssize_t mmap_read(io_glue *igo, void *buf, size_t count);
+static ssize_t mmap_write(io_glue *igo, const void *buf, size_t count);
+static int mmap_close(io_glue *igo);
+static off_t mmap_seek(io_glue *igo, off_t offset, int whence);
+static ssize_t mmap_size(io_glue *igo);
+static void mmap_destroy(io_glue *igo);
+static int mmap_read_fill(io_glue *igo, ssize_t needed);
+static io_blink*io_blink_new(pIMCTX);
+static void io_blink_free(pIMCTX, io_blink *ib);
+static void io_bchain_advance(pIMCTX, io_ex_bchain *ieb);
+static void io_destroy_bufchain(pIMCTX, io_ex_bchain *ieb);
 static ssize_t bufchain_read(io_glue *ig, void *buf, size_t count);
 static ssize_t bufchain_write(io_glue *ig, const void *buf, size_t count);
 static int bufchain_close(io_glue *ig);
@@ -184,7 +221,7 @@ im_io_new_bufchain(pIMCTX) {
   ieb->gpos   = 0;
   ieb->tfill  = 0;
   
-  ieb->head   = io_blink_new();
+  ieb->head   = io_blink_new(aIMCTX);
   ieb->cp     = ieb->head;
   ieb->tail   = ieb->head;
   
@@ -272,12 +309,105 @@ im_io_new_fd(pIMCTX, int fd) {
   ig->base.closecb   = fd_close;
   ig->base.sizecb    = fd_size;
   ig->base.destroycb = NULL;
+#ifdef IMAGER_WRITEV
+  ig->base.writevcb  = fd_writev;
+#endif
   im_context_refinc(aIMCTX, "im_io_new_bufchain");
 
   im_log((aIMCTX, 1, "(%p) <- io_new_fd\n", ig));
   return (io_glue *)ig;
 }
 
+/*
+=item im_io_new_mmap(ctx, file)
+X<io_new_mmap API>X<im_io_new_mmap API>
+=order 10
+=category I/O Layers
+
+Returns a new read-only io_glue object that reads from the regular
+file open on the file descriptor C<file> by mapping it into memory,
+starting from the current file position.
+
+Buffered reads through i_io_getc(), i_io_peekn() and i_io_read() work
+directly from the mapped pages, without copying the file through the
+io_glue buffer.
+
+The descriptor may be closed once the object is created, and its file
+position isn't changed by reading.  The file must not be truncated
+while the object exists.
+
+Returns NULL, after pushing an error, if the file can't be mapped,
+for example if C<file> isn't a regular file, the file is empty, or
+memory mapping isn't supported on the platform.  Callers will
+typically fall back to im_io_new_fd().
+
+  ctx - an Imager context object
+  file - file descriptor to map
+
+Also callable as C<io_new_mmap(file)>.
+
+=cut
+*/
+
+io_glue *
+im_io_new_mmap(pIMCTX, int fd) {
+#ifdef IMAGER_MMAP
+  io_mmap *ig;
+  struct stat st;
+  void *data;
+  off_t pos;
+
+  im_log((aIMCTX, 1, "io_new_mmap(fd %d)\n", fd));
+
+  if (fstat(fd, &st) < 0) {
+    im_push_errorf(aIMCTX, errno, "fstat() failure: %s (%d)",
+		   my_strerror(errno), errno);
+    return NULL;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    im_push_error(aIMCTX, 0, "only regular files can be mapped");
+    return NULL;
+  }
+  if (st.st_size == 0 || (off_t)(size_t)st.st_size != st.st_size) {
+    im_push_error(aIMCTX, 0, "file is empty or too large to map");
+    return NULL;
+  }
+  pos = lseek(fd, 0, SEEK_CUR);
+  if (pos < 0)
+    pos = 0;
+
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    im_push_errorf(aIMCTX, errno, "mmap() failure: %s (%d)",
+		   my_strerror(errno), errno);
+    return NULL;
+  }
+#ifdef MADV_SEQUENTIAL
+  /* most readers work from the front to the back, let the kernel
+     read ahead aggressively */
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+  ig = mymalloc(sizeof(io_mmap));
+  memset(ig, 0, sizeof(*ig));
+  i_io_init(aIMCTX, &ig->base, MMAP, mmap_read, mmap_write, mmap_seek);
+  ig->data = data;
+  ig->len = st.st_size;
+  ig->cpos = pos > (off_t)ig->len ? (off_t)ig->len : pos;
+
+  ig->base.closecb   = mmap_close;
+  ig->base.sizecb    = mmap_size;
+  ig->base.destroycb = mmap_destroy;
+  im_context_refinc(aIMCTX, "im_io_new_mmap");
+
+  im_log((aIMCTX, 1, "(%p) <- io_new_mmap\n", ig));
+  return (io_glue *)ig;
+#else
+  im_push_error(aIMCTX, 0, "memory mapped files aren't supported");
+  return NULL;
+#endif
+}
+
 /*
 =item im_io_new_cb(ctx, p, read_cb, write_cb, seek_cb, close_cb, destroy_cb)
 X<im_io_new_cb API>X<io_new_cb API>
@@ -403,6 +533,58 @@ io_slurp(io_glue *ig, unsigned char **c) {
   return rc;
 }
 
+/*
+=item i_io_bufchain_spans(ig, spans, max_spans)
+X<i_io_bufchain_spans API>
+=category I/O Layers
+=synopsis i_io_vec spans[20];
+=synopsis size_t count = i_io_bufchain_spans(ig, spans, 20);
+
+Fill C<spans> with up to C<max_spans> pointers to the blocks of data
+held by an I/O layer from io_new_bufchain(), in order, without
+copying them, and return the total number of blocks, which may be
+larger than C<max_spans>.  Call with C<max_spans> zero to count the
+blocks.
+
+Any buffered output is flushed first.
+
+The spans point into the layer's own storage, and are only valid
+until the layer is written to or destroyed.
+
+Like io_slurp(), this will abort the program if the supplied I/O
+layer is not from io_new_bufchain().
+
+=cut
+*/
+
+size_t
+i_io_bufchain_spans(io_glue *ig, i_io_vec *spans, size_t max_spans) {
+  io_ex_bchain *ieb;
+  io_blink *cp;
+  size_t count = 0;
+
+  if (ig->type != BUFCHAIN) {
+    dIMCTXio(ig);
+    im_fatal(aIMCTX, 0, "i_io_bufchain_spans: called on a source that is not from a bufchain\n");
+  }
+
+  i_io_flush(ig);
+
+  ieb = ig->exdata;
+  for (cp = ieb->head; cp; cp = cp->next) {
+    size_t size = cp == ieb->tail ? ieb->tfill : cp->len;
+    if (!size)
+      continue;
+    if (count < max_spans) {
+      spans[count].data = cp->buf;
+      spans[count].size = size;
+    }
+    ++count;
+  }
+
+  return count;
+}
+
 /*
 =item io_glue_destroy(ig)
 X<io_glue_destroy API>
@@ -469,7 +651,7 @@ i_io_getc_imp(io_glue *ig) {
   }
 
   if (!ig->buffer)
-    i_io_setup_buffer(ig);
+    i_io_setup_read_buffer(ig);
   
   if (!ig->read_ptr || ig->read_ptr == ig->read_end) {
     if (!i_io_read_fill(ig, 1))
@@ -498,7 +680,7 @@ i_io_peekc_imp(io_glue *ig) {
     return EOF;
 
   if (!ig->buffer)
-    i_io_setup_buffer(ig);
+    i_io_setup_read_buffer(ig);
 
   if (!ig->buffered) {
     ssize_t rc = i_io_raw_read(ig, ig->buffer, 1);
@@ -567,7 +749,7 @@ i_io_peekn(io_glue *ig, void *buf, size_t size) {
   }
 
   if (!ig->buffer)
-    i_io_setup_buffer(ig);
+    i_io_setup_read_buffer(ig);
 
   if ((!ig->read_ptr || size > ig->read_end - ig->read_ptr)
       && !(ig->buf_eof || ig->error)) {
@@ -643,6 +825,7 @@ i_io_putc_imp(io_glue *ig, int c) {
   if (ig->write_ptr && ig->write_ptr == ig->write_end) {
     if (!i_io_flush(ig))
       return EOF;
+    i_io_grow_buffer(ig);
   }
 
   i_io_start_write(ig);
@@ -677,7 +860,7 @@ i_io_read(io_glue *ig, void *buf, size_t size) {
   }
 
   if (!ig->buffer && ig->buffered)
-    i_io_setup_buffer(ig);
+    i_io_setup_read_buffer(ig);
 
   if (ig->read_ptr && ig->read_ptr < ig->read_end) {
     size_t alloc = ig->read_end - ig->read_ptr;
@@ -812,6 +995,7 @@ i_io_write(io_glue *ig, const void *buf, size_t size) {
       IOL_DEB(fprintf(IOL_DEBs, "i_io_write() => %d (i_io_flush failure)\n", (int)write_count));
       return write_count ? write_count : -1;
     }
+    i_io_grow_buffer(ig);
 
     i_io_start_write(ig);
     
@@ -842,6 +1026,105 @@ i_io_write(io_glue *ig, const void *buf, size_t size) {
   return write_count;
 }
 
+/*
+=item i_io_writev(io, vec, count)
+=category I/O Layers
+=synopsis i_io_vec vec[2];
+=synopsis vec[0].data = header; vec[0].size = header_size;
+=synopsis vec[1].data = im->idata; vec[1].size = im->bytes;
+=synopsis if (i_io_writev(io, vec, 2) < 0) { ... error ... }
+
+Write C<count> blocks of data to the stream, in order.
+
+Blocks that fit in the remaining space in the buffer are buffered as
+with i_io_write(), but larger writes, and all writes to unbuffered
+streams, are passed directly to the underlying layer along with any
+buffered output, without copying them through the buffer.  For file
+descriptors this is a single writev() call where supported.
+
+Returns the total number of bytes written, or -1 on error.
+
+=cut
+*/
+
+ssize_t
+i_io_writev(io_glue *ig, const i_io_vec *vec, int count) {
+  i_io_vec local_work[IO_WRITEV_MAX / 4];
+  i_io_vec *work;
+  size_t total = 0;
+  size_t pending = 0;
+  int work_count = 0;
+  int i;
+  int first = 0;
+  int good;
+
+  IOL_DEB(fprintf(IOL_DEBs, "i_io_writev(%p, %p, %d)\n", ig, vec, count));
+
+  if (ig->error || (ig->buffered && ig->read_ptr)) {
+    IOL_DEB(fprintf(IOL_DEBs, "i_io_writev() => -1 (error or read mode)\n"));
+    return -1;
+  }
+
+  for (i = 0; i < count; ++i)
+    total += vec[i].size;
+
+  if (ig->write_ptr)
+    pending = ig->write_ptr - ig->buffer;
+
+  if (ig->buffered && total < ig->buf_size - pending) {
+    /* small enough to buffer */
+    for (i = 0; i < count; ++i) {
+      if (vec[i].size
+	  && i_io_write(ig, vec[i].data, vec[i].size) != vec[i].size)
+	return -1;
+    }
+    return total;
+  }
+
+  if (ig->buffered) {
+    /* leading small blocks join the buffered data, so the layer sees
+       them as one write */
+    if (!ig->buffer)
+      i_io_setup_buffer(ig);
+    if (!ig->write_ptr)
+      i_io_start_write(ig);
+    while (first < count
+	   && vec[first].size <= (size_t)(ig->write_end - ig->write_ptr)) {
+      memcpy(ig->write_ptr, vec[first].data, vec[first].size);
+      ig->write_ptr += vec[first].size;
+      ++first;
+    }
+    pending = ig->write_ptr - ig->buffer;
+  }
+
+  work = count - first + 1 <= sizeof(local_work) / sizeof(*local_work)
+    ? local_work : mymalloc(sizeof(i_io_vec) * (count - first + 1));
+  if (pending) {
+    work[work_count].data = ig->buffer;
+    work[work_count].size = pending;
+    ++work_count;
+  }
+  for (i = first; i < count; ++i) {
+    if (vec[i].size)
+      work[work_count++] = vec[i];
+  }
+
+  good = i_io_raw_writev(ig, work, work_count);
+  if (work != local_work)
+    myfree(work);
+
+  if (!good) {
+    ig->error = 1;
+    IOL_DEB(fprintf(IOL_DEBs, "i_io_writev() => -1 (write failure)\n"));
+    return -1;
+  }
+  ig->write_ptr = ig->write_end = NULL;
+
+  IOL_DEB(fprintf(IOL_DEBs, "i_io_writev() => %d\n", (int)total));
+
+  return total;
+}
+
 /*
 =item i_io_seek(io, offset, whence)
 =category I/O Layers
@@ -871,6 +1154,7 @@ i_io_seek(io_glue *ig, off_t offset, int whence) {
   ig->write_ptr = ig->write_end = NULL;
   ig->error = 0;
   ig->buf_eof = 0;
+  ig->buf_seq = 0;
   
   new_off = i_io_raw_seek(ig, offset, whence);
   if (new_off < 0)
@@ -1020,10 +1304,13 @@ i_io_init(pIMCTX, io_glue *ig, int type, i_io_readp_t readcb, i_io_writep_t writ
   ig->read_end = NULL;
   ig->write_ptr = NULL;
   ig->write_end = NULL;
-  ig->buf_size = IO_BUF_SIZE;
+  ig->buf_size = aIMCTX->io_buf_size;
+  ig->buf_max = aIMCTX->io_buf_max;
+  ig->buf_seq = 0;
   ig->buf_eof = 0;
   ig->error = 0;
   ig->buffered = 1;
+  ig->writevcb = NULL;
 }
 
 /*
@@ -1066,6 +1353,59 @@ i_io_set_buffered(io_glue *ig, int buffered) {
   return 1;
 }
 
+/*
+=item i_io_set_buffer_size(io, size, max_size)
+=category I/O Layers
+=synopsis if (!i_io_set_buffer_size(io, 65536, 0)) { ... error ... }
+
+Set the size of the buffer used by the stream for buffered reads and
+writes.
+
+If C<max_size> is larger than C<size> the buffer is adaptive, and
+doubles in size, up to C<max_size>, each time a run of buffer fills
+or flushes happens without a seek in between, so long sequential
+reads and writes make fewer calls to the underlying read and write
+callbacks.  A C<max_size> of 0 means the buffer stays at C<size>.
+
+New I/O layers take their sizes from the context, see
+im_set_io_buffer_size().
+
+This fails if there is buffered data, so call it before reading or
+writing, or after i_io_flush() or i_io_seek().
+
+Returns true on success.
+
+=cut
+*/
+
+int
+i_io_set_buffer_size(io_glue *ig, size_t size, size_t max_size) {
+  dIMCTXio(ig);
+
+  im_clear_error(aIMCTX);
+
+  if (!im_int_check_io_buffer_size(aIMCTX, size, &max_size))
+    return 0;
+
+  if ((ig->read_ptr && ig->read_ptr != ig->read_end)
+      || (ig->write_ptr && ig->write_ptr != ig->buffer)) {
+    im_push_error(aIMCTX, 0, "can't change the buffer size with data buffered");
+    return 0;
+  }
+
+  if (ig->buffer) {
+    myfree(ig->buffer);
+    ig->buffer = NULL;
+  }
+  ig->read_ptr = ig->read_end = NULL;
+  ig->write_ptr = ig->write_end = NULL;
+  ig->buf_size = size;
+  ig->buf_max = max_size;
+  ig->buf_seq = 0;
+
+  return 1;
+}
+
 /*
 =item i_io_dump(ig)
 
@@ -1102,6 +1442,7 @@ i_io_dump(io_glue *ig, int flags) {
     }
     fprintf(IOL_DEBs, "  write_end: %p\n", ig->write_end);
     fprintf(IOL_DEBs, "  buf_size: %u\n", (unsigned)(ig->buf_size));
+    fprintf(IOL_DEBs, "  buf_max: %u\n", (unsigned)(ig->buf_max));
   }
   if (flags & I_IO_DUMP_STATUS) {
     fprintf(IOL_DEBs, "  buf_eof: %d\n", ig->buf_eof);
@@ -1137,11 +1478,160 @@ const char *my_strerror(int err) {
   return result;
 }
 
+/*
+=item im_int_io_strip_rows(row_size, height)
+
+The number of rows of C<row_size> bytes, out of C<height>, a writer
+should gather into a strip for each i_io_writev() call.
+
+=cut
+*/
+
+i_img_dim
+im_int_io_strip_rows(size_t row_size, i_img_dim height) {
+  i_img_dim rows = row_size ? I_IO_STRIP_SIZE / row_size : 1;
+
+  if (rows < 1)
+    rows = 1;
+  if (rows > height)
+    rows = height;
+
+  return rows;
+}
+
+/*
+=item i_io_raw_writev(ig, vec, count)
+
+Write all of the blocks in C<vec> with the layer's writev callback,
+or its write callback if it has none, retrying partial writes.
+
+C<vec> is modified.
+
+Returns true on success.
+
+=cut
+*/
+
+static int
+i_io_raw_writev(io_glue *ig, const i_io_vec *vec, int count) {
+  if (ig->writevcb) {
+    i_io_vec *work = (i_io_vec *)vec;
+
+    while (count > 0) {
+      ssize_t rc = ig->writevcb(ig, work, count);
+      if (rc <= 0)
+	return 0;
+      while (count > 0 && (size_t)rc >= work->size) {
+	rc -= work->size;
+	++work;
+	--count;
+      }
+      if (count > 0 && rc) {
+	work->data = (const unsigned char *)work->data + rc;
+	work->size -= rc;
+      }
+    }
+  }
+  else {
+    int i;
+    for (i = 0; i < count; ++i) {
+      const unsigned char *p = vec[i].data;
+      size_t size = vec[i].size;
+      while (size > 0) {
+	ssize_t rc = i_io_raw_write(ig, p, size);
+	if (rc <= 0)
+	  return 0;
+	p += rc;
+	size -= rc;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/*
+=item im_int_check_io_buffer_size(ctx, size, &max_size)
+
+Check a buffer size and maximum buffer size are valid, setting
+C<max_size> to C<size> if it's zero.
+
+Pushes an error and returns false if they're invalid.
+
+=cut
+*/
+
+int
+im_int_check_io_buffer_size(pIMCTX, size_t size, size_t *max_size) {
+  if (*max_size == 0)
+    *max_size = size;
+
+  if (size < IO_MIN_BUF_SIZE || size > IO_MAX_BUF_SIZE) {
+    im_push_errorf(aIMCTX, 0, "buffer size must be from %d to %d bytes",
+		   IO_MIN_BUF_SIZE, IO_MAX_BUF_SIZE);
+    return 0;
+  }
+  if (*max_size < size || *max_size > IO_MAX_BUF_SIZE) {
+    im_push_errorf(aIMCTX, 0, "maximum buffer size must be from the buffer "
+		   "size to %d bytes", IO_MAX_BUF_SIZE);
+    return 0;
+  }
+
+  return 1;
+}
+
 static void
 i_io_setup_buffer(io_glue *ig) {
   ig->buffer = mymalloc(ig->buf_size);
 }
 
+/* called for each buffer fill and each flush forced by a full write
+   buffer, doubling the buffer once enough of them have happened in a
+   row */
+static void
+i_io_grow_buffer(io_glue *ig) {
+  size_t new_size;
+  unsigned char *new_buf;
+  size_t kept = 0;
+
+  if (ig->buf_max <= ig->buf_size || !ig->buffer)
+    return;
+
+  if (++ig->buf_seq < IO_ADAPT_COUNT)
+    return;
+
+  ig->buf_seq = 0;
+  new_size = ig->buf_size * 2;
+  if (new_size > ig->buf_max)
+    new_size = ig->buf_max;
+
+  new_buf = mymalloc(new_size);
+  if (ig->read_ptr && ig->read_ptr < ig->read_end) {
+    kept = ig->read_end - ig->read_ptr;
+    memcpy(new_buf, ig->read_ptr, kept);
+  }
+  if (ig->read_ptr) {
+    ig->read_ptr = new_buf;
+    ig->read_end = new_buf + kept;
+  }
+  myfree(ig->buffer);
+  ig->buffer = new_buf;
+  ig->buf_size = new_size;
+
+  IOL_DEB(fprintf(IOL_DEBs, "i_io_grow_buffer(%p) => %u\n", ig,
+		  (unsigned)new_size));
+}
+
+/* buffered reads from a mapped file work from the mapping, so don't
+   need a buffer */
+static void
+i_io_setup_read_buffer(io_glue *ig) {
+  if (ig->type == MMAP && ig->buffered)
+    return;
+
+  i_io_setup_buffer(ig);
+}
+
 static void
 i_io_start_write(io_glue *ig) {
   ig->write_ptr = ig->buffer;
@@ -1150,9 +1640,9 @@ i_io_start_write(io_glue *ig) {
 
 static int
 i_io_read_fill(io_glue *ig, ssize_t needed) {
-  unsigned char *buf_end = ig->buffer + ig->buf_size;
-  unsigned char *buf_start = ig->buffer;
-  unsigned char *work = ig->buffer;
+  unsigned char *buf_end;
+  unsigned char *buf_start;
+  unsigned char *work;
   ssize_t rc;
   int good = 0;
 
@@ -1162,6 +1652,14 @@ i_io_read_fill(io_glue *ig, ssize_t needed) {
   if (ig->error || ig->buf_eof)
     return 0;
 
+  if (ig->type == MMAP && ig->buffered)
+    return mmap_read_fill(ig, needed);
+
+  i_io_grow_buffer(ig);
+
+  buf_end = ig->buffer + ig->buf_size;
+  buf_start = work = ig->buffer;
+
   if (needed > ig->buf_size)
     needed = ig->buf_size;
 
@@ -1546,25 +2044,86 @@ buffer_destroy(io_glue *igo) {
 
 /* Helper functions for buffer chains */
 
+/*
+=item io_blink_new(ctx)
+
+Returns a new buffer chain block, reusing one from the context's pool
+of free blocks if there is one.
+
+The block's contents aren't initialized, bufchain_seek() writes zeros
+when it extends the chain.
+
+=cut
+*/
+
 static
 io_blink*
-io_blink_new(void) {
+io_blink_new(pIMCTX) {
   io_blink *ib;
 
 #if 0
   im_log((aIMCTX, 1, "io_blink_new()\n"));
 #endif
 
-  ib = mymalloc(sizeof(io_blink));
+  if (aIMCTX->bchain_pool) {
+    ib = aIMCTX->bchain_pool;
+    aIMCTX->bchain_pool = ib->next;
+    --aIMCTX->bchain_pool_count;
+  }
+  else {
+    ib = mymalloc(sizeof(io_blink));
+  }
 
   ib->next = NULL;
   ib->prev = NULL;
   ib->len  = BBSIZ;
 
-  memset(&ib->buf, 0, ib->len);
   return ib;
 }
 
+/*
+=item io_blink_free(ctx, ib)
+
+Return a buffer chain block to the context's pool, or release it if
+the pool is full.
+
+=cut
+*/
+
+static void
+io_blink_free(pIMCTX, io_blink *ib) {
+  if (aIMCTX->bchain_pool_count < IO_BCHAIN_POOL_MAX) {
+    ib->next = aIMCTX->bchain_pool;
+    aIMCTX->bchain_pool = ib;
+    ++aIMCTX->bchain_pool_count;
+  }
+  else {
+    myfree(ib);
+  }
+}
+
+/*
+=item im_int_bchain_pool_free(ctx)
+
+Release the context's pool of free buffer chain blocks, called when
+the context is destroyed.
+
+=cut
+*/
+
+void
+im_int_bchain_pool_free(pIMCTX) {
+  io_blink *ib = aIMCTX->bchain_pool;
+
+  while (ib) {
+    io_blink *next = ib->next;
+    myfree(ib);
+    ib = next;
+  }
+  aIMCTX->bchain_pool = NULL;
+  aIMCTX->bchain_pool_count = 0;
+}
+
 
 
 /*
@@ -1580,9 +2139,9 @@ necessary.  Also adjusts the cpos and tfill counters as needed.
 
 static
 void
-io_bchain_advance(io_ex_bchain *ieb) {
+io_bchain_advance(pIMCTX, io_ex_bchain *ieb) {
   if (ieb->cp->next == NULL) {
-    ieb->tail = io_blink_new();
+    ieb->tail = io_blink_new(aIMCTX);
     ieb->tail->prev = ieb->cp;
     ieb->cp->next   = ieb->tail;
 
@@ -1597,13 +2156,14 @@ io_bchain_advance(io_ex_bchain *ieb) {
 /*
 =item io_bchain_destroy()
 
-frees all resources used by a buffer chain.
+frees all resources used by a buffer chain, returning its blocks to
+the context's pool.
 
 =cut
 */
 
 static void
-io_destroy_bufchain(io_ex_bchain *ieb) {
+io_destroy_bufchain(pIMCTX, io_ex_bchain *ieb) {
   io_blink *cp;
 #if 0
   mm_log((1, "io_destroy_bufchain(ieb %p)\n", ieb));
@@ -1612,7 +2172,7 @@ io_destroy_bufchain(io_ex_bchain *ieb) {
   
   while(cp) {
     io_blink *t = cp->next;
-    myfree(cp);
+    io_blink_free(aIMCTX, cp);
     cp = t;
   }
 }
@@ -1797,7 +2357,7 @@ bufchain_write(io_glue *ig, const void *buf, size_t count) {
     im_log((aIMCTX, 2, "bufchain_write: - looping - count = %ld\n", (long)count));
     if (ieb->cp->len == ieb->cpos) {
       im_log((aIMCTX, 1, "bufchain_write: cp->len == ieb->cpos = %ld - advancing chain\n", (long) ieb->cpos));
-      io_bchain_advance(ieb);
+      io_bchain_advance(aIMCTX, ieb);
     }
 
     sk = ieb->cp->len - ieb->cpos;
@@ -1922,12 +2482,122 @@ static
 void
 bufchain_destroy(io_glue *ig) {
   io_ex_bchain *ieb = ig->exdata;
+  dIMCTXio(ig);
 
-  io_destroy_bufchain(ieb);
+  io_destroy_bufchain(aIMCTX, ieb);
 
   myfree(ieb);
 }
 
+/*
+ * Callbacks for memory mapped files
+ */
+
+/*
+=item mmap_read(ig, buf, count)
+
+Read callback for memory mapped files, used for unbuffered reads and
+reads larger than the buffer.
+
+=cut
+*/
+
+static ssize_t
+mmap_read(io_glue *igo, void *buf, size_t count) {
+  io_mmap *ig = (io_mmap *)igo;
+
+  if (ig->cpos >= ig->len)
+    return 0;
+  if (count > ig->len - ig->cpos)
+    count = ig->len - ig->cpos;
+
+  memcpy(buf, ig->data + ig->cpos, count);
+  ig->cpos += count;
+
+  return count;
+}
+
+static ssize_t
+mmap_write(io_glue *igo, const void *buf, size_t count) {
+  dIMCTXio(igo);
+  im_push_error(aIMCTX, 0, "memory mapped I/O layers are read only");
+
+  return -1;
+}
+
+static int
+mmap_close(io_glue *igo) {
+  return 0;
+}
+
+static off_t
+mmap_seek(io_glue *igo, off_t offset, int whence) {
+  io_mmap *ig = (io_mmap *)igo;
+  off_t reqpos = calc_seek_offset(ig->cpos, (off_t)ig->len, offset, whence);
+
+  if (reqpos < 0) {
+    dIMCTXio(igo);
+    im_push_error(aIMCTX, 0, "seek before beginning of file");
+    return (off_t)-1;
+  }
+
+  /* like a file, seeking past the end is allowed, reads just return
+     EOF */
+  ig->cpos = reqpos;
+
+  return reqpos;
+}
+
+static ssize_t
+mmap_size(io_glue *igo) {
+  io_mmap *ig = (io_mmap *)igo;
+
+  return ig->len;
+}
+
+static void
+mmap_destroy(io_glue *igo) {
+#ifdef IMAGER_MMAP
+  io_mmap *ig = (io_mmap *)igo;
+
+  munmap(ig->data, ig->len);
+#endif
+}
+
+/*
+=item mmap_read_fill(ig, needed)
+
+Buffered reads from a mapped file point the read buffer directly at
+the rest of the mapping, so the first fill makes the whole remaining
+file available without copying, and any later fill is at end of
+file.
+
+=cut
+*/
+
+static int
+mmap_read_fill(io_glue *igo, ssize_t needed) {
+  io_mmap *ig = (io_mmap *)igo;
+
+  if (igo->read_ptr && igo->read_ptr < igo->read_end) {
+    if (needed > igo->read_end - igo->read_ptr)
+      igo->buf_eof = 1;
+
+    return 1;
+  }
+
+  if (ig->cpos >= ig->len) {
+    igo->buf_eof = 1;
+    return 0;
+  }
+
+  igo->read_ptr = ig->data + ig->cpos;
+  igo->read_end = ig->data + ig->len;
+  ig->cpos = ig->len;
+
+  return 1;
+}
+
 /*
 =item fd_read(ig, buf, count)
 
@@ -1976,6 +2646,35 @@ static ssize_t fd_write(io_glue *igo, const void *buf, size_t count) {
   return result;
 }
 
+#ifdef IMAGER_WRITEV
+
+static ssize_t fd_writev(io_glue *igo, const i_io_vec *vec, int count) {
+  io_fdseek *ig = (io_fdseek *)igo;
+  struct iovec iov[IO_WRITEV_MAX];
+  ssize_t result;
+  int i;
+
+  if (count > IO_WRITEV_MAX)
+    count = IO_WRITEV_MAX;
+  for (i = 0; i < count; ++i) {
+    iov[i].iov_base = (void *)vec[i].data;
+    iov[i].iov_len = vec[i].size;
+  }
+  result = writev(ig->fd, iov, count);
+
+  IOL_DEB(fprintf(IOL_DEBs, "fd_writev(%p, %p, %d) => %d\n", ig, vec,
+		  count, (int)result));
+
+  if (result <= 0) {
+    dIMCTXio(igo);
+    im_push_errorf(aIMCTX, errno, "writev() failure: %s (%d)", my_strerror(errno), errno);
+  }
+
+  return result;
+}
+
+#endif
+
 static off_t fd_seek(io_glue *igo, off_t offset, int whence) {
   io_fdseek *ig = (io_fdseek *)igo;
   off_t result;
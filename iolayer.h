@@ -18,15 +18,21 @@
 #define IO_FAKE_SEEK 1<<0L
 #define IO_TEMP_SEEK 1<<1L
 
+/* writers that produce image data a few rows at a time gather about
+   this many bytes before handing them to i_io_writev() */
+#define I_IO_STRIP_SIZE 0x40000
+
 
 void io_glue_gettypes    (io_glue *ig, int reqmeth);
 
 /* XS functions */
 io_glue *im_io_new_fd(pIMCTX, int fd);
+io_glue *im_io_new_mmap(pIMCTX, int fd);
 io_glue *im_io_new_bufchain(pIMCTX);
 io_glue *im_io_new_buffer(pIMCTX, const char *data, size_t len, i_io_closebufp_t closecb, void *closedata);
 io_glue *im_io_new_cb(pIMCTX, void *p, i_io_readl_t readcb, i_io_writel_t writecb, i_io_seekl_t seekcb, i_io_closel_t closecb, i_io_destroyl_t destroycb);
 size_t   io_slurp(io_glue *ig, unsigned char **c);
+size_t   i_io_bufchain_spans(io_glue *ig, i_io_vec *spans, size_t max_spans);
 void     io_glue_destroy(io_glue *ig);
 
 void i_io_dump(io_glue *ig, int flags);
@@ -38,10 +44,12 @@ extern ssize_t i_io_peekn(io_glue *ig, void *buf, size_t size);
 extern int i_io_putc_imp(io_glue *ig, int c);
 extern ssize_t i_io_read(io_glue *ig, void *buf, size_t size);
 extern ssize_t i_io_write(io_glue *ig, const void *buf, size_t size);
+extern ssize_t i_io_writev(io_glue *ig, const i_io_vec *vec, int count);
 extern off_t i_io_seek(io_glue *ig, off_t offset, int whence);
 extern int i_io_flush(io_glue *ig);
 extern int i_io_close(io_glue *ig);
 extern int i_io_set_buffered(io_glue *ig, int buffered);
+extern int i_io_set_buffer_size(io_glue *ig, size_t size, size_t max_size);
 extern ssize_t i_io_gets(io_glue *ig, char *, size_t, int);
 
 #endif /* _IOLAYER_H_ */
@@ -8,7 +8,7 @@
 #include <stddef.h>
 #include <stdio.h>
 
-typedef enum { FDSEEK, FDNOSEEK, BUFFER, CBSEEK, CBNOSEEK, BUFCHAIN } io_type;
+typedef enum { FDSEEK, FDNOSEEK, BUFFER, CBSEEK, CBNOSEEK, BUFCHAIN, MMAP } io_type;
 
 #ifdef _MSC_VER
 typedef int ssize_t;
@@ -28,6 +28,14 @@ typedef int    (*i_io_closep_t)(io_glue *ig);
 typedef ssize_t(*i_io_sizep_t) (io_glue *ig);
 
 typedef void   (*i_io_closebufp_t)(void *p);
+
+/* a block of data for i_io_writev() */
+typedef struct {
+  const void *data;
+  size_t size;
+} i_io_vec;
+
+typedef ssize_t(*i_io_writevp_t)(io_glue *ig, const i_io_vec *vec, int count);
 typedef void (*i_io_destroyp_t)(i_io_glue_t *ig);
 
 
@@ -72,6 +80,17 @@ struct i_io_glue_t {
   int buffered;
 
   im_context_t context;
+
+  /* the buffer grows up to this size during long sequential reads or
+     writes, no growth if buf_size */
+  size_t buf_max;
+
+  /* fills or flushes since the last seek or growth */
+  int buf_seq;
+
+  /* write several blocks at once, may be NULL, in which case
+     i_io_writev() calls writecb for each block */
+  i_io_writevp_t writevcb;
 };
 
 #define I_IO_DUMP_CALLBACKS 1
@@ -0,0 +1,265 @@
+package Imager::RowSource;
+use 5.006;
+use strict;
+use Imager;
+
+our $VERSION = "1.000";
+
+sub new {
+  my ($class, %opts) = @_;
+
+  my $image = $opts{image};
+  unless ($image && eval { $image->isa("Imager") }) {
+    Imager->_set_error("image parameter missing or not an image");
+    return;
+  }
+  $image->_valid_image("Imager::RowSource->new")
+    or do {
+      Imager->_set_error($image->errstr);
+      return;
+    };
+
+  my $raw = Imager::i_row_source_img($image->{IMG});
+  unless ($raw) {
+    Imager->_set_error(Imager->_error_as_msg);
+    return;
+  }
+
+  return $class->_new($raw, $image);
+}
+
+# wrap a raw row source, keeping references to whatever it reads
+# from, since the source doesn't own them
+sub _new {
+  my ($class, $raw, @keep) = @_;
+
+  return bless { SRC => $raw, KEEP => \@keep }, $class;
+}
+
+sub _info {
+  my ($self) = @_;
+
+  return $self->{SRC}->info;
+}
+
+sub getwidth {
+  return ($_[0]->_info)[0];
+}
+
+sub getheight {
+  return ($_[0]->_info)[1];
+}
+
+sub getchannels {
+  return ($_[0]->_info)[2];
+}
+
+sub _unread {
+  my ($self, $method) = @_;
+
+  if (($self->_info)[3]) {
+    Imager->_set_error("$method: rows have already been read from this source");
+    return;
+  }
+
+  return 1;
+}
+
+sub scale {
+  my ($self, %opts) = @_;
+
+  $self->_unread("scale")
+    or return;
+
+  my ($x_scale, $y_scale, $new_width, $new_height) =
+    Imager->scale_calculate(%opts, width => $self->getwidth,
+			    height => $self->getheight)
+      or return;
+
+  my $raw = Imager::i_row_source_scale($self->{SRC}, $new_width, $new_height);
+  unless ($raw) {
+    Imager->_set_error(Imager->_error_as_msg);
+    return;
+  }
+
+  return ref($self)->_new($raw, $self);
+}
+
+sub convert {
+  my ($self, %opts) = @_;
+
+  $self->_unread("convert")
+    or return;
+
+  my $matrix = Imager->_convert_matrix($self->getchannels, %opts)
+    or return;
+
+  my $raw = Imager::i_row_source_convert($self->{SRC}, $matrix);
+  unless ($raw) {
+    Imager->_set_error(Imager->_error_as_msg);
+    return;
+  }
+
+  return ref($self)->_new($raw, $self);
+}
+
+sub image {
+  my ($self) = @_;
+
+  my $img = Imager::i_row_source_to_img($self->{SRC});
+  unless ($img) {
+    Imager->_set_error(Imager->_error_as_msg);
+    return;
+  }
+
+  return bless { IMG => $img, ERRSTR => undef, DEBUG => $Imager::DEBUG },
+    "Imager";
+}
+
+sub write {
+  my ($self, %input) = @_;
+
+  my ($sink, $IO, @extras) =
+    Imager->_row_sink($self->getwidth, $self->getheight - ($self->_info)[3],
+		      $self->getchannels, %input)
+      or return;
+
+  unless (Imager::i_rows_copy($self->{SRC}, $sink)) {
+    Imager->_set_error(Imager->_error_as_msg);
+    return;
+  }
+
+  if (exists $input{data}) {
+    my $data = Imager::io_slurp($IO);
+    unless ($data) {
+      Imager->_set_error('Could not slurp from buffer');
+      return;
+    }
+    ${$input{data}} = $data;
+  }
+
+  return $self;
+}
+
+sub errstr {
+  return Imager->errstr;
+}
+
+1;
+
+__END__
+
+=head1 NAME
+
+Imager::RowSource - read, transform and write images a few rows at a time
+
+=head1 SYNOPSIS
+
+  use Imager;
+  use Imager::RowSource;
+
+  my $src = Imager->read_rows(file => "huge.jpg")
+    or die Imager->errstr;
+  my $thumb = $src->scale(xpixels => 800, ypixels => 800, type => "min")
+    or die Imager->errstr;
+  $thumb->write(file => "thumb.png")
+    or die Imager->errstr;
+
+  my $gray = $src->convert(preset => "gray");
+
+  my $image = $src->image;
+
+  my $rows = Imager::RowSource->new(image => $img);
+
+=head1 DESCRIPTION
+
+An Imager::RowSource produces the rows of an image from top to
+bottom, without ever holding the whole image in memory.  A source
+read from a file can be scaled or converted and then written to
+another file, and only a few rows of each step are held in memory at
+a time, so very large images can be processed in a small fixed
+amount of memory.
+
+Rows are always processed at 8 bits per sample, and tags, such as
+resolution or comments, aren't read or written.
+
+The C<pnm> format is supported by Imager itself, the C<png> and
+C<jpeg> modules support reading and writing rows, other formats can
+only be read or written as whole images.
+
+Since rows are only read once, a source can be used for only one of
+scale(), convert(), image() or write(), and a source returned by
+scale() or convert() reads from the source it was created from.
+
+All methods return an empty list or undef on failure, the error
+message is available from C<< Imager->errstr >>.
+
+=head1 METHODS
+
+=over
+
+=item Imager->read_rows(...)
+
+Open an image file and return a row source for it.  Accepts the same
+C<file>, C<fh>, C<fd>, C<data>, C<callback> and C<io> parameters as
+L<Imager/read()>, and the C<type> parameter.
+
+  my $src = Imager->read_rows(file => "foo.ppm")
+    or die Imager->errstr;
+
+=item new(image => $image)
+
+Create a row source that reads from an existing image.
+
+=item getwidth()
+
+=item getheight()
+
+=item getchannels()
+
+The size and number of channels of the rows produced by the source.
+
+=item scale(...)
+
+Returns a new source that scales the rows of this source.  Accepts
+the same size parameters as L<Imager::Transformations/scale()>, and
+always scales using the C<mixing> algorithm, giving the same result
+as:
+
+  $image->scale(..., qtype => "mixing")
+
+on an 8-bit image.
+
+=item convert(...)
+
+Returns a new source that converts the channels of this source, with
+the same C<matrix> or C<preset> parameters as
+L<Imager::Transformations/convert()>.
+
+=item image()
+
+Read the rest of the rows into a new 8-bit image.
+
+=item write(...)
+
+Write the rest of the rows to a file.  Accepts the same C<file>,
+C<fh>, C<fd>, C<data>, C<callback> and C<io> parameters as
+L<Imager/write()>, the C<type> parameter, and C<jpegquality> for
+JPEG output.
+
+Returns the source on success.
+
+  $src->write(file => "out.jpg", jpegquality => 90)
+    or die Imager->errstr;
+
+=back
+
+=head1 AUTHOR
+
+Tony Cook <tonyc@cpan.org>
+
+=head1 SEE ALSO
+
+Imager(3), Imager::Files(3), Imager::APIRef(3)
+
+=cut
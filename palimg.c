@@ -157,6 +157,20 @@ im_img_pal_new(pIMCTX, i_img_dim x, i_img_dim y, int channels, int maxpal) {
   return im;
 }
 
+/*
+=item i_img_pal_cow(im)
+
+True if im is a paletted image created by i_img_pal_new(), so that
+i_copy() can share its index storage.
+
+=cut
+*/
+
+int
+i_img_pal_cow(const i_img *im) {
+  return im->i_f_ppix == i_ppix_p;
+}
+
 /*
 =item i_img_rgb_convert(i_img *targ, i_img *src)
 
@@ -301,6 +315,8 @@ i_ppix_p(i_img *im, i_img_dim x, i_img_dim y, const i_color *val) {
   if (x < 0 || x >= im->xsize || y < 0 || y >= im->ysize)
     return -1;
 
+  i_img_unshare(im);
+
   if ((im->ch_mask & all_mask) != all_mask) {
     unsigned mask = 1;
     int ch;
@@ -394,6 +410,7 @@ i_plin_p(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, const i_color *vals)
   i_palidx *data;
   i_palidx which;
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     data = ((i_palidx *)im->idata) + l + y * im->xsize;
@@ -509,6 +526,7 @@ static i_img_dim i_ppal_p(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, cons
   if (y >= 0 && y < im->ysize && l < im->xsize && l >= 0) {
     i_palidx *data;
     i_img_dim i, w;
+    i_img_unshare(im);
     if (r > im->xsize)
       r = im->xsize;
     data = ((i_palidx *)im->idata) + l + y * im->xsize;
@@ -421,37 +421,32 @@ read_pgm_ppm_ascii_16(io_glue *ig, i_img *im, int width, int height,
 }
 
 /*
-=item i_readpnm_wiol(ig, allow_incomplete)
-
-Retrieve an image and stores in the iolayer object. Returns NULL on fatal error.
+=item read_pnm_header(ig, &type, &width, &height, &maxval)
 
-   ig     - io_glue object
-   allow_incomplete - allows a partial file to be read successfully
+Read and validate a PNM header, leaving C<ig> positioned at the start
+of the image data. (internal)
 
 =cut
 */
 
-i_img *
-i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
-  i_img* im;
+static int
+read_pnm_header(io_glue *ig, int *ptype, int *pwidth, int *pheight,
+		int *pmaxval) {
   int type;
-  int width, height, maxval, channels;
+  int width, height, maxval;
   int c;
 
-  i_clear_error();
-  mm_log((1,"i_readpnm(ig %p, allow_incomplete %d)\n", ig, allow_incomplete));
-
   c = i_io_getc(ig);
 
   if (c != 'P') {
     i_push_error(0, "bad header magic, not a PNM file");
     mm_log((1, "i_readpnm: Could not read header of file\n"));
-    return NULL;
+    return 0;
   }
 
   if ((c = i_io_getc(ig)) == EOF ) {
     mm_log((1, "i_readpnm: Could not read header of file\n"));
-    return NULL;
+    return 0;
   }
   
   type = c - '0';
@@ -459,18 +454,18 @@ i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
   if (type < 1 || type > 6) {
     i_push_error(0, "unknown PNM file type, not a PNM file");
     mm_log((1, "i_readpnm: Not a pnm file\n"));
-    return NULL;
+    return 0;
   }
 
   if ( (c = i_io_getc(ig)) == EOF ) {
     mm_log((1, "i_readpnm: Could not read header of file\n"));
-    return NULL;
+    return 0;
   }
   
   if ( !misspace(c) ) {
     i_push_error(0, "unexpected character, not a PNM file");
     mm_log((1, "i_readpnm: Not a pnm file\n"));
-    return NULL;
+    return 0;
   }
   
   mm_log((1, "i_readpnm: image is a %s\n", typenames[type-1] ));
@@ -481,59 +476,90 @@ i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
   if (!skip_comment(ig)) {
     i_push_error(0, "while skipping to width");
     mm_log((1, "i_readpnm: error reading before width\n"));
-    return NULL;
+    return 0;
   }
   
   if (!gnum(ig, &width)) {
     i_push_error(0, "could not read image width");
     mm_log((1, "i_readpnm: error reading width\n"));
-    return NULL;
+    return 0;
   }
 
   if (!skip_comment(ig)) {
     i_push_error(0, "while skipping to height");
     mm_log((1, "i_readpnm: error reading before height\n"));
-    return NULL;
+    return 0;
   }
 
   if (!gnum(ig, &height)) {
     i_push_error(0, "could not read image height");
     mm_log((1, "i_readpnm: error reading height\n"));
-    return NULL;
+    return 0;
   }
   
   if (!(type == 1 || type == 4)) {
     if (!skip_comment(ig)) {
       i_push_error(0, "while skipping to maxval");
       mm_log((1, "i_readpnm: error reading before maxval\n"));
-      return NULL;
+      return 0;
     }
 
     if (!gnum(ig, &maxval)) {
       i_push_error(0, "could not read maxval");
       mm_log((1, "i_readpnm: error reading maxval\n"));
-      return NULL;
+      return 0;
     }
 
     if (maxval == 0) {
       i_push_error(0, "maxval is zero - invalid pnm file");
       mm_log((1, "i_readpnm: maxval is zero, invalid pnm file\n"));
-      return NULL;
+      return 0;
     }
     else if (maxval > 65535) {
       i_push_errorf(0, "maxval of %d is over 65535 - invalid pnm file", 
 		    maxval);
       mm_log((1, "i_readpnm: maxval of %d is over 65535 - invalid pnm file\n", maxval));
-      return NULL;
+      return 0;
     }
   } else maxval=1;
 
   if ((c = i_io_getc(ig)) == EOF || !misspace(c)) {
     i_push_error(0, "garbage in header, invalid PNM file");
     mm_log((1, "i_readpnm: garbage in header\n"));
-    return NULL;
+    return 0;
   }
 
+  *ptype = type;
+  *pwidth = width;
+  *pheight = height;
+  *pmaxval = maxval;
+
+  return 1;
+}
+
+/*
+=item i_readpnm_wiol(ig, allow_incomplete)
+
+Retrieve an image and stores in the iolayer object. Returns NULL on fatal error.
+
+   ig     - io_glue object
+   allow_incomplete - allows a partial file to be read successfully
+
+=cut
+*/
+
+i_img *
+i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
+  i_img* im;
+  int type;
+  int width, height, maxval, channels;
+
+  i_clear_error();
+  mm_log((1,"i_readpnm(ig %p, allow_incomplete %d)\n", ig, allow_incomplete));
+
+  if (!read_pnm_header(ig, &type, &width, &height, &maxval))
+    return NULL;
+
   channels = (type == 3 || type == 6) ? 3:1;
 
   if (!i_int_check_image_file_limits(width, height, channels, sizeof(i_sample_t))) {
@@ -654,16 +680,28 @@ i_img **i_readpnm_multi_wiol(io_glue *ig, int *count, int allow_incomplete) {
 
 
 
+/* write a strip of rows, bypassing the io buffer */
+static int
+write_strip(io_glue *ig, const unsigned char *data, size_t size) {
+  i_io_vec vec;
+
+  vec.data = data;
+  vec.size = size;
+
+  return i_io_writev(ig, &vec, 1) == (ssize_t)size;
+}
+
 static
 int
 write_pbm(i_img *im, io_glue *ig, int zero_is_white) {
-  int x, y;
+  i_img_dim x, y;
   i_palidx *line;
-  i_img_dim write_size;
+  size_t write_size;
   unsigned char *write_buf;
   unsigned char *writep;
   char header[255];
   unsigned mask;
+  i_img_dim rows, row;
 
   sprintf(header, "P4\012# CREATOR: Imager\012%" i_DF " %" i_DF "\012", 
           i_DFc(im->xsize), i_DFc(im->ysize));
@@ -672,23 +710,28 @@ write_pbm(i_img *im, io_glue *ig, int zero_is_white) {
     return 0;
   }
   write_size = (im->xsize + 7) / 8;
+  rows = im_int_io_strip_rows(write_size, im->ysize);
   line = mymalloc(sizeof(i_palidx) * im->xsize);
-  write_buf = mymalloc(write_size);
-  for (y = 0; y < im->ysize; ++y) {
-    i_gpal(im, 0, im->xsize, y, line);
-    mask = 0x80;
-    writep = write_buf;
-    memset(write_buf, 0, write_size);
-    for (x = 0; x < im->xsize; ++x) {
-      if (zero_is_white ? line[x] : !line[x])
-        *writep |= mask;
-      mask >>= 1;
-      if (!mask) {
-        ++writep;
-        mask = 0x80;
+  write_buf = mymalloc(write_size * rows);
+  for (y = 0; y < im->ysize; y += rows) {
+    if (rows > im->ysize - y)
+      rows = im->ysize - y;
+    memset(write_buf, 0, write_size * rows);
+    for (row = 0; row < rows; ++row) {
+      i_gpal(im, 0, im->xsize, y + row, line);
+      mask = 0x80;
+      writep = write_buf + write_size * row;
+      for (x = 0; x < im->xsize; ++x) {
+	if (zero_is_white ? line[x] : !line[x])
+	  *writep |= mask;
+	mask >>= 1;
+	if (!mask) {
+	  ++writep;
+	  mask = 0x80;
+	}
       }
     }
-    if (i_io_write(ig, write_buf, write_size) != write_size) {
+    if (!write_strip(ig, write_buf, write_size * rows)) {
       i_push_error(0, "write failure");
       myfree(write_buf);
       myfree(line);
@@ -705,21 +748,27 @@ static
 int
 write_ppm_data_8(i_img *im, io_glue *ig, int want_channels) {
   size_t write_size = im->xsize * want_channels;
-  size_t buf_size = im->xsize * im->channels;
+  i_img_dim rows = im_int_io_strip_rows(write_size, im->ysize);
+  size_t buf_size = write_size * (rows - 1) + im->xsize * im->channels;
   unsigned char *data = mymalloc(buf_size);
   i_img_dim y = 0;
+  i_img_dim row;
   int rc = 1;
   i_color bg;
 
   i_get_file_background(im, &bg);
-  while (y < im->ysize && rc >= 0) {
-    i_gsamp_bg(im, 0, im->xsize, y, data, want_channels, &bg);
-    if (i_io_write(ig, data, write_size) != write_size) {
+  while (y < im->ysize) {
+    if (rows > im->ysize - y)
+      rows = im->ysize - y;
+    for (row = 0; row < rows; ++row)
+      i_gsamp_bg(im, 0, im->xsize, y + row, data + write_size * row,
+		 want_channels, &bg);
+    if (!write_strip(ig, data, write_size * rows)) {
       i_push_error(errno, "could not write ppm data");
       rc = 0;
       break;
     }
-    ++y;
+    y += rows;
   }
   myfree(data);
 
@@ -732,32 +781,38 @@ write_ppm_data_16(i_img *im, io_glue *ig, int want_channels) {
   size_t line_size = im->channels * im->xsize * sizeof(i_fsample_t);
   size_t sample_count = want_channels * im->xsize;
   size_t write_size = sample_count * 2;
+  i_img_dim rows = im_int_io_strip_rows(write_size, im->ysize);
   i_fsample_t *line_buf = mymalloc(line_size);
   i_fsample_t *samplep;
-  unsigned char *write_buf = mymalloc(write_size);
+  unsigned char *write_buf = mymalloc(write_size * rows);
   unsigned char *writep;
   size_t sample_num;
   i_img_dim y = 0;
+  i_img_dim row;
   int rc = 1;
   i_fcolor bg;
 
   i_get_file_backgroundf(im, &bg);
 
   while (y < im->ysize) {
-    i_gsampf_bg(im, 0, im->xsize, y, line_buf, want_channels, &bg);
-    samplep = line_buf;
+    if (rows > im->ysize - y)
+      rows = im->ysize - y;
     writep = write_buf;
-    for (sample_num = 0; sample_num < sample_count; ++sample_num) {
-      unsigned sample16 = SampleFTo16(*samplep++);
-      *writep++ = sample16 >> 8;
-      *writep++ = sample16 & 0xFF;
+    for (row = 0; row < rows; ++row) {
+      i_gsampf_bg(im, 0, im->xsize, y + row, line_buf, want_channels, &bg);
+      samplep = line_buf;
+      for (sample_num = 0; sample_num < sample_count; ++sample_num) {
+	unsigned sample16 = SampleFTo16(*samplep++);
+	*writep++ = sample16 >> 8;
+	*writep++ = sample16 & 0xFF;
+      }
     }
-    if (i_io_write(ig, write_buf, write_size) != write_size) {
+    if (!write_strip(ig, write_buf, write_size * rows)) {
       i_push_error(errno, "could not write ppm data");
       rc = 0;
       break;
     }
-    ++y;
+    y += rows;
   }
   myfree(line_buf);
   myfree(write_buf);
@@ -811,19 +866,24 @@ i_writeppm_wiol(i_img *im, io_glue *ig) {
     sprintf(header,"P%d\n#CREATOR: Imager\n%" i_DF " %" i_DF"\n%d\n", 
             type, i_DFc(im->xsize), i_DFc(im->ysize), maxval);
 
-    if (i_io_write(ig,header,strlen(header)) != strlen(header)) {
-      i_push_error(errno, "could not write ppm header");
-      mm_log((1,"i_writeppm: unable to write ppm header.\n"));
-      return(0);
-    }
-
     if (!im->virtual && im->bits == i_8_bits && im->type == i_direct_type
 	&& im->channels == want_channels) {
-      if (i_io_write(ig,im->idata,im->bytes) != im->bytes) {
+      /* the header and the image data in one write, without copying */
+      i_io_vec vec[2];
+      vec[0].data = header;
+      vec[0].size = strlen(header);
+      vec[1].data = im->idata;
+      vec[1].size = im->bytes;
+      if (i_io_writev(ig, vec, 2) != (ssize_t)(vec[0].size + vec[1].size)) {
         i_push_error(errno, "could not write ppm data");
         return 0;
       }
     }
+    else if (i_io_write(ig,header,strlen(header)) != strlen(header)) {
+      i_push_error(errno, "could not write ppm header");
+      mm_log((1,"i_writeppm: unable to write ppm header.\n"));
+      return(0);
+    }
     else if (maxval == 255) {
       if (!write_ppm_data_8(im, ig, want_channels))
         return 0;
@@ -841,6 +901,320 @@ i_writeppm_wiol(i_img *im, io_glue *ig) {
   return(1);
 }
 
+/* 16-bit samples are converted to 8-bits the same way a 16-bit image
+   converts them for i_glin() */
+#define PNM16TO8(sample, maxval) \
+  ((SampleFTo16((sample) / (double)(maxval)) + 127) / 257)
+
+typedef struct {
+  i_row_source base;
+  io_glue *ig;
+  int type;
+  int maxval;
+  unsigned char *read_buf;
+  size_t read_size;
+} pnm_source;
+
+static int
+pnm_ascii_sample(io_glue *ig, int *sample) {
+  if (!gnum(ig, sample)) {
+    if (i_io_peekc(ig) != EOF)
+      i_push_error(0, "invalid data for ascii pnm");
+    else
+      i_push_error(0, "short read - file truncated?");
+    return 0;
+  }
+
+  return 1;
+}
+
+static i_img_dim
+pnm_source_read(i_row_source *base, i_color *rows, i_img_dim count) {
+  pnm_source *ps = (pnm_source *)base;
+  io_glue *ig = ps->ig;
+  int maxval = ps->maxval;
+  int rounder = maxval / 2;
+  int channels = base->channels;
+  i_img_dim width = base->xsize;
+  i_img_dim x, i;
+  int ch;
+
+  for (i = 0; i < count; ++i) {
+    i_color *linep = rows + i * width;
+    unsigned char *readp = ps->read_buf;
+
+    if (ps->read_buf
+	&& i_io_read(ig, ps->read_buf, ps->read_size) != ps->read_size) {
+      i_push_error(0, "short read - file truncated?");
+      return -1;
+    }
+
+    switch (ps->type) {
+    case 1: /* ascii pbm */
+      for (x = 0; x < width; ++x) {
+	int c;
+	skip_spaces(ig);
+	if ((c = i_io_getc(ig)) == EOF || (c != '0' && c != '1')) {
+	  if (c != EOF)
+	    i_push_error(0, "invalid data for ascii pnm");
+	  else
+	    i_push_error(0, "short read - file truncated?");
+	  return -1;
+	}
+	linep[x].channel[0] = c == '0' ? 255 : 0;
+      }
+      break;
+
+    case 2: /* ascii pgm/ppm */
+    case 3:
+      for (x = 0; x < width; ++x) {
+	for (ch = 0; ch < channels; ++ch) {
+	  int sample;
+	  if (!pnm_ascii_sample(ig, &sample))
+	    return -1;
+	  if (sample > maxval)
+	    sample = maxval;
+	  if (maxval > 255)
+	    linep[x].channel[ch] = PNM16TO8(sample, maxval);
+	  else
+	    linep[x].channel[ch] = (sample * 255 + rounder) / maxval;
+	}
+      }
+      break;
+
+    case 4: /* binary pbm */
+      {
+	unsigned mask = 0x80;
+	for (x = 0; x < width; ++x) {
+	  linep[x].channel[0] = *readp & mask ? 0 : 255;
+	  mask >>= 1;
+	  if (mask == 0) {
+	    ++readp;
+	    mask = 0x80;
+	  }
+	}
+      }
+      break;
+
+    case 5: /* binary pgm/ppm */
+    case 6:
+      for (x = 0; x < width; ++x) {
+	for (ch = 0; ch < channels; ++ch) {
+	  unsigned sample;
+	  if (maxval > 255) {
+	    sample = (readp[0] << 8) + readp[1];
+	    readp += 2;
+	  }
+	  else {
+	    sample = *readp++;
+	  }
+	  if (sample > maxval)
+	    sample = maxval;
+	  if (maxval > 255)
+	    linep[x].channel[ch] = PNM16TO8(sample, maxval);
+	  else
+	    linep[x].channel[ch] = (sample * 255 + rounder) / maxval;
+	}
+      }
+      break;
+    }
+  }
+
+  return count;
+}
+
+static void
+pnm_source_destroy(i_row_source *base) {
+  pnm_source *ps = (pnm_source *)base;
+
+  if (ps->read_buf)
+    myfree(ps->read_buf);
+}
+
+/*
+=item i_readpnm_rows_wiol(ig)
+=category Row streams
+=synopsis i_row_source *src = i_readpnm_rows_wiol(ig);
+
+Read the header of a PNM image from C<ig> and return a row source
+that reads the image data a row at a time.
+
+Samples are scaled to 8-bits, the same as reading the image with
+i_readpnm_wiol() and then fetching the rows with i_glin().  PBM
+images are read as one channel grey.
+
+C<ig> must outlive the source.
+
+=cut
+*/
+
+i_row_source *
+i_readpnm_rows_wiol(io_glue *ig) {
+  pnm_source *ps;
+  int type;
+  int width, height, maxval, channels;
+  size_t read_size = 0;
+
+  i_clear_error();
+  mm_log((1, "i_readpnm_rows_wiol(ig %p)\n", ig));
+
+  if (!read_pnm_header(ig, &type, &width, &height, &maxval))
+    return NULL;
+
+  channels = (type == 3 || type == 6) ? 3:1;
+
+  if (!i_int_check_image_file_limits(width, height, channels, sizeof(i_sample_t))) {
+    mm_log((1, "i_readpnm_rows_wiol: image size exceeds limits\n"));
+    return NULL;
+  }
+
+  if (type == 4)
+    read_size = (width + 7) / 8;
+  else if (type == 5 || type == 6)
+    read_size = (size_t)width * channels * (maxval > 255 ? 2 : 1);
+
+  ps = mymalloc(sizeof(pnm_source));
+  ps->ig = ig;
+  ps->type = type;
+  ps->maxval = maxval;
+  ps->read_size = read_size;
+  ps->read_buf = read_size ? mymalloc(read_size) : NULL;
+  i_row_source_init(&ps->base, width, height, channels,
+		    pnm_source_read, pnm_source_destroy);
+
+  return &ps->base;
+}
+
+typedef struct {
+  i_row_sink base;
+  io_glue *ig;
+  int want_channels;
+  i_color *work;
+  unsigned char *write_buf;
+} pnm_sink;
+
+static int
+pnm_sink_write(i_row_sink *base, const i_color *rows, i_img_dim count) {
+  pnm_sink *ps = (pnm_sink *)base;
+  i_img_dim width = base->xsize;
+  size_t write_size = (size_t)width * ps->want_channels;
+  i_color bg;
+  i_img_dim i, x;
+  int ch;
+
+  /* black, like i_get_file_background() without an i_background tag */
+  bg.channel[0] = bg.channel[1] = bg.channel[2] = 0;
+  bg.channel[3] = 255;
+
+  for (i = 0; i < count; ++i) {
+    unsigned char *writep = ps->write_buf;
+
+    memcpy(ps->work, rows + i * width, sizeof(i_color) * width);
+    i_adapt_colors_bg(ps->want_channels, base->channels, ps->work, width,
+		      &bg);
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < ps->want_channels; ++ch)
+	*writep++ = ps->work[x].channel[ch];
+    }
+    if (i_io_write(ps->ig, ps->write_buf, write_size) != write_size) {
+      i_push_error(errno, "could not write ppm data");
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+pnm_sink_close(i_row_sink *base) {
+  pnm_sink *ps = (pnm_sink *)base;
+
+  if (i_io_close(ps->ig)) {
+    i_push_errorf(i_io_error(ps->ig), "Error closing stream: %d",
+		  i_io_error(ps->ig));
+    return 0;
+  }
+
+  return 1;
+}
+
+static void
+pnm_sink_destroy(i_row_sink *base) {
+  pnm_sink *ps = (pnm_sink *)base;
+
+  myfree(ps->work);
+  myfree(ps->write_buf);
+}
+
+/*
+=item i_writepnm_rows_wiol(ig, xsize, ysize, channels)
+=category Row streams
+=synopsis i_row_sink *sink = i_writepnm_rows_wiol(ig, xsize, ysize, channels);
+
+Write a PNM header to C<ig> and return a row sink that writes 8-bit
+image data a row at a time.
+
+One and two channel rows are written as PGM, three and four channel
+rows as PPM.  Any alpha channel is composited against black, as
+i_writeppm_wiol() does without an C<i_background> tag.
+
+The stream is closed by i_row_sink_close().
+
+C<ig> must outlive the sink.
+
+=cut
+*/
+
+i_row_sink *
+i_writepnm_rows_wiol(io_glue *ig, i_img_dim xsize, i_img_dim ysize,
+		     int channels) {
+  pnm_sink *ps;
+  char header[255];
+  int want_channels = channels;
+  size_t write_size;
+
+  i_clear_error();
+  mm_log((1, "i_writepnm_rows_wiol(ig %p, xsize %" i_DF ", ysize %" i_DF
+	  ", channels %d)\n", ig, i_DFc(xsize), i_DFc(ysize), channels));
+
+  if (xsize < 1 || ysize < 1) {
+    i_push_error(0, "image size must be positive");
+    return NULL;
+  }
+  if (channels < 1 || channels > 4) {
+    i_push_error(0, "channels must be from 1 to 4");
+    return NULL;
+  }
+  if (want_channels == 2 || want_channels == 4)
+    --want_channels;
+
+  write_size = xsize * want_channels;
+  if (write_size / want_channels != xsize
+      || xsize * sizeof(i_color) / sizeof(i_color) != xsize) {
+    i_push_error(0, "integer overflow calculating row size");
+    return NULL;
+  }
+
+  sprintf(header,"P%d\n#CREATOR: Imager\n%" i_DF " %" i_DF"\n%d\n", 
+	  want_channels == 3 ? 6 : 5, i_DFc(xsize), i_DFc(ysize), 255);
+
+  if (i_io_write(ig,header,strlen(header)) != strlen(header)) {
+    i_push_error(errno, "could not write ppm header");
+    mm_log((1,"i_writepnm_rows_wiol: unable to write ppm header.\n"));
+    return NULL;
+  }
+
+  ps = mymalloc(sizeof(pnm_sink));
+  ps->ig = ig;
+  ps->want_channels = want_channels;
+  ps->work = mymalloc(sizeof(i_color) * xsize);
+  ps->write_buf = mymalloc(write_size);
+  i_row_sink_init(&ps->base, xsize, ysize, channels, pnm_sink_write,
+		  pnm_sink_close, pnm_sink_destroy);
+
+  return &ps->base;
+}
+
 /*
 =back
 
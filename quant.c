@@ -8,6 +8,7 @@
 static void makemap_webmap(i_quantize *);
 static void makemap_addi(i_quantize *, i_img **imgs, int count);
 static void makemap_mediancut(i_quantize *, i_img **imgs, int count);
+static void makemap_wu(i_quantize *, i_img **imgs, int count);
 static void makemap_mono(i_quantize *);
 static void makemap_gray(i_quantize *, int step);
 
@@ -69,6 +70,10 @@ i_quant_makemap(i_quantize *quant, i_img **imgs, int count) {
     makemap_mediancut(quant, imgs, count);
     break;
 
+  case mc_wu:
+    makemap_wu(quant, imgs, count);
+    break;
+
   case mc_mono:
     makemap_mono(quant);
     break;
@@ -158,11 +163,6 @@ i_quant_translate(i_quantize *quant, i_img *img) {
   return result;
 }
 
-static void translate_closest(i_quantize *quant, i_img *img, i_palidx *out) {
-  quant->perturb = 0;
-  translate_addi(quant, img, out);
-}
-
 #define PWR2(x) ((x)*(x))
 
 typedef int (*cmpfunc)(const void*, const void*);
@@ -202,9 +202,6 @@ static int maxdist(int boxnum,cvec *cv);
 /* Some of the simpler functions are kept here to aid the compiler -
    maybe some of them will be inlined. */
 
-static int
-pixbox(i_color *ic) { return ((ic->channel[0] & 224)<<1)+ ((ic->channel[1]&224)>>2) + ((ic->channel[2] &224) >> 5); }
-
 static int
 pixbox_ch(i_sample_t *chans) { return ((chans[0] & 224)<<1)+ ((chans[1]&224)>>2) + ((chans[2] &224) >> 5); }
 
@@ -731,6 +728,268 @@ makemap_mediancut(i_quantize *quant, i_img **imgs, int count) {
   mm_log((1, "makemap_mediancut() - %d colors\n", quant->mc_count));
 }
 
+/* Wu's colour quantizer, from Xiaolin Wu, "Efficient Statistical
+   Computations for Optimal Color Quantization", Graphics Gems II.
+
+   Pixels are counted in a 32x32x32 histogram along with the sums of
+   their samples and squared samples, the histogram is turned into
+   cumulative moments so the statistics of any box can be found from
+   its 8 corners, and the box with the largest variance is repeatedly
+   cut where that reduces the total variance the most.  Each box then
+   supplies the mean of its pixels as a colour.
+
+   The histogram has a zero plane on the low side of each axis, so
+   indices run from 1 to 32.
+*/
+
+#define WU_SIDE 33
+#define WU_INDEX(r, g, b) (((r) * WU_SIDE + (g)) * WU_SIDE + (b))
+#define WU_SIZE (WU_SIDE * WU_SIDE * WU_SIDE)
+
+/* the moments, doubles so large images don't overflow */
+typedef struct {
+  double w, r, g, b, sq;
+} wu_moment;
+
+/* a box, exclusive of the low bounds and inclusive of the high
+   bounds */
+typedef struct {
+  int lo[3], hi[3];
+  double var;
+} wu_box;
+
+static void
+wu_vol(const wu_moment *m, const wu_box *box, wu_moment *out) {
+  const int *lo = box->lo, *hi = box->hi;
+  const wu_moment *c[8];
+  int i;
+
+  c[0] = m + WU_INDEX(hi[0], hi[1], hi[2]);
+  c[1] = m + WU_INDEX(hi[0], hi[1], lo[2]);
+  c[2] = m + WU_INDEX(hi[0], lo[1], hi[2]);
+  c[3] = m + WU_INDEX(hi[0], lo[1], lo[2]);
+  c[4] = m + WU_INDEX(lo[0], hi[1], hi[2]);
+  c[5] = m + WU_INDEX(lo[0], hi[1], lo[2]);
+  c[6] = m + WU_INDEX(lo[0], lo[1], hi[2]);
+  c[7] = m + WU_INDEX(lo[0], lo[1], lo[2]);
+  out->w = out->r = out->g = out->b = out->sq = 0;
+  for (i = 0; i < 8; ++i) {
+    /* corners with an odd number of low bounds are subtracted */
+    double sign = (i == 0 || i == 3 || i == 5 || i == 6) ? 1 : -1;
+    out->w += sign * c[i]->w;
+    out->r += sign * c[i]->r;
+    out->g += sign * c[i]->g;
+    out->b += sign * c[i]->b;
+    out->sq += sign * c[i]->sq;
+  }
+}
+
+static double
+wu_var(const wu_moment *m, const wu_box *box) {
+  wu_moment v;
+
+  wu_vol(m, box, &v);
+  if (v.w <= 0)
+    return 0;
+
+  return v.sq - (v.r * v.r + v.g * v.g + v.b * v.b) / v.w;
+}
+
+/* find the best place to cut box along channel ch, returning the
+   position, or -1 if it can't be cut */
+static int
+wu_maximize(const wu_moment *m, const wu_box *box, int ch,
+	    const wu_moment *whole, double *best) {
+  wu_box part = *box;
+  int cut = -1, pos;
+
+  *best = 0;
+  for (pos = box->lo[ch] + 1; pos < box->hi[ch]; ++pos) {
+    wu_moment low;
+    double lw, hw, score;
+
+    part.hi[ch] = pos;
+    wu_vol(m, &part, &low);
+    lw = low.w;
+    hw = whole->w - lw;
+    if (lw <= 0 || hw <= 0)
+      continue;
+    score = (low.r * low.r + low.g * low.g + low.b * low.b) / lw
+      + ((whole->r - low.r) * (whole->r - low.r)
+	 + (whole->g - low.g) * (whole->g - low.g)
+	 + (whole->b - low.b) * (whole->b - low.b)) / hw;
+    if (score > *best) {
+      *best = score;
+      cut = pos;
+    }
+  }
+
+  return cut;
+}
+
+/* cut box into itself and other, returns false if it can't be cut */
+static int
+wu_cut(const wu_moment *m, wu_box *box, wu_box *other) {
+  wu_moment whole;
+  double best, max_score = 0;
+  int ch, cut, max_ch = -1, max_cut = -1;
+
+  wu_vol(m, box, &whole);
+  for (ch = 0; ch < 3; ++ch) {
+    cut = wu_maximize(m, box, ch, &whole, &best);
+    if (cut >= 0 && best > max_score) {
+      max_score = best;
+      max_ch = ch;
+      max_cut = cut;
+    }
+  }
+  if (max_ch < 0)
+    return 0;
+
+  *other = *box;
+  box->hi[max_ch] = max_cut;
+  other->lo[max_ch] = max_cut;
+
+  return 1;
+}
+
+/*
+=item makemap_wu(quant, imgs, count)
+
+Build a colour map with Wu's variance minimizing quantizer, adding to
+any colours already in the map.
+
+If C<< quant->mc_max_samples >> is non-zero only about that many
+pixels, spread evenly over the images, are examined, though every
+image contributes at least one pixel.
+
+=cut
+*/
+
+static void
+makemap_wu(i_quantize *quant, i_img **imgs, int count) {
+  wu_moment *m;
+  wu_box *boxes;
+  i_sample_t *samps;
+  i_img_dim x, y, step, max_width, total_pixels;
+  int imgn, i, box_count, max_boxes, next, ch;
+
+  mm_log((1, "makemap_wu(quant %p { mc_count=%d, mc_colors=%p }, imgs %p, count %d)\n", 
+          quant, quant->mc_count, quant->mc_colors, imgs, count));
+
+  if (makemap_palette(quant, imgs, count))
+    return;
+
+  max_boxes = quant->mc_size - quant->mc_count;
+  if (max_boxes <= 0)
+    return;
+
+  max_width = 0;
+  total_pixels = 0;
+  for (imgn = 0; imgn < count; ++imgn) {
+    if (imgs[imgn]->xsize > max_width)
+      max_width = imgs[imgn]->xsize;
+    total_pixels += imgs[imgn]->xsize * imgs[imgn]->ysize;
+  }
+
+  /* sample every step'th pixel of every step'th row */
+  step = 1;
+  if (quant->version >= 2 && quant->mc_max_samples > 0
+      && total_pixels > quant->mc_max_samples) {
+    step = ceil(sqrt((double)total_pixels / quant->mc_max_samples));
+  }
+
+  m = mymalloc(sizeof(wu_moment) * WU_SIZE);
+  memset(m, 0, sizeof(wu_moment) * WU_SIZE);
+  samps = mymalloc(sizeof(i_sample_t) * 3 * max_width);
+  for (imgn = 0; imgn < count; ++imgn) {
+    i_img *im = imgs[imgn];
+    const int *chans = im->channels >= 3 ? NULL : gray_samples;
+    /* an image smaller than the step still gets sampled at its
+       centre */
+    i_img_dim x_start = step / 2 < im->xsize ? step / 2 : im->xsize / 2;
+    i_img_dim y_start = step / 2 < im->ysize ? step / 2 : im->ysize / 2;
+    for (y = y_start; y < im->ysize; y += step) {
+      i_gsamp(im, 0, im->xsize, y, samps, chans, 3);
+      for (x = x_start; x < im->xsize; x += step) {
+	const i_sample_t *s = samps + x * 3;
+	wu_moment *e = m + WU_INDEX((s[0] >> 3) + 1, (s[1] >> 3) + 1,
+				    (s[2] >> 3) + 1);
+	e->w += 1;
+	e->r += s[0];
+	e->g += s[1];
+	e->b += s[2];
+	e->sq += s[0] * s[0] + s[1] * s[1] + s[2] * s[2];
+      }
+    }
+  }
+  myfree(samps);
+
+  /* accumulate the moments, so each entry covers the box from the
+     origin to it */
+  for (ch = 0; ch < 3; ++ch) {
+    int stride = ch == 0 ? WU_SIDE * WU_SIDE : ch == 1 ? WU_SIDE : 1;
+    for (i = 0; i < WU_SIZE; ++i) {
+      int pos = ch == 0 ? i / (WU_SIDE * WU_SIDE)
+	: ch == 1 ? i / WU_SIDE % WU_SIDE : i % WU_SIDE;
+      if (pos > 0) {
+	m[i].w += m[i-stride].w;
+	m[i].r += m[i-stride].r;
+	m[i].g += m[i-stride].g;
+	m[i].b += m[i-stride].b;
+	m[i].sq += m[i-stride].sq;
+      }
+    }
+  }
+
+  boxes = mymalloc(sizeof(wu_box) * max_boxes);
+  for (ch = 0; ch < 3; ++ch) {
+    boxes[0].lo[ch] = 0;
+    boxes[0].hi[ch] = WU_SIDE - 1;
+  }
+  boxes[0].var = wu_var(m, boxes);
+  box_count = 1;
+  next = 0;
+  while (box_count < max_boxes) {
+    if (wu_cut(m, boxes + next, boxes + box_count)) {
+      boxes[next].var = wu_var(m, boxes + next);
+      boxes[box_count].var = wu_var(m, boxes + box_count);
+      ++box_count;
+    }
+    else {
+      /* can't be split further */
+      boxes[next].var = 0;
+    }
+
+    next = 0;
+    for (i = 1; i < box_count; ++i) {
+      if (boxes[i].var > boxes[next].var)
+	next = i;
+    }
+    if (boxes[next].var <= 0)
+      break;
+  }
+
+  for (i = 0; i < box_count; ++i) {
+    wu_moment v;
+    i_color *c;
+
+    wu_vol(m, boxes + i, &v);
+    if (v.w <= 0)
+      continue;
+    c = quant->mc_colors + quant->mc_count++;
+    c->rgba.r = v.r / v.w + 0.5;
+    c->rgba.g = v.g / v.w + 0.5;
+    c->rgba.b = v.b / v.w + 0.5;
+    c->rgba.a = 255;
+  }
+
+  myfree(boxes);
+  myfree(m);
+
+  mm_log((1, "makemap_wu() - %d colors\n", quant->mc_count));
+}
+
 static void
 makemap_mono(i_quantize *quant) {
   quant->mc_colors[0].rgba.r = 0;
@@ -897,7 +1156,8 @@ makemap_palette(i_quantize *quant, i_img **imgs, int count) {
 */
 #ifndef IM_CF_COPTS
 /*#define IM_CFLINSEARCH*/
-#define IM_CFHASHBOX
+/*#define IM_CFHASHBOX*/
+#define IM_CFINVMAP
 /*#define IM_CFSORTCHAN*/
 /*#define IM_CFRAND2DIST*/
 #endif
@@ -921,6 +1181,9 @@ is_gray_map(const i_quantize *quant) {
 
 #ifdef IM_CFHASHBOX
 
+static int
+pixbox(i_color *ic) { return ((ic->channel[0] & 224)<<1)+ ((ic->channel[1]&224)>>2) + ((ic->channel[2] &224) >> 5); }
+
 /* The original version I wrote for this used the sort.
    If this is defined then we use a sort to extract the indices for 
    the hashbox */
@@ -1031,6 +1294,280 @@ static void hbsetup(i_quantize *quant, hashbox *hb) {
   
 #endif
 
+#ifdef IM_CFINVMAP
+
+/* An inverse colour map.
+
+   RGB space is split into a grid of 32x32x32 cells, each 8 levels
+   wide, and each cell lists the palette entries that can be the
+   nearest entry for some colour in the cell.  For most cells that's
+   a single entry, so the search is a table lookup, and the rest only
+   search a handful of entries.
+
+   A cell is filled in the first time a colour in it is looked up, so
+   translating a small image doesn't pay for building the whole map.
+   To keep filling cheap the cells are grouped into 8x8x8 boxes with
+   their own lists, and a cell only considers the entries listed for
+   its box.
+
+   For a version 2 or later i_quantize the map is kept in
+   quant->inverse_map and reused while the palette doesn't change,
+   such as for each frame of an animated GIF with a global colour
+   map.
+*/
+
+#define INV_BITS 5
+#define INV_SHIFT (8 - INV_BITS)
+#define INV_WIDTH (1 << INV_SHIFT)
+#define INV_MASK ((1 << INV_BITS) - 1)
+#define INV_CELLS (1 << (3 * INV_BITS))
+#define INV_CELL(r, g, b) \
+  ((((r) >> INV_SHIFT) << (2 * INV_BITS)) | (((g) >> INV_SHIFT) << INV_BITS) \
+   | ((b) >> INV_SHIFT))
+
+#define INV_BOX_BITS 3
+#define INV_BOX_SHIFT (INV_BITS - INV_BOX_BITS)
+#define INV_BOXES (1 << (3 * INV_BOX_BITS))
+
+typedef struct {
+  /* the palette the map was built for */
+  int count;
+  i_color *colors;
+
+  /* lists of candidates, each the number of candidates followed by
+     the candidates in palette order.  The first list has every
+     palette entry. */
+  int *cands;
+  size_t cands_used;
+  size_t cands_size;
+
+  /* for each box and cell -1 until it's filled, then the offset of
+     its list in cands */
+  int boxes[INV_BOXES];
+  int cells[INV_CELLS];
+} inv_map;
+
+static inv_map *
+inv_new(i_quantize *quant) {
+  inv_map *inv = mymalloc(sizeof(inv_map));
+  int i;
+
+  inv->count = quant->mc_count;
+  inv->colors = mymalloc(sizeof(i_color) * quant->mc_count);
+  memcpy(inv->colors, quant->mc_colors, sizeof(i_color) * quant->mc_count);
+  inv->cands_size = 4096 + quant->mc_count;
+  inv->cands = mymalloc(sizeof(int) * inv->cands_size);
+  inv->cands[0] = quant->mc_count;
+  for (i = 0; i < quant->mc_count; ++i)
+    inv->cands[i+1] = i;
+  inv->cands_used = quant->mc_count + 1;
+  memset(inv->boxes, 0xFF, sizeof(inv->boxes));
+  memset(inv->cells, 0xFF, sizeof(inv->cells));
+
+  return inv;
+}
+
+static void
+inv_free(inv_map *inv) {
+  myfree(inv->colors);
+  myfree(inv->cands);
+  myfree(inv);
+}
+
+/* add a list of the entries from the list at offset from that can be
+   nearest to some colour in the cube width levels wide with its low
+   corner at lo, returning the offset of the new list.
+
+   An entry can only be nearest if its distance to the nearest point
+   of the cube is no more than the smallest distance any entry has to
+   the furthest point of the cube. */
+static int
+inv_add_list(inv_map *inv, const int *lo, int width, int from) {
+  int hi[3];
+  long maxd, d;
+  int i, ch, count, *src, *dest;
+  size_t start;
+
+  count = inv->cands[from];
+  if (inv->cands_used + count + 1 > inv->cands_size) {
+    inv->cands_size = inv->cands_size * 2 + count + 1;
+    inv->cands = myrealloc(inv->cands, sizeof(int) * inv->cands_size);
+  }
+  src = inv->cands + from + 1;
+  for (ch = 0; ch < 3; ++ch)
+    hi[ch] = lo[ch] + width - 1;
+
+  maxd = 196608;
+  for (i = 0; i < count; ++i) {
+    d = 0;
+    for (ch = 0; ch < 3; ++ch) {
+      int v = inv->colors[src[i]].channel[ch];
+      int far = v - lo[ch] > hi[ch] - v ? v - lo[ch] : hi[ch] - v;
+      d += far * far;
+    }
+    if (d < maxd)
+      maxd = d;
+  }
+
+  start = inv->cands_used;
+  dest = inv->cands + start;
+  dest[0] = 0;
+  for (i = 0; i < count; ++i) {
+    d = 0;
+    for (ch = 0; ch < 3; ++ch) {
+      int v = inv->colors[src[i]].channel[ch];
+      int near = v < lo[ch] ? lo[ch] - v : v > hi[ch] ? v - hi[ch] : 0;
+      d += near * near;
+    }
+    if (d <= maxd)
+      dest[++dest[0]] = src[i];
+  }
+  inv->cands_used += dest[0] + 1;
+
+  return start;
+}
+
+static int
+inv_fill(inv_map *inv, int cell) {
+  int pos[3], lo[3], box, ch;
+
+  pos[0] = cell >> (2 * INV_BITS);
+  pos[1] = (cell >> INV_BITS) & INV_MASK;
+  pos[2] = cell & INV_MASK;
+  box = ((pos[0] >> INV_BOX_SHIFT) << (2 * INV_BOX_BITS))
+    | ((pos[1] >> INV_BOX_SHIFT) << INV_BOX_BITS)
+    | (pos[2] >> INV_BOX_SHIFT);
+
+  if (inv->boxes[box] < 0) {
+    for (ch = 0; ch < 3; ++ch)
+      lo[ch] = (pos[ch] >> INV_BOX_SHIFT) << (INV_BOX_SHIFT + INV_SHIFT);
+    inv->boxes[box] = inv_add_list(inv, lo, INV_WIDTH << INV_BOX_SHIFT, 0);
+  }
+
+  for (ch = 0; ch < 3; ++ch)
+    lo[ch] = pos[ch] << INV_SHIFT;
+  inv->cells[cell] = inv_add_list(inv, lo, INV_WIDTH, inv->boxes[box]);
+
+  return inv->cells[cell];
+}
+
+/* fill every cell, so the map can be read from several threads */
+static void
+inv_fill_all(inv_map *inv) {
+  int cell;
+
+  for (cell = 0; cell < INV_CELLS; ++cell) {
+    if (inv->cells[cell] < 0)
+      inv_fill(inv, cell);
+  }
+}
+
+/* the candidate list for the cell containing (r, g, b) */
+static int *
+inv_cell(inv_map *inv, int r, int g, int b) {
+  int cell = INV_CELL(r, g, b);
+  int off = inv->cells[cell];
+
+  if (off < 0)
+    off = inv_fill(inv, cell);
+
+  return inv->cands + off;
+}
+
+/* the nearest palette entry to (r, g, b) */
+static int
+inv_find(inv_map *inv, int r, int g, int b) {
+  const int *cand = inv_cell(inv, r, g, b);
+  int best = cand[1];
+  int i;
+
+  if (cand[0] > 1) {
+    long ld = 196608;
+    for (i = 1; i <= cand[0]; ++i) {
+      const i_color *c = inv->colors + cand[i];
+      long cd = PWR2(c->channel[0] - r) + PWR2(c->channel[1] - g)
+	+ PWR2(c->channel[2] - b);
+      if (cd < ld) {
+	ld = cd;
+	best = cand[i];
+      }
+    }
+  }
+
+  return best;
+}
+
+/* fetch the cached map if it matches the palette, otherwise build a
+   new one */
+static inv_map *
+inv_get(i_quantize *quant) {
+  inv_map *inv;
+
+  if (quant->version >= 2 && quant->inverse_map) {
+    inv = quant->inverse_map;
+    if (inv->count == quant->mc_count
+	&& memcmp(inv->colors, quant->mc_colors,
+		  sizeof(i_color) * inv->count) == 0)
+      return inv;
+    inv_free(inv);
+    quant->inverse_map = NULL;
+  }
+
+  inv = inv_new(quant);
+  if (quant->version >= 2)
+    quant->inverse_map = inv;
+
+  return inv;
+}
+
+static void
+inv_release(i_quantize *quant, inv_map *inv) {
+  if (inv && quant->version < 2)
+    inv_free(inv);
+}
+
+#define CF_VARS inv_map *inv = NULL; \
+               int *cand; \
+               long ld, cd
+#define CF_SETUP inv = inv_get(quant)
+#define CF_FIND \
+  cand = inv_cell(inv, val.channel[0], val.channel[1], val.channel[2]); \
+  bst_idx = cand[1]; \
+  if (cand[0] > 1) { \
+    ld = ceucl_d(inv->colors + bst_idx, &val); \
+    for (i = 2; i <= cand[0]; ++i) { \
+      cd = ceucl_d(inv->colors + cand[i], &val); \
+      if (cd < ld) { ld = cd; bst_idx = cand[i]; } \
+    } \
+  }
+#define CF_CLEANUP inv_release(quant, inv)
+
+#endif
+
+/*
+=item i_quant_cleanup(C<quant>)
+
+=category Image quantization
+
+Release any lookup tables i_quant_translate() cached in C<quant>.
+
+Call this before discarding a version 2 or later C<quant> that has
+been used for translation.  Doesn't release C<mc_colors> or
+C<ed_map>.
+
+=cut
+*/
+
+void
+i_quant_cleanup(i_quantize *quant) {
+#ifdef IM_CFINVMAP
+  if (quant->version >= 2 && quant->inverse_map) {
+    inv_free(quant->inverse_map);
+    quant->inverse_map = NULL;
+  }
+#endif
+}
+
 #ifdef IM_CFLINSEARCH
 /* as simple as it gets */
 #define CF_VARS long ld, cd
@@ -1322,6 +1859,81 @@ static void translate_addi(i_quantize *quant, i_img *img, i_palidx *out) {
   CF_CLEANUP;
 }
 
+#ifdef IM_CFINVMAP
+
+typedef struct {
+  inv_map *inv;
+  i_img *img;
+  i_palidx *out;
+} closest_state;
+
+/*
+=item closest_band(state, start_y, end_y)
+
+Map rows C<start_y> to C<end_y>-1 of the image to their nearest
+palette entries, a scanline at a time.
+
+=cut
+*/
+
+static void
+closest_band(void *p, i_img_dim start_y, i_img_dim end_y) {
+  closest_state *state = p;
+  inv_map *inv = state->inv;
+  i_img *img = state->img;
+  i_img_dim width = img->xsize;
+  const int *chans = img->channels >= 3 ? NULL : gray_samples;
+  i_sample_t *line = im_band_alloc(sizeof(i_sample_t) * 3 * width);
+  i_palidx *out = state->out + start_y * width;
+  i_img_dim x, y;
+
+  for (y = start_y; y < end_y; ++y) {
+    const i_sample_t *samp = line;
+    i_gsamp(img, 0, width, y, line, chans, 3);
+    for (x = 0; x < width; ++x, samp += 3)
+      *out++ = inv_find(inv, samp[0], samp[1], samp[2]);
+  }
+
+  im_band_free(line);
+}
+
+/* filling every cell costs about as much as mapping this many pixels,
+   so don't use threads for images smaller than this */
+#define CLOSEST_THREAD_MIN (INV_CELLS * 8)
+
+static void
+translate_closest(i_quantize *quant, i_img *img, i_palidx *out) {
+  closest_state state;
+
+  quant->perturb = 0;
+  state.inv = inv_get(quant);
+  state.img = img;
+  state.out = out;
+
+  /* the band functions can't fill cells in parallel, so fill them
+     all first */
+  if (i_img_band_safe(img) && im_get_thread_count(img->context) > 1
+      && img->xsize * img->ysize >= CLOSEST_THREAD_MIN) {
+    inv_fill_all(state.inv);
+    im_run_bands(img->context, 0, img->ysize, closest_band, &state);
+  }
+  else {
+    closest_band(&state, 0, img->ysize);
+  }
+
+  inv_release(quant, state.inv);
+}
+
+#else
+
+static void
+translate_closest(i_quantize *quant, i_img *img, i_palidx *out) {
+  quant->perturb = 0;
+  translate_addi(quant, img, out);
+}
+
+#endif
+
 static int floyd_map[] =
 {
   0, 0, 7,
@@ -1358,6 +1970,160 @@ typedef struct errdiff_tag {
   int r, g, b;
 } errdiff_t;
 
+#ifdef IM_CFINVMAP
+
+/* columns handed to errdiff_band() at a time */
+#define ERRDIFF_STEP 64
+
+typedef struct {
+  inv_map *inv;
+  i_img *img;
+  i_palidx *out;
+  int is_gray;
+  int difftotal;
+
+  /* the map entries that carry error to a later pixel, in row order,
+     as the row above and column offset of the pixel the error comes
+     from */
+  int tap_count;
+  int *tap_dy;
+  int *tap_dx;
+  int *tap_weight;
+
+  /* the error left by each pixel for the last ring rows, with pad
+     columns of zeros either side */
+  errdiff_t *err;
+  i_img_dim err_w;
+  i_img_dim pad;
+  i_img_dim ring;
+} errdiff_state;
+
+/*
+=item errdiff_band(state, y, x_start, x_end)
+
+Dither pixels C<x_start> to C<x_end>-1 of row C<y>.
+
+Instead of pushing each pixel's error forward, as translate_errdiff()
+does, each pixel sums the error from the pixels that would have
+pushed error to it, so the only shared state written is the pixel's
+own error.  The sums are the same integers, so the result is the
+same.
+
+=cut
+*/
+
+static void
+errdiff_band(void *p, i_img_dim y, i_img_dim x_start, i_img_dim x_end) {
+  errdiff_state *state = p;
+  inv_map *inv = state->inv;
+  i_img *img = state->img;
+  int difftotal = state->difftotal;
+  i_color vals[ERRDIFF_STEP];
+  const errdiff_t **rows = im_band_alloc(sizeof(errdiff_t *) * (state->tap_count + 1));
+  errdiff_t *cur = state->err + (y % state->ring) * state->err_w + state->pad;
+  i_palidx *out = state->out + y * img->xsize;
+  int taps, t;
+  i_img_dim x;
+
+  /* rows above the top of the image have no error */
+  for (taps = 0; taps < state->tap_count && state->tap_dy[taps] <= y; ++taps) {
+    rows[taps] = state->err
+      + ((y - state->tap_dy[taps]) % state->ring) * state->err_w
+      + state->pad + state->tap_dx[taps];
+  }
+
+  i_glin(img, x_start, x_end, y, vals);
+  for (x = x_start; x < x_end; ++x) {
+    i_color val = vals[x - x_start];
+    errdiff_t perr;
+    const i_color *pal;
+    int bst_idx;
+
+    if (img->channels < 3) {
+      val.channel[1] = val.channel[2] = val.channel[0];
+    }
+    else if (state->is_gray) {
+      int gray = 0.5 + color_to_grey(&val);
+      val.channel[0] = val.channel[1] = val.channel[2] = gray;
+    }
+    perr.r = perr.g = perr.b = 0;
+    for (t = 0; t < taps; ++t) {
+      const errdiff_t *e = rows[t] + x;
+      perr.r += e->r * state->tap_weight[t];
+      perr.g += e->g * state->tap_weight[t];
+      perr.b += e->b * state->tap_weight[t];
+    }
+    perr.r = perr.r < 0 ? -((-perr.r)/difftotal) : perr.r/difftotal;
+    perr.g = perr.g < 0 ? -((-perr.g)/difftotal) : perr.g/difftotal;
+    perr.b = perr.b < 0 ? -((-perr.b)/difftotal) : perr.b/difftotal;
+    val.channel[0] = g_sat(val.channel[0]-perr.r);
+    val.channel[1] = g_sat(val.channel[1]-perr.g);
+    val.channel[2] = g_sat(val.channel[2]-perr.b);
+    bst_idx = inv_find(inv, val.channel[0], val.channel[1], val.channel[2]);
+    pal = inv->colors + bst_idx;
+    cur[x].r = pal->channel[0] - val.channel[0];
+    cur[x].g = pal->channel[1] - val.channel[1];
+    cur[x].b = pal->channel[2] - val.channel[2];
+    out[x] = bst_idx;
+  }
+
+  im_band_free(rows);
+}
+
+/* error diffusion split across worker threads as a wavefront, each
+   row following mapo columns behind the row above */
+static void
+errdiff_threaded(i_quantize *quant, i_img *img, i_palidx *out,
+		 const int *map, int mapw, int maph, int mapo, int difftotal,
+		 int is_gray) {
+  errdiff_state state;
+  int dx, dy;
+  size_t err_size;
+
+  state.inv = inv_get(quant);
+  inv_fill_all(state.inv);
+  state.img = img;
+  state.out = out;
+  state.is_gray = is_gray;
+  state.difftotal = difftotal;
+
+  /* entries on the top row at or before the current pixel only push
+     error to pixels already done */
+  state.tap_dy = mymalloc(sizeof(int) * 3 * mapw * maph);
+  state.tap_dx = state.tap_dy + mapw * maph;
+  state.tap_weight = state.tap_dx + mapw * maph;
+  state.tap_count = 0;
+  for (dy = 0; dy < maph; ++dy) {
+    for (dx = 0; dx < mapw; ++dx) {
+      if (map[dx+mapw*dy] && (dy > 0 || dx > mapo)) {
+	state.tap_dy[state.tap_count] = dy;
+	state.tap_dx[state.tap_count] = mapo - dx;
+	state.tap_weight[state.tap_count] = map[dx+mapw*dy];
+	++state.tap_count;
+      }
+    }
+  }
+
+  /* rows finish in order and at most thread count rows are in
+     progress, so a row's error is no longer needed by the time its
+     slot is reused */
+  state.pad = mapw;
+  state.err_w = img->xsize + 2 * mapw;
+  state.ring = maph + im_get_thread_count(img->context);
+  err_size = sizeof(errdiff_t) * state.err_w * state.ring;
+  state.err = mymalloc(err_size);
+  memset(state.err, 0, err_size);
+
+  im_run_wavefront(img->context, img->xsize, img->ysize, ERRDIFF_STEP, mapo,
+		   errdiff_band, &state);
+
+  myfree(state.err);
+  myfree(state.tap_dy);
+  inv_release(quant, state.inv);
+}
+
+#endif
+
 /* perform an error diffusion dither */
 static int
 translate_errdiff(i_quantize *quant, i_img *img, i_palidx *out) {
@@ -1400,6 +2166,19 @@ translate_errdiff(i_quantize *quant, i_img *img, i_palidx *out) {
     i_push_error(0, "error diffusion map must contain some non-zero values");
     goto fail;
   }
+  if (mapo < 0 || mapo >= mapw) {
+    i_push_errorf(0, "errdiff_orig must be from 0 to %d", mapw-1);
+    goto fail;
+  }
+
+#ifdef IM_CFINVMAP
+  if (i_img_band_safe(img) && im_get_thread_count(img->context) > 1
+      && img->xsize * img->ysize >= CLOSEST_THREAD_MIN) {
+    errdiff_threaded(quant, img, out, map, mapw, maph, mapo, difftotal,
+		     is_gray);
+    return 1;
+  }
+#endif
 
   errw = img->xsize+mapw;
   err = mymalloc(sizeof(*err) * maph * errw);
@@ -1711,22 +2490,79 @@ i_quant_transparent(i_quantize *quant, i_palidx *data, i_img *img,
   }
 }
 
+typedef struct {
+  i_img *img;
+  i_palidx *data;
+  i_palidx trans_index;
+
+  /* an 8x8 ordered dither map, or NULL to compare against threshold */
+  const unsigned char *spot;
+  int threshold;
+} transp_state;
+
+/*
+=item transparent_band(state, start_y, end_y)
+
+Set pixels in rows C<start_y> to C<end_y>-1 with an alpha below the
+threshold or the dither map to the transparent index.
+
+=cut
+*/
+
 static void
-transparent_threshold(i_quantize *quant, i_palidx *data, i_img *img,
-		      i_palidx trans_index)
-{
-  i_img_dim x, y;
-  i_sample_t *line = mymalloc(img->xsize * sizeof(i_sample_t));
+transparent_band(void *p, i_img_dim start_y, i_img_dim end_y) {
+  transp_state *state = p;
+  i_img *img = state->img;
+  i_img_dim width = img->xsize;
+  i_sample_t *line = im_band_alloc(width * sizeof(i_sample_t));
   int trans_chan = img->channels > 2 ? 3 : 1;
-  
-  for (y = 0; y < img->ysize; ++y) {
-    i_gsamp(img, 0, img->xsize, y, line, &trans_chan, 1);
-    for (x = 0; x < img->xsize; ++x) {
-      if (line[x] < quant->tr_threshold)
-	data[y*img->xsize+x] = trans_index;
+  i_palidx trans_index = state->trans_index;
+  i_img_dim x, y;
+
+  for (y = start_y; y < end_y; ++y) {
+    i_palidx *data = state->data + y * width;
+    i_gsamp(img, 0, width, y, line, &trans_chan, 1);
+    if (state->spot) {
+      const unsigned char *spot = state->spot + (y & 7) * 8;
+      for (x = 0; x < width; ++x) {
+	if (line[x] < spot[x & 7])
+	  data[x] = trans_index;
+      }
+    }
+    else {
+      int threshold = state->threshold;
+      for (x = 0; x < width; ++x) {
+	if (line[x] < threshold)
+	  data[x] = trans_index;
+      }
     }
   }
-  myfree(line);
+
+  im_band_free(line);
+}
+
+static void
+transparent_run(transp_state *state) {
+  i_img *img = state->img;
+
+  if (i_img_band_safe(img))
+    im_run_bands(img->context, 0, img->ysize, transparent_band, state);
+  else
+    transparent_band(state, 0, img->ysize);
+}
+
+static void
+transparent_threshold(i_quantize *quant, i_palidx *data, i_img *img,
+		      i_palidx trans_index)
+{
+  transp_state state;
+
+  state.img = img;
+  state.data = data;
+  state.trans_index = trans_index;
+  state.spot = NULL;
+  state.threshold = quant->tr_threshold;
+  transparent_run(&state);
 }
 
 static void
@@ -1897,23 +2733,16 @@ static void
 transparent_ordered(i_quantize *quant, i_palidx *data, i_img *img,
 		    i_palidx trans_index)
 {
-  unsigned char *spot;
-  i_img_dim x, y;
-  i_sample_t *line;
-  int trans_chan = img->channels > 2 ? 3 : 1;
+  transp_state state;
+
+  state.img = img;
+  state.data = data;
+  state.trans_index = trans_index;
   if (quant->tr_orddith == od_custom)
-    spot = quant->tr_custom;
+    state.spot = quant->tr_custom;
   else
-    spot = orddith_maps[quant->tr_orddith];
-
-  line = mymalloc(img->xsize * sizeof(i_sample_t));
-  for (y = 0; y < img->ysize; ++y) {
-    i_gsamp(img, 0, img->xsize, y, line, &trans_chan, 1);
-    for (x = 0; x < img->xsize; ++x) {
-      if (line[x] < spot[(x&7)+(y&7)*8])
-	data[x+y*img->xsize] = trans_index;
-    }
-  }
-  myfree(line);
+    state.spot = orddith_maps[quant->tr_orddith];
+  state.threshold = 0;
+  transparent_run(&state);
 }
 
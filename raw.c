@@ -1,6 +1,7 @@
 #include "imager.h"
 #include <stdio.h>
 #include "iolayer.h"
+#include "imageri.h"
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
@@ -134,56 +135,66 @@ i_readraw_wiol(io_glue *ig, i_img_dim x, i_img_dim y, int datachannels, int stor
 undef_int
 i_writeraw_wiol(i_img* im, io_glue *ig) {
   ssize_t rc;
+  i_io_vec vec;
 
   i_clear_error();
   mm_log((1,"writeraw(im %p,ig %p)\n", im, ig));
   
   if (im == NULL) { mm_log((1,"Image is empty\n")); return(0); }
   if (!im->virtual) {
-    rc = i_io_write(ig,im->idata,im->bytes);
+    /* straight from the image data, without copying through the
+       io buffer */
+    vec.data = im->idata;
+    vec.size = im->bytes;
+    rc = i_io_writev(ig, &vec, 1);
     if (rc != im->bytes) { 
       i_push_error(errno, "Could not write to file");
       mm_log((1,"i_writeraw: Couldn't write to file\n")); 
       return(0);
     }
   } else {
+    /* gather a strip of rows for each write */
+    size_t line_size;
+    i_img_dim rows;
+    unsigned char *data;
+    i_img_dim y = 0;
+    i_img_dim row;
+
     if (im->type == i_direct_type) {
       /* just save it as 8-bits, maybe support saving higher bit count
          raw images later */
-      size_t line_size = im->xsize * im->channels;
-      unsigned char *data = mymalloc(line_size);
-
-      i_img_dim y = 0;
-      rc = line_size;
-      while (rc == line_size && y < im->ysize) {
-	i_gsamp(im, 0, im->xsize, y, data, NULL, im->channels);
-	rc = i_io_write(ig, data, line_size);
-	++y;
-      }
-      if (rc != line_size) {
-        i_push_error(errno, "write error");
-        return 0;
-      }
-      myfree(data);
-    } else {
+      line_size = im->xsize * im->channels;
+    }
+    else {
       /* paletted image - assumes the caller puts the palette somewhere 
          else
       */
-      size_t line_size = sizeof(i_palidx) * im->xsize;
-      i_palidx *data = mymalloc(sizeof(i_palidx) * im->xsize);
-
-      i_img_dim y = 0;
-      rc = line_size;
-      while (rc == line_size && y < im->ysize) {
-	i_gpal(im, 0, im->xsize, y, data);
-	rc = i_io_write(ig, data, line_size);
-	++y;
-      }
-      myfree(data);
-      if (rc != line_size) {
-        i_push_error(errno, "write error");
-        return 0;
+      line_size = sizeof(i_palidx) * im->xsize;
+    }
+    rows = im_int_io_strip_rows(line_size, im->ysize);
+    data = mymalloc(line_size * rows);
+
+    rc = 0;
+    while (rc >= 0 && y < im->ysize) {
+      if (rows > im->ysize - y)
+	rows = im->ysize - y;
+      for (row = 0; row < rows; ++row) {
+	if (im->type == i_direct_type)
+	  i_gsamp(im, 0, im->xsize, y + row, data + line_size * row, NULL,
+		  im->channels);
+	else
+	  i_gpal(im, 0, im->xsize, y + row,
+		 (i_palidx *)(data + line_size * row));
       }
+      vec.data = data;
+      vec.size = line_size * rows;
+      rc = i_io_writev(ig, &vec, 1);
+      y += rows;
+    }
+    myfree(data);
+    if (rc < 0) {
+      i_push_error(errno, "write error");
+      return 0;
     }
   }
 
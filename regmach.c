@@ -441,3 +441,837 @@ i_color i_rm_run(struct rm_op codes[], size_t code_count,
   return bcol;
   /* croak("no return opcode"); */
 }
+
+/*
+=head1 COMPILED PROGRAMS
+
+i_rm_run() decodes every instruction of the program for every pixel.
+i_rm_compile() checks a program once, folds instructions that only
+depend on constant registers, drops instructions whose results are
+never used, and translates the rest into an array of handler
+functions, each of which executes one instruction and returns the
+next instruction to run, so i_rm_prog_run() only has to call through
+a pointer per instruction.
+
+Programs without jumps can also be run for up to C<RM_LANES> pixels at
+once with i_rm_prog_run_lanes(), where each register holds a value
+per pixel and each instruction is a tight loop over the pixels, so
+there's only one indirect call per instruction for the whole batch.
+
+=over
+
+=cut
+*/
+
+/* registers for compiled programs, a single set for
+   i_rm_prog_run(), or RM_LANES of each register for
+   i_rm_prog_run_lanes(), with the lanes of each register stored
+   together */
+typedef struct {
+  double *n_regs;
+  i_color *c_regs;
+  i_img **images;
+  i_color result;
+  int count;
+  i_color *results;
+} rm_state;
+
+typedef const struct rm_cop *(*rm_func)(const struct rm_cop *op, rm_state *st);
+typedef int (*rm_vfunc)(const struct rm_cop *op, rm_state *st);
+
+struct rm_cop {
+  rm_func func;
+  rm_vfunc vfunc;
+  rm_word ra, rb, rc, rd, rout;
+  const struct rm_cop *target;
+};
+
+/* the body of each instruction, used by both the scalar and the lane
+   handlers, in terms of the register macros */
+#define GETP(n) \
+  i_gpix(st->images[n], na, nb, &cout); \
+  if (st->images[n]->channels < 4) cout.rgba.a = 255
+#define RMB_add nout = na + nb
+#define RMB_subtract nout = na - nb
+#define RMB_mult nout = na * nb
+#define RMB_div if (fabs(nb) < 1e-10) nout = 1e10; else nout = na / nb
+#define RMB_mod if (fabs(nb) > 1e-10) nout = fmod(na, nb); else nout = 0
+#define RMB_pow nout = pow(na, nb)
+#define RMB_uminus nout = -na
+#define RMB_multp cout = make_rgb(ca.rgb.r * nb, ca.rgb.g * nb, ca.rgb.b * nb, 255)
+#define RMB_addp cout = make_rgb(ca.rgb.r + cb.rgb.r, ca.rgb.g + cb.rgb.g, ca.rgb.b + cb.rgb.b, 255)
+#define RMB_subtractp cout = make_rgb(ca.rgb.r - cb.rgb.r, ca.rgb.g - cb.rgb.g, ca.rgb.b - cb.rgb.b, 255)
+#define RMB_sin nout = sin(na)
+#define RMB_cos nout = cos(na)
+#define RMB_atan2 nout = atan2(na, nb)
+#define RMB_sqrt nout = sqrt(na)
+#define RMB_distance double dx = na - nc; double dy = nb - nd; nout = sqrt(dx*dx+dy*dy)
+#define RMB_getp1 GETP(0)
+#define RMB_getp2 GETP(1)
+#define RMB_getp3 GETP(2)
+#define RMB_value nout = hsv_value(ca)
+#define RMB_hue nout = hsv_hue(ca)
+#define RMB_sat nout = hsv_sat(ca)
+#define RMB_hsv cout = make_hsv(na, nb, nc, 255)
+#define RMB_red nout = ca.rgb.r
+#define RMB_green nout = ca.rgb.g
+#define RMB_blue nout = ca.rgb.b
+#define RMB_rgb cout = make_rgb(na, nb, nc, 255)
+#define RMB_int nout = (int)(na)
+#define RMB_if nout = na ? nb : nc
+#define RMB_ifp cout = na ? cb : cc
+#define RMB_le nout = na <= nb + n_epsilon(na,nb)
+#define RMB_lt nout = na < nb
+#define RMB_ge nout = na >= nb - n_epsilon(na,nb)
+#define RMB_gt nout = na > nb
+#define RMB_eq nout = fabs(na-nb) <= n_epsilon(na,nb)
+#define RMB_ne nout = fabs(na-nb) > n_epsilon(na,nb)
+#define RMB_and nout = na && nb
+#define RMB_or nout = na || nb
+#define RMB_not nout = !na
+#define RMB_abs nout = fabs(na)
+#define RMB_set nout = na
+#define RMB_setp cout = ca
+#define RMB_print nout = na; printf("r%d is %g\n", op->ra, na)
+#define RMB_rgba cout = make_rgb(na, nb, nc, nd)
+#define RMB_hsva cout = make_hsv(na, nb, nc, nd)
+#define RMB_alpha nout = ca.rgba.a
+#define RMB_log if (na > 0) nout = log(na); else nout = DBL_MAX
+#define RMB_exp if (na <= MAX_EXP_ARG) nout = exp(na); else nout = DBL_MAX
+#define RMB_det nout = na*nd-nb*nc
+
+#undef nout
+#undef na
+#undef nb
+#undef nc
+#undef nd
+#undef cout
+#undef ca
+#undef cb
+#undef cc
+#undef cd
+#define nout st->n_regs[op->rout]
+#define na st->n_regs[op->ra]
+#define nb st->n_regs[op->rb]
+#define nc st->n_regs[op->rc]
+#define nd st->n_regs[op->rd]
+#define cout st->c_regs[op->rout]
+#define ca st->c_regs[op->ra]
+#define cb st->c_regs[op->rb]
+#define cc st->c_regs[op->rc]
+#define cd st->c_regs[op->rd]
+
+/* scalar handlers, run one instruction and return the next */
+#define RM_OP(name) \
+  static const struct rm_cop * \
+  rmc_##name(const struct rm_cop *op, rm_state *st) { \
+    RMB_##name; \
+    return op + 1; \
+  }
+
+RM_OP(add)
+RM_OP(subtract)
+RM_OP(mult)
+RM_OP(div)
+RM_OP(mod)
+RM_OP(pow)
+RM_OP(uminus)
+RM_OP(multp)
+RM_OP(addp)
+RM_OP(subtractp)
+RM_OP(sin)
+RM_OP(cos)
+RM_OP(atan2)
+RM_OP(sqrt)
+RM_OP(distance)
+RM_OP(getp1)
+RM_OP(getp2)
+RM_OP(getp3)
+RM_OP(value)
+RM_OP(hue)
+RM_OP(sat)
+RM_OP(hsv)
+RM_OP(red)
+RM_OP(green)
+RM_OP(blue)
+RM_OP(rgb)
+RM_OP(int)
+RM_OP(if)
+RM_OP(ifp)
+RM_OP(le)
+RM_OP(lt)
+RM_OP(ge)
+RM_OP(gt)
+RM_OP(eq)
+RM_OP(ne)
+RM_OP(and)
+RM_OP(or)
+RM_OP(not)
+RM_OP(abs)
+RM_OP(set)
+RM_OP(setp)
+RM_OP(print)
+RM_OP(rgba)
+RM_OP(hsva)
+RM_OP(alpha)
+RM_OP(log)
+RM_OP(exp)
+RM_OP(det)
+
+static const struct rm_cop *
+rmc_ret(const struct rm_cop *op, rm_state *st) {
+  st->result = ca;
+  return NULL;
+}
+
+static const struct rm_cop *
+rmc_jump(const struct rm_cop *op, rm_state *st) {
+  return op->target;
+}
+
+static const struct rm_cop *
+rmc_jumpz(const struct rm_cop *op, rm_state *st) {
+  return na ? op + 1 : op->target;
+}
+
+static const struct rm_cop *
+rmc_jumpnz(const struct rm_cop *op, rm_state *st) {
+  return na ? op->target : op + 1;
+}
+
+/* run off the end of the program without a ret */
+static const struct rm_cop *
+rmc_end(const struct rm_cop *op, rm_state *st) {
+  st->result = bcol;
+  return NULL;
+}
+
+#undef nout
+#undef na
+#undef nb
+#undef nc
+#undef nd
+#undef cout
+#undef ca
+#undef cb
+#undef cc
+#undef cd
+#define RM_LANE(reg) ((size_t)(reg) * RM_LANES + i)
+#define nout st->n_regs[RM_LANE(op->rout)]
+#define na st->n_regs[RM_LANE(op->ra)]
+#define nb st->n_regs[RM_LANE(op->rb)]
+#define nc st->n_regs[RM_LANE(op->rc)]
+#define nd st->n_regs[RM_LANE(op->rd)]
+#define cout st->c_regs[RM_LANE(op->rout)]
+#define ca st->c_regs[RM_LANE(op->ra)]
+#define cb st->c_regs[RM_LANE(op->rb)]
+#define cc st->c_regs[RM_LANE(op->rc)]
+#define cd st->c_regs[RM_LANE(op->rd)]
+
+/* lane handlers, run one instruction for every lane, return non-zero
+   to stop */
+#define RM_VOP(name) \
+  static int \
+  rmv_##name(const struct rm_cop *op, rm_state *st) { \
+    int i; \
+    for (i = 0; i < st->count; ++i) { \
+      RMB_##name; \
+    } \
+    return 0; \
+  }
+
+RM_VOP(add)
+RM_VOP(subtract)
+RM_VOP(mult)
+RM_VOP(div)
+RM_VOP(mod)
+RM_VOP(pow)
+RM_VOP(uminus)
+RM_VOP(multp)
+RM_VOP(addp)
+RM_VOP(subtractp)
+RM_VOP(sin)
+RM_VOP(cos)
+RM_VOP(atan2)
+RM_VOP(sqrt)
+RM_VOP(distance)
+RM_VOP(getp1)
+RM_VOP(getp2)
+RM_VOP(getp3)
+RM_VOP(value)
+RM_VOP(hue)
+RM_VOP(sat)
+RM_VOP(hsv)
+RM_VOP(red)
+RM_VOP(green)
+RM_VOP(blue)
+RM_VOP(rgb)
+RM_VOP(int)
+RM_VOP(if)
+RM_VOP(ifp)
+RM_VOP(le)
+RM_VOP(lt)
+RM_VOP(ge)
+RM_VOP(gt)
+RM_VOP(eq)
+RM_VOP(ne)
+RM_VOP(and)
+RM_VOP(or)
+RM_VOP(not)
+RM_VOP(abs)
+RM_VOP(set)
+RM_VOP(setp)
+RM_VOP(print)
+RM_VOP(rgba)
+RM_VOP(hsva)
+RM_VOP(alpha)
+RM_VOP(log)
+RM_VOP(exp)
+RM_VOP(det)
+
+static int
+rmv_ret(const struct rm_cop *op, rm_state *st) {
+  int i;
+  for (i = 0; i < st->count; ++i)
+    st->results[i] = ca;
+  return 1;
+}
+
+static int
+rmv_end(const struct rm_cop *op, rm_state *st) {
+  int i;
+  for (i = 0; i < st->count; ++i)
+    st->results[i] = bcol;
+  return 1;
+}
+
+/* instruction properties, indexed by opcode:
+   the types of the input operands, n for numeric register, c for
+   color register, j for jump target,
+   the type of the output register, if any,
+   and flags */
+
+#define RMF_FOLD 1 /* result depends only on the operands */
+#define RMF_KEEP 2 /* has an effect besides setting the output */
+#define RMF_JUMP 4 /* no lane handler */
+
+static const struct {
+  rm_func func;
+  rm_vfunc vfunc;
+  const char *in;
+  char out;
+  int flags;
+} rm_ops[rbc_op_count] =
+  {
+    { rmc_add, rmv_add, "nn", 'n', RMF_FOLD },
+    { rmc_subtract, rmv_subtract, "nn", 'n', RMF_FOLD },
+    { rmc_mult, rmv_mult, "nn", 'n', RMF_FOLD },
+    { rmc_div, rmv_div, "nn", 'n', RMF_FOLD },
+    { rmc_mod, rmv_mod, "nn", 'n', RMF_FOLD },
+    { rmc_pow, rmv_pow, "nn", 'n', RMF_FOLD },
+    { rmc_uminus, rmv_uminus, "n", 'n', RMF_FOLD },
+    { rmc_multp, rmv_multp, "cn", 'c', RMF_FOLD },
+    { rmc_addp, rmv_addp, "cc", 'c', RMF_FOLD },
+    { rmc_subtractp, rmv_subtractp, "cc", 'c', RMF_FOLD },
+    { rmc_sin, rmv_sin, "n", 'n', RMF_FOLD },
+    { rmc_cos, rmv_cos, "n", 'n', RMF_FOLD },
+    { rmc_atan2, rmv_atan2, "nn", 'n', RMF_FOLD },
+    { rmc_sqrt, rmv_sqrt, "n", 'n', RMF_FOLD },
+    { rmc_distance, rmv_distance, "nnnn", 'n', RMF_FOLD },
+    { rmc_getp1, rmv_getp1, "nn", 'c', 0 },
+    { rmc_getp2, rmv_getp2, "nn", 'c', 0 },
+    { rmc_getp3, rmv_getp3, "nn", 'c', 0 },
+    { rmc_value, rmv_value, "c", 'n', RMF_FOLD },
+    { rmc_hue, rmv_hue, "c", 'n', RMF_FOLD },
+    { rmc_sat, rmv_sat, "c", 'n', RMF_FOLD },
+    { rmc_hsv, rmv_hsv, "nnn", 'c', RMF_FOLD },
+    { rmc_red, rmv_red, "c", 'n', RMF_FOLD },
+    { rmc_green, rmv_green, "c", 'n', RMF_FOLD },
+    { rmc_blue, rmv_blue, "c", 'n', RMF_FOLD },
+    { rmc_rgb, rmv_rgb, "nnn", 'c', RMF_FOLD },
+    { rmc_int, rmv_int, "n", 'n', RMF_FOLD },
+    { rmc_if, rmv_if, "nnn", 'n', RMF_FOLD },
+    { rmc_ifp, rmv_ifp, "ncc", 'c', RMF_FOLD },
+    { rmc_le, rmv_le, "nn", 'n', RMF_FOLD },
+    { rmc_lt, rmv_lt, "nn", 'n', RMF_FOLD },
+    { rmc_ge, rmv_ge, "nn", 'n', RMF_FOLD },
+    { rmc_gt, rmv_gt, "nn", 'n', RMF_FOLD },
+    { rmc_eq, rmv_eq, "nn", 'n', RMF_FOLD },
+    { rmc_ne, rmv_ne, "nn", 'n', RMF_FOLD },
+    { rmc_and, rmv_and, "nn", 'n', RMF_FOLD },
+    { rmc_or, rmv_or, "nn", 'n', RMF_FOLD },
+    { rmc_not, rmv_not, "n", 'n', RMF_FOLD },
+    { rmc_abs, rmv_abs, "n", 'n', RMF_FOLD },
+    { rmc_ret, rmv_ret, "c", 0, RMF_KEEP },
+    { rmc_jump, NULL, "j", 0, RMF_KEEP | RMF_JUMP },
+    { rmc_jumpz, NULL, "nj", 0, RMF_KEEP | RMF_JUMP },
+    { rmc_jumpnz, NULL, "nj", 0, RMF_KEEP | RMF_JUMP },
+    { rmc_set, rmv_set, "n", 'n', RMF_FOLD },
+    { rmc_setp, rmv_setp, "c", 'c', RMF_FOLD },
+    { rmc_print, rmv_print, "n", 'n', RMF_KEEP },
+    { rmc_rgba, rmv_rgba, "nnnn", 'c', RMF_FOLD },
+    { rmc_hsva, rmv_hsva, "nnnn", 'c', RMF_FOLD },
+    { rmc_alpha, rmv_alpha, "c", 'n', RMF_FOLD },
+    { rmc_log, rmv_log, "n", 'n', RMF_FOLD },
+    { rmc_exp, rmv_exp, "n", 'n', RMF_FOLD },
+    { rmc_det, rmv_det, "nnnn", 'n', RMF_FOLD },
+  };
+
+static rm_word
+rm_operand(const struct rm_op *op, int index) {
+  switch (index) {
+  case 0: return op->ra;
+  case 1: return op->rb;
+  case 2: return op->rc;
+  default: return op->rd;
+  }
+}
+
+/*
+=item rm_keeps_state(codes, code_count, n_regs_count, c_regs_count, n_writes, c_writes)
+
+Returns non-zero if some path through the program reads a register
+that the program writes before anything on that path has written it,
+so the read sees the value left by the previous pixel.
+
+The co-ordinate registers and registers nothing writes are ignored.
+
+=cut
+*/
+
+static int
+rm_keeps_state(const struct rm_op codes[], size_t code_count,
+	       size_t n_regs_count, size_t c_regs_count,
+	       const size_t *n_writes, const size_t *c_writes) {
+  size_t regs = n_regs_count + c_regs_count;
+  /* written[i * regs + r] is set if every path to instruction i
+     writes register r, with the color registers after the numeric */
+  char *written = mymalloc(regs * (code_count + 1) + 1);
+  char *reached = mymalloc(code_count + 1);
+  char *out = mymalloc(regs + 1);
+  size_t i, r;
+  int j;
+  int changed;
+  int result = 0;
+
+  memset(reached, 0, code_count + 1);
+  memset(written, 0, regs);
+  reached[0] = 1;
+  do {
+    changed = 0;
+    for (i = 0; i < code_count; ++i) {
+      const struct rm_op *op = codes + i;
+      size_t succ[2];
+      int succ_count = 0;
+      int k;
+
+      if (!reached[i])
+	continue;
+      memcpy(out, written + i * regs, regs);
+      if (rm_ops[op->code].out == 'n')
+	out[op->rout] = 1;
+      else if (rm_ops[op->code].out == 'c')
+	out[n_regs_count + op->rout] = 1;
+      if (op->code != rbc_jump && op->code != rbc_ret)
+	succ[succ_count++] = i + 1;
+      if (op->code == rbc_jump)
+	succ[succ_count++] = op->ra;
+      else if (op->code == rbc_jumpz || op->code == rbc_jumpnz)
+	succ[succ_count++] = op->rb;
+      for (k = 0; k < succ_count; ++k) {
+	char *dest = written + succ[k] * regs;
+	if (!reached[succ[k]]) {
+	  memcpy(dest, out, regs);
+	  reached[succ[k]] = 1;
+	  changed = 1;
+	}
+	else {
+	  for (r = 0; r < regs; ++r) {
+	    if (dest[r] && !out[r]) {
+	      dest[r] = 0;
+	      changed = 1;
+	    }
+	  }
+	}
+      }
+    }
+  } while (changed);
+
+  for (i = 0; i < code_count && !result; ++i) {
+    const struct rm_op *op = codes + i;
+    const char *in = rm_ops[op->code].in;
+    const char *done = written + i * regs;
+
+    if (!reached[i])
+      continue;
+    for (j = 0; in[j]; ++j) {
+      rm_word r = rm_operand(op, j);
+      if (in[j] == 'n' ? r >= 2 && n_writes[r] && !done[r]
+	  : in[j] == 'c' && c_writes[r] && !done[n_regs_count + r]) {
+	result = 1;
+	break;
+      }
+    }
+  }
+
+  myfree(written);
+  myfree(reached);
+  myfree(out);
+
+  return result;
+}
+
+/*
+=item i_rm_compile(codes, code_count, n_regs, n_regs_count, c_regs, c_regs_count)
+
+Check and compile a register machine program, with the given initial
+register values.  Numeric registers 0 and 1 are the x and y
+co-ordinates of the pixel, any other register that no instruction
+writes to is treated as a constant.
+
+Instructions at the start of the program, before any jump or jump
+target, that only read constant registers, are the only writer of
+their output register and whose output isn't read by an earlier
+instruction are evaluated once here, and their output becomes a
+constant.  Instructions other than C<ret>, jumps and
+C<print> whose output is never read are dropped.
+
+Registers keep their values from one pixel to the next.  If a
+register other than the co-ordinates can be read before the program
+writes it, C<keeps_state> is set in the result, and the caller must
+run every pixel in order with a single set of registers.
+
+Returns NULL, with an error pushed, if the program contains an
+unknown opcode or a register number or jump target out of range.
+
+=cut
+*/
+
+i_rm_prog *
+i_rm_compile(const struct rm_op codes[], size_t code_count,
+	     const double n_regs[], size_t n_regs_count,
+	     const i_color c_regs[], size_t c_regs_count) {
+  i_rm_prog *prog;
+  size_t i, k;
+  int j;
+  size_t entry = code_count;
+  size_t *n_writes, *c_writes;
+  char *n_read, *c_read;
+  char *keep;
+  size_t *new_index;
+  size_t op_count;
+  int changed;
+
+  if (!MAX_EXP_ARG) MAX_EXP_ARG = log(DBL_MAX);
+
+  /* validate */
+  for (i = 0; i < code_count; ++i) {
+    const struct rm_op *op = codes + i;
+    const char *in;
+
+    if (op->code < 0 || op->code >= rbc_op_count) {
+      i_push_errorf(0, "transform2: bad opcode %d at instruction %ld",
+		    (int)op->code, (long)i);
+      return NULL;
+    }
+    for (j = 0, in = rm_ops[op->code].in; in[j]; ++j) {
+      rm_word r = rm_operand(op, j);
+      size_t limit = in[j] == 'n' ? n_regs_count
+	: in[j] == 'c' ? c_regs_count : code_count + 1;
+      if (r < 0 || (size_t)r >= limit) {
+	i_push_errorf(0, "transform2: operand %d out of range at instruction %ld",
+		      (int)r, (long)i);
+	return NULL;
+      }
+    }
+    if (rm_ops[op->code].out) {
+      size_t limit = rm_ops[op->code].out == 'n' ? n_regs_count : c_regs_count;
+      if (op->rout < 0 || (size_t)op->rout >= limit) {
+	i_push_errorf(0, "transform2: output register %d out of range at instruction %ld",
+		      (int)op->rout, (long)i);
+	return NULL;
+      }
+    }
+  }
+
+  prog = mymalloc(sizeof(i_rm_prog));
+  prog->n_regs_count = n_regs_count;
+  prog->n_regs = mymalloc(sizeof(double) * (n_regs_count ? n_regs_count : 1));
+  if (n_regs_count)
+    memcpy(prog->n_regs, n_regs, sizeof(double) * n_regs_count);
+  prog->c_regs_count = c_regs_count;
+  prog->c_regs = mymalloc(sizeof(i_color) * (c_regs_count ? c_regs_count : 1));
+  if (c_regs_count)
+    memcpy(prog->c_regs, c_regs, sizeof(i_color) * c_regs_count);
+  prog->need_images = 0;
+  prog->has_jumps = 0;
+
+  n_writes = mymalloc(sizeof(size_t) * (n_regs_count + 1));
+  c_writes = mymalloc(sizeof(size_t) * (c_regs_count + 1));
+  memset(n_writes, 0, sizeof(size_t) * (n_regs_count + 1));
+  memset(c_writes, 0, sizeof(size_t) * (c_regs_count + 1));
+  n_read = mymalloc(n_regs_count + 1);
+  c_read = mymalloc(c_regs_count + 1);
+  keep = mymalloc(code_count + 1);
+  new_index = mymalloc(sizeof(size_t) * (code_count + 1));
+
+  /* the entry block runs in order for every pixel */
+  for (i = 0; i < code_count; ++i) {
+    const struct rm_op *op = codes + i;
+    int code = op->code;
+
+    keep[i] = 1;
+    if (rm_ops[code].out == 'n')
+      ++n_writes[op->rout];
+    else if (rm_ops[code].out == 'c')
+      ++c_writes[op->rout];
+    if (code >= rbc_getp1 && code <= rbc_getp3
+	&& code - rbc_getp1 + 1 > prog->need_images)
+      prog->need_images = code - rbc_getp1 + 1;
+    if (rm_ops[code].flags & RMF_JUMP) {
+      size_t target = code == rbc_jump ? op->ra : op->rb;
+      prog->has_jumps = 1;
+      if (i < entry)
+	entry = i;
+      if (target < entry)
+	entry = target;
+    }
+    else if (code == rbc_ret && i < entry) {
+      entry = i;
+    }
+  }
+
+  prog->keeps_state = rm_keeps_state(codes, code_count, n_regs_count,
+				     c_regs_count, n_writes, c_writes);
+
+  /* fold constant instructions */
+  for (i = 0; i < entry; ++i) {
+    const struct rm_op *op = codes + i;
+    int code = op->code;
+    const char *in = rm_ops[code].in;
+    int is_const;
+
+    if (!(rm_ops[code].flags & RMF_FOLD))
+      continue;
+    if (rm_ops[code].out == 'n'
+	? n_writes[op->rout] != 1 || op->rout < 2
+	: c_writes[op->rout] != 1)
+      continue;
+    is_const = 1;
+    for (j = 0; in[j] && is_const; ++j) {
+      rm_word r = rm_operand(op, j);
+      if (in[j] == 'n')
+	is_const = r >= 2 && n_writes[r] == 0;
+      else
+	is_const = c_writes[r] == 0;
+    }
+    /* an earlier instruction reading the output sees its initial
+       value for the first pixel */
+    for (k = 0; k < i && is_const; ++k) {
+      const char *kin = rm_ops[codes[k].code].in;
+      for (j = 0; kin[j]; ++j) {
+	if (kin[j] == rm_ops[code].out
+	    && rm_operand(codes + k, j) == op->rout) {
+	  is_const = 0;
+	  break;
+	}
+      }
+    }
+    if (is_const) {
+      /* the output is now written by nothing at run time */
+      i_rm_run((struct rm_op *)op, 1, prog->n_regs, n_regs_count,
+	       prog->c_regs, c_regs_count, NULL, 0);
+      if (rm_ops[code].out == 'n')
+	n_writes[op->rout] = 0;
+      else
+	c_writes[op->rout] = 0;
+      keep[i] = 0;
+    }
+  }
+
+  /* drop instructions whose results are never read */
+  do {
+    changed = 0;
+    memset(n_read, 0, n_regs_count + 1);
+    memset(c_read, 0, c_regs_count + 1);
+    for (i = 0; i < code_count; ++i) {
+      const struct rm_op *op = codes + i;
+      const char *in = rm_ops[op->code].in;
+      if (!keep[i])
+	continue;
+      for (j = 0; in[j]; ++j) {
+	rm_word r = rm_operand(op, j);
+	if (in[j] == 'n')
+	  n_read[r] = 1;
+	else if (in[j] == 'c')
+	  c_read[r] = 1;
+      }
+    }
+    for (i = 0; i < code_count; ++i) {
+      const struct rm_op *op = codes + i;
+      int code = op->code;
+      if (!keep[i] || (rm_ops[code].flags & RMF_KEEP))
+	continue;
+      if (rm_ops[code].out == 'n' ? !n_read[op->rout] : !c_read[op->rout]) {
+	keep[i] = 0;
+	changed = 1;
+      }
+    }
+  } while (changed);
+
+  /* jump targets move to the next kept instruction */
+  op_count = 0;
+  for (i = 0; i < code_count; ++i) {
+    new_index[i] = op_count;
+    if (keep[i])
+      ++op_count;
+  }
+  new_index[code_count] = op_count;
+
+  prog->op_count = op_count;
+  prog->ops = mymalloc(sizeof(struct rm_cop) * (op_count + 1));
+  for (i = 0; i < code_count; ++i) {
+    const struct rm_op *op = codes + i;
+    struct rm_cop *cop;
+    if (!keep[i])
+      continue;
+    cop = prog->ops + new_index[i];
+    cop->func = rm_ops[op->code].func;
+    cop->vfunc = rm_ops[op->code].vfunc;
+    cop->ra = op->ra;
+    cop->rb = op->rb;
+    cop->rc = op->rc;
+    cop->rd = op->rd;
+    cop->rout = op->rout;
+    cop->target = NULL;
+    if (op->code == rbc_jump)
+      cop->target = prog->ops + new_index[op->ra];
+    else if (op->code == rbc_jumpz || op->code == rbc_jumpnz)
+      cop->target = prog->ops + new_index[op->rb];
+  }
+  prog->ops[op_count].func = rmc_end;
+  prog->ops[op_count].vfunc = rmv_end;
+  prog->ops[op_count].target = NULL;
+
+  myfree(n_writes);
+  myfree(c_writes);
+  myfree(n_read);
+  myfree(c_read);
+  myfree(keep);
+  myfree(new_index);
+
+  return prog;
+}
+
+/*
+=item i_rm_prog_run(prog, n_regs, c_regs, images)
+
+Run a compiled program, returning the color from its C<ret>
+instruction.
+
+C<n_regs> and C<c_regs> must be at least as large as the register
+counts the program was compiled with, and should start with the
+program's own initial register values, with the pixel co-ordinates
+in the first two numeric registers.
+
+=cut
+*/
+
+i_color
+i_rm_prog_run(const i_rm_prog *prog, double n_regs[], i_color c_regs[],
+	      i_img *images[]) {
+  rm_state st;
+  const struct rm_cop *op = prog->ops;
+
+  st.n_regs = n_regs;
+  st.c_regs = c_regs;
+  st.images = images;
+
+  while (op)
+    op = op->func(op, &st);
+
+  return st.result;
+}
+
+/*
+=item i_rm_prog_init_lanes(prog, n_lanes, c_lanes)
+
+Fill lane registers for i_rm_prog_run_lanes() from the program's
+initial register values.
+
+C<n_lanes> and C<c_lanes> must each have room for C<RM_LANES> of each
+of the program's registers.
+
+=cut
+*/
+
+void
+i_rm_prog_init_lanes(const i_rm_prog *prog, double n_lanes[],
+		     i_color c_lanes[]) {
+  size_t r;
+  int i;
+
+  for (r = 0; r < prog->n_regs_count; ++r) {
+    for (i = 0; i < RM_LANES; ++i)
+      n_lanes[r * RM_LANES + i] = prog->n_regs[r];
+  }
+  for (r = 0; r < prog->c_regs_count; ++r) {
+    for (i = 0; i < RM_LANES; ++i)
+      c_lanes[r * RM_LANES + i] = prog->c_regs[r];
+  }
+}
+
+/*
+=item i_rm_prog_run_lanes(prog, n_lanes, c_lanes, count, images, results)
+
+Run a compiled program for C<count> pixels at once, up to
+C<RM_LANES>, storing each pixel's color in C<results>.
+
+Lane C<i> of register C<r> is at C<n_lanes[r * RM_LANES + i]>, and
+similarly for C<c_lanes>, set the first two numeric registers to the
+co-ordinates of each pixel before calling.
+
+Each instruction is run for every lane before moving on to the next
+instruction, so this can only be used for programs without jumps.
+
+=cut
+*/
+
+void
+i_rm_prog_run_lanes(const i_rm_prog *prog, double n_lanes[],
+		    i_color c_lanes[], int count, i_img *images[],
+		    i_color results[]) {
+  rm_state st;
+  const struct rm_cop *op = prog->ops;
+
+  st.n_regs = n_lanes;
+  st.c_regs = c_lanes;
+  st.images = images;
+  st.count = count;
+  st.results = results;
+
+  while (!op->vfunc(op, &st))
+    ++op;
+}
+
+/*
+=item i_rm_prog_free(prog)
+
+Release a compiled program.
+
+=cut
+*/
+
+void
+i_rm_prog_free(i_rm_prog *prog) {
+  myfree(prog->ops);
+  myfree(prog->n_regs);
+  myfree(prog->c_regs);
+  myfree(prog);
+}
+
+/*
+=back
+
+=cut
+*/
@@ -84,6 +84,48 @@ i_color i_rm_run(struct rm_op codes[], size_t code_count,
 		 i_color c_regs[], size_t c_regs_count,
 		 i_img *images[], size_t image_count);
 
+/* a compiled instruction, private to regmach.c */
+struct rm_cop;
+
+/* a program compiled by i_rm_compile() */
+typedef struct {
+  struct rm_cop *ops;
+  size_t op_count;
+
+  /* initial register values, including any folded constants, copy
+     these into the registers passed to i_rm_prog_run() */
+  double *n_regs;
+  size_t n_regs_count;
+  i_color *c_regs;
+  size_t c_regs_count;
+
+  /* the number of input images the program reads from */
+  int need_images;
+
+  /* non-zero if the program contains any jumps */
+  int has_jumps;
+
+  /* non-zero if some register can be read before the program writes
+     it, so a pixel sees the value left by the previous pixel */
+  int keeps_state;
+} i_rm_prog;
+
+i_rm_prog *i_rm_compile(const struct rm_op codes[], size_t code_count,
+			const double n_regs[], size_t n_regs_count,
+			const i_color c_regs[], size_t c_regs_count);
+i_color i_rm_prog_run(const i_rm_prog *prog, double n_regs[],
+		      i_color c_regs[], i_img *images[]);
+
+/* pixels evaluated at once by i_rm_prog_run_lanes() */
+#define RM_LANES 64
+
+void i_rm_prog_init_lanes(const i_rm_prog *prog, double n_lanes[],
+			  i_color c_lanes[]);
+void i_rm_prog_run_lanes(const i_rm_prog *prog, double n_lanes[],
+			 i_color c_lanes[], int count, i_img *images[],
+			 i_color results[]);
+void i_rm_prog_free(i_rm_prog *prog);
+
 /* op_run(fx, sizeof(fx), parms, 2)) */
 
 #endif /* _REGMACH_H_ */
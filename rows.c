@@ -0,0 +1,410 @@
+/*
+=head1 NAME
+
+rows.c - streaming row sources and sinks
+
+=head1 SYNOPSIS
+
+  i_row_source *src = i_readpnm_rows_wiol(in_ig);
+  i_row_source *scaled = i_row_source_scale(src, 800, 600);
+  i_row_sink *sink = i_writepnm_rows_wiol(out_ig, 800, 600, scaled->channels);
+  if (!i_rows_copy(scaled, sink)) {
+    ... error ...
+  }
+  i_row_sink_destroy(sink);
+  i_row_source_destroy(scaled);
+  i_row_source_destroy(src);
+
+=head1 DESCRIPTION
+
+A row source produces the rows of an image from top to bottom, a few
+at a time, without the whole image being held in memory.  A row sink
+accepts rows from top to bottom and writes them somewhere, typically
+to a file.
+
+Sources can be stacked, so a file reader can feed a scaler which
+feeds a file writer, and only a few rows of each are held in memory
+at any time.
+
+Rows are always 8-bit/sample i_color.
+
+A source or sink that wraps another source doesn't own it, the inner
+source must be destroyed after the outer.
+
+=over
+
+=cut
+*/
+
+#define IMAGER_NO_CONTEXT
+#include "imageri.h"
+
+/* target size of the buffer used when copying rows around */
+#define ROW_BUFFER_BYTES 65536
+
+/*
+=item im_row_source_init(ctx, src, xsize, ysize, channels, f_read, f_destroy)
+X<im_row_source_init API>X<i_row_source_init API>
+=category Row streams
+=synopsis im_row_source_init(aIMCTX, &mysrc->base, xsize, ysize, channels, my_read, my_destroy);
+=synopsis i_row_source_init(&mysrc->base, xsize, ysize, channels, my_read, my_destroy);
+
+Initialize the base structure of a new row source.
+
+C<f_read> is called to read rows, and is never asked for more rows
+than remain in the source.  It should return the number of rows read
+or -1 on failure, after pushing an error.
+
+C<f_destroy> is called to release any resources held by the source,
+it may be NULL.
+
+The source itself should be allocated with mymalloc(), since
+i_row_source_destroy() releases it with myfree().
+
+Also callable as C<i_row_source_init(src, ...)>.
+
+=cut
+*/
+
+void
+im_row_source_init(pIMCTX, i_row_source *src, i_img_dim xsize,
+		   i_img_dim ysize, int channels, i_row_source_read_f f_read,
+		   i_row_source_destroy_f f_destroy) {
+  src->context = aIMCTX;
+  src->xsize = xsize;
+  src->ysize = ysize;
+  src->channels = channels;
+  src->row = 0;
+  src->f_read = f_read;
+  src->f_destroy = f_destroy;
+}
+
+/*
+=item im_row_sink_init(ctx, sink, xsize, ysize, channels, f_write, f_close, f_destroy)
+X<im_row_sink_init API>X<i_row_sink_init API>
+=category Row streams
+=synopsis im_row_sink_init(aIMCTX, &mysink->base, xsize, ysize, channels, my_write, my_close, my_destroy);
+=synopsis i_row_sink_init(&mysink->base, xsize, ysize, channels, my_write, my_close, my_destroy);
+
+Initialize the base structure of a new row sink.
+
+C<f_write> is called to write rows, and is never given more rows than
+the sink was created for.  It returns non-zero on success.
+
+C<f_close> is called once all of the rows have been written, and
+should complete the output, returning non-zero on success.
+
+C<f_destroy> is called to release any resources held by the sink,
+it may be NULL.
+
+Also callable as C<i_row_sink_init(sink, ...)>.
+
+=cut
+*/
+
+void
+im_row_sink_init(pIMCTX, i_row_sink *sink, i_img_dim xsize, i_img_dim ysize,
+		 int channels, i_row_sink_write_f f_write,
+		 i_row_sink_close_f f_close, i_row_sink_destroy_f f_destroy) {
+  sink->context = aIMCTX;
+  sink->xsize = xsize;
+  sink->ysize = ysize;
+  sink->channels = channels;
+  sink->row = 0;
+  sink->closed = 0;
+  sink->f_write = f_write;
+  sink->f_close = f_close;
+  sink->f_destroy = f_destroy;
+}
+
+/*
+=item i_row_source_read(src, rows, count)
+=category Row streams
+=synopsis i_img_dim got = i_row_source_read(src, rows, 16);
+
+Read up to C<count> rows from C<src> into C<rows>, which must have
+room for C<count> * C<< src->xsize >> colors.
+
+Returns the number of rows read, which is only less than C<count> at
+the end of the image, 0 once all of the rows have been read, or -1
+on error.
+
+=cut
+*/
+
+i_img_dim
+i_row_source_read(i_row_source *src, i_color *rows, i_img_dim count) {
+  i_img_dim got;
+
+  if (count <= 0 || src->row >= src->ysize)
+    return 0;
+
+  if (count > src->ysize - src->row)
+    count = src->ysize - src->row;
+
+  got = src->f_read(src, rows, count);
+  if (got > 0)
+    src->row += got;
+
+  return got;
+}
+
+/*
+=item i_row_source_destroy(src)
+=category Row streams
+=synopsis i_row_source_destroy(src);
+
+Release a row source.
+
+=cut
+*/
+
+void
+i_row_source_destroy(i_row_source *src) {
+  if (src->f_destroy)
+    src->f_destroy(src);
+  myfree(src);
+}
+
+/*
+=item i_row_sink_write(sink, rows, count)
+=category Row streams
+=synopsis if (!i_row_sink_write(sink, rows, count)) { ... error ... }
+
+Write C<count> rows from C<rows> to C<sink>.
+
+Fails if more rows are written than the sink was created for.
+
+=cut
+*/
+
+int
+i_row_sink_write(i_row_sink *sink, const i_color *rows, i_img_dim count) {
+  dIMCTXctx(sink->context);
+
+  if (sink->closed) {
+    im_push_error(aIMCTX, 0, "row sink is closed");
+    return 0;
+  }
+  if (count < 0 || count > sink->ysize - sink->row) {
+    im_push_errorf(aIMCTX, 0, "too many rows written, %" i_DF
+		   " rows written to a %" i_DF " row image",
+		   i_DFc(sink->row + count), i_DFc(sink->ysize));
+    return 0;
+  }
+  if (count == 0)
+    return 1;
+
+  if (!sink->f_write(sink, rows, count))
+    return 0;
+
+  sink->row += count;
+
+  return 1;
+}
+
+/*
+=item i_row_sink_close(sink)
+=category Row streams
+=synopsis if (!i_row_sink_close(sink)) { ... error ... }
+
+Complete the output of C<sink>.  Fails if fewer rows were written
+than the sink was created for.
+
+=cut
+*/
+
+int
+i_row_sink_close(i_row_sink *sink) {
+  dIMCTXctx(sink->context);
+
+  if (sink->closed) {
+    im_push_error(aIMCTX, 0, "row sink is already closed");
+    return 0;
+  }
+  if (sink->row != sink->ysize) {
+    im_push_errorf(aIMCTX, 0, "only %" i_DF " of %" i_DF " rows written",
+		   i_DFc(sink->row), i_DFc(sink->ysize));
+    return 0;
+  }
+  sink->closed = 1;
+
+  return sink->f_close(sink);
+}
+
+/*
+=item i_row_sink_destroy(sink)
+=category Row streams
+=synopsis i_row_sink_destroy(sink);
+
+Release a row sink.  This does not close the sink, any output not
+completed by i_row_sink_close() is abandoned.
+
+=cut
+*/
+
+void
+i_row_sink_destroy(i_row_sink *sink) {
+  if (sink->f_destroy)
+    sink->f_destroy(sink);
+  myfree(sink);
+}
+
+/* the number of rows to buffer at a time for a given width */
+static i_img_dim
+buffer_rows(i_img_dim xsize) {
+  i_img_dim rows = ROW_BUFFER_BYTES / (sizeof(i_color) * xsize);
+
+  return rows < 1 ? 1 : rows;
+}
+
+typedef struct {
+  i_row_source base;
+  i_img *im;
+} i_row_source_img_t;
+
+static i_img_dim
+img_read(i_row_source *src, i_color *rows, i_img_dim count) {
+  i_row_source_img_t *isrc = (i_row_source_img_t *)src;
+  i_img_dim i;
+
+  for (i = 0; i < count; ++i)
+    i_glin(isrc->im, 0, src->xsize, src->row + i, rows + i * src->xsize);
+
+  return count;
+}
+
+/*
+=item i_row_source_img(im)
+=category Row streams
+=synopsis i_row_source *src = i_row_source_img(im);
+
+Create a row source that reads the rows of C<im>, converted to
+8-bits/sample.
+
+The image must outlive the source.
+
+=cut
+*/
+
+i_row_source *
+i_row_source_img(i_img *im) {
+  i_row_source_img_t *src;
+  dIMCTXim(im);
+
+  im_log((aIMCTX, 1, "i_row_source_img(im %p)\n", im));
+
+  src = mymalloc(sizeof(i_row_source_img_t));
+  im_row_source_init(aIMCTX, &src->base, im->xsize, im->ysize, im->channels,
+		     img_read, NULL);
+  src->im = im;
+
+  return &src->base;
+}
+
+/*
+=item i_row_source_to_img(src)
+=category Row streams
+=synopsis i_img *im = i_row_source_to_img(src);
+
+Read the remaining rows of C<src> into a new 8-bit/sample image.
+
+Returns NULL on failure.
+
+=cut
+*/
+
+i_img *
+i_row_source_to_img(i_row_source *src) {
+  dIMCTXctx(src->context);
+  i_img_dim chunk = buffer_rows(src->xsize);
+  i_img_dim y = 0;
+  i_img_dim got;
+  i_color *rows;
+  i_img *im;
+
+  im_log((aIMCTX, 1, "i_row_source_to_img(src %p)\n", src));
+
+  im_clear_error(aIMCTX);
+
+  im = im_img_8_new(aIMCTX, src->xsize, src->ysize - src->row, src->channels);
+  if (!im)
+    return NULL;
+
+  rows = mymalloc(sizeof(i_color) * src->xsize * chunk);
+  while ((got = i_row_source_read(src, rows, chunk)) > 0) {
+    i_img_dim i;
+    for (i = 0; i < got; ++i)
+      i_plin(im, 0, src->xsize, y + i, rows + i * src->xsize);
+    y += got;
+  }
+  myfree(rows);
+
+  if (got < 0) {
+    i_img_destroy(im);
+    return NULL;
+  }
+
+  return im;
+}
+
+/*
+=item i_rows_copy(src, sink)
+=category Row streams
+=synopsis if (!i_rows_copy(src, sink)) { ... error ... }
+
+Copy the remaining rows of C<src> to C<sink> and close the sink.
+
+The sink must have the same width as the source and as many rows as
+remain in the source.
+
+=cut
+*/
+
+int
+i_rows_copy(i_row_source *src, i_row_sink *sink) {
+  dIMCTXctx(src->context);
+  i_img_dim chunk = buffer_rows(src->xsize);
+  i_img_dim got;
+  i_color *rows;
+
+  im_log((aIMCTX, 1, "i_rows_copy(src %p, sink %p)\n", src, sink));
+
+  im_clear_error(aIMCTX);
+
+  if (src->xsize != sink->xsize) {
+    im_push_errorf(aIMCTX, 0, "source width %" i_DF " doesn't match sink "
+		   "width %" i_DF, i_DFc(src->xsize), i_DFc(sink->xsize));
+    return 0;
+  }
+  if (src->ysize - src->row != sink->ysize - sink->row) {
+    im_push_errorf(aIMCTX, 0, "source has %" i_DF " rows left but sink "
+		   "expects %" i_DF, i_DFc(src->ysize - src->row),
+		   i_DFc(sink->ysize - sink->row));
+    return 0;
+  }
+
+  rows = mymalloc(sizeof(i_color) * src->xsize * chunk);
+  while ((got = i_row_source_read(src, rows, chunk)) > 0) {
+    if (!i_row_sink_write(sink, rows, got)) {
+      myfree(rows);
+      return 0;
+    }
+  }
+  myfree(rows);
+
+  if (got < 0)
+    return 0;
+
+  return i_row_sink_close(sink);
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+pnm.c, scale.im, convert.im
+
+=cut
+*/
@@ -2,7 +2,7 @@
 
 double
 i_op_run(int codes[], size_t code_size, double parms[], size_t parm_size) {
-  double stack[100];
+  double stack[I_OP_STACK];
   double *sp = stack;
 
   while (code_size) {
@@ -47,3 +47,91 @@ i_op_run(int codes[], size_t code_size, double parms[], size_t parm_size) {
   return sp[-1];
 }
 
+
+/* evaluate the program for count inputs, taking parameters 0 and 1
+   from xs and ys, and storing the values in results.
+
+   Each stack entry holds the values for a batch of inputs, so each
+   operator is a simple loop over the batch.
+*/
+
+void
+i_op_run_batch(int codes[], size_t code_size, double parms[], size_t parm_size,
+	       const double *xs, const double *ys, size_t count,
+	       double *results) {
+  double stack[I_OP_STACK][I_OP_BATCH];
+
+  while (count) {
+    size_t n = count < I_OP_BATCH ? count : I_OP_BATCH;
+    int *code = codes;
+    size_t code_left = code_size;
+    double (*sp)[I_OP_BATCH] = stack;
+    size_t i;
+
+    while (code_left) {
+      switch (*code++) {
+      case bcAdd:
+	for (i = 0; i < n; ++i)
+	  sp[-2][i] += sp[-1][i];
+	--sp;
+	break;
+
+      case bcSubtract:
+	for (i = 0; i < n; ++i)
+	  sp[-2][i] -= sp[-1][i];
+	--sp;
+	break;
+
+      case bcDiv:
+	for (i = 0; i < n; ++i)
+	  sp[-2][i] /= sp[-1][i];
+	--sp;
+	break;
+
+      case bcMult:
+	for (i = 0; i < n; ++i)
+	  sp[-2][i] *= sp[-1][i];
+	--sp;
+	break;
+
+      case bcParm:
+	if (*code == 0) {
+	  for (i = 0; i < n; ++i)
+	    sp[0][i] = xs[i];
+	}
+	else if (*code == 1) {
+	  for (i = 0; i < n; ++i)
+	    sp[0][i] = ys[i];
+	}
+	else {
+	  double value = parms[*code];
+	  for (i = 0; i < n; ++i)
+	    sp[0][i] = value;
+	}
+	++sp;
+	++code;
+	--code_left;
+	break;
+
+      case bcSin:
+	for (i = 0; i < n; ++i)
+	  sp[-1][i] = sin(sp[-1][i]);
+	break;
+
+      case bcCos:
+	for (i = 0; i < n; ++i)
+	  sp[-1][i] = cos(sp[-1][i]);
+	break;
+      }
+      --code_left;
+    }
+
+    for (i = 0; i < n; ++i)
+      results[i] = sp[-1][i];
+
+    xs += n;
+    ys += n;
+    results += n;
+    count -= n;
+  }
+}
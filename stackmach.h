@@ -14,7 +14,16 @@ enum ByteCodes {
   bcCos
 };
 
+/* maximum stack depth for a program */
+#define I_OP_STACK 100
+
+/* number of inputs i_op_run_batch() evaluates together */
+#define I_OP_BATCH 32
+
 double i_op_run(int codes[], size_t code_size, double parms[], size_t parm_size);
+void i_op_run_batch(int codes[], size_t code_size, double parms[], size_t parm_size,
+		    const double *xs, const double *ys, size_t count,
+		    double *results);
 
 /* op_run(fx, sizeof(fx), parms, 2)) */
 
@@ -659,6 +659,84 @@ my $psamp_outside_error = "Image position outside of image";
   is($col[0]->alpha, 255, "should have a 255 alpha");
 }
 
+{
+  # Wu's quantizer
+  my $im = test_image();
+  my $area = $im->getwidth * $im->getheight;
+  my %diff;
+  for my $make (qw(mediancut wu)) {
+    my $pal = $im->to_paletted(make_colors => $make, max_colors => 16);
+    ok($pal, "$make to 16 colors");
+    is($pal->colorcount, 16, "$make: check color count");
+    $diff{$make} = Imager::i_img_diff($im->{IMG}, $pal->to_rgb8->{IMG});
+  }
+  cmp_ok($diff{wu}, "<", $diff{mediancut}, "wu is closer to the source");
+
+  my @colors = Imager->make_palette({ make_colors => "wu",
+				      colors => [ Imager::Color->new("#123456") ],
+				      max_colors => 10 }, $im);
+  is(@colors, 10, "make_palette with wu");
+  is_color3($colors[0], 0x12, 0x34, 0x56, "fixed color kept");
+
+  # test_image() has 148 colors, sampling finds fewer
+  my $sampled = $im->to_paletted(make_colors => "wu", max_samples => 5000);
+  ok($sampled, "wu with sampling");
+  cmp_ok($sampled->colorcount, ">", 50, "found a good number of colors");
+  my $sampled_diff = Imager::i_img_diff($im->{IMG}, $sampled->to_rgb8->{IMG});
+  cmp_ok($sampled_diff / $area, "<", 100, "a reasonable match");
+
+  # many images smaller than the sampling step each still contribute
+  my @frames = map {
+    my $frame = Imager->new(xsize => 10, ysize => 10);
+    $frame->box(filled => 1, color => [ ($_ % 2) * 255, ($_ % 4 >= 2) * 255, 128 ]);
+    $frame;
+  } 1 .. 1000;
+  my @frame_colors = Imager->make_palette({ make_colors => "wu",
+					    max_samples => 100 }, @frames);
+  is(@frame_colors, 4, "wu sampling small images finds every color");
+
+  my $gray = $im->convert(preset => "gray")->to_paletted(make_colors => "wu",
+							 max_colors => 8);
+  ok($gray, "wu on a gray image");
+  is($gray->colorcount, 8, "check color count");
+  my @grays = grep $_->red == $_->green && $_->red == $_->blue,
+    $gray->getcolors;
+  is(@grays, 8, "all gray colors");
+}
+
+{
+  # closest translation picks the nearest palette entry for every pixel
+  srand(1234);
+  my @pal = map [ int(rand 256), int(rand 256), int(rand 256) ], 1 .. 256;
+  my $im = test_image()->scale(xpixels => 64, ypixels => 64);
+  $im->filter(type => "noise", amount => 60, subtype => 1);
+  my $pim = $im->to_paletted(make_colors => "none", translate => "closest",
+			     colors => [ map Imager::Color->new(@$_), @pal ]);
+  ok($pim, "translate to a random palette");
+  my $bad = 0;
+ PIXEL:
+  for my $y (0 .. $im->getheight - 1) {
+    my @samps = $im->getsamples(y => $y, channels => [ 0 .. 2 ]);
+    my @idx = $pim->getscanline(y => $y, type => "index");
+    for my $x (0 .. $#idx) {
+      my @c = splice @samps, 0, 3;
+      my $best = 3 * 256 * 256;
+      for my $p (@pal) {
+	my $d = ($c[0]-$p->[0])**2 + ($c[1]-$p->[1])**2 + ($c[2]-$p->[2])**2;
+	$best = $d if $d < $best;
+      }
+      my $p = $pal[$idx[$x]];
+      my $d = ($c[0]-$p->[0])**2 + ($c[1]-$p->[1])**2 + ($c[2]-$p->[2])**2;
+      if ($d != $best) {
+	++$bad;
+	diag("($x, $y): (@c) mapped to (@$p) at $d, nearest at $best");
+	last PIXEL;
+      }
+    }
+  }
+  is($bad, 0, "all pixels mapped to the nearest colour");
+}
+
 Imager->close_log;
 
 done_testing();
@@ -0,0 +1,167 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image is_image is_imaged is_color4 is_fcolor4
+                    image_bounds_checks mask_tests);
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/150-type-050-tiled.log");
+
+my $double_bits = length(pack("d", 1)) * 8;
+
+{
+  my $im = Imager->new(xsize => 1000, ysize => 700, tiled => 1,
+		       bg => "#FF8000");
+  ok($im, "make a tiled image");
+  ok($im->virtual, "tiled images are virtual");
+  is($im->bits, 8, "default 8 bits");
+  is($im->type, "direct", "always direct");
+  is($im->getchannels, 3, "default 3 channels");
+  is_deeply([ Imager::i_img_tiled_count($im->{IMG}) ], [ 0, 16 * 11 ],
+	    "no tiles allocated yet");
+  is_color4($im->getpixel(x => 999, y => 699), 255, 128, 0, 0,
+	    "untouched pixels read as the background");
+  my @row = $im->getscanline(y => 400, x => 0, width => 1000);
+  is(scalar(grep $_->equals(other => $row[0]), @row), 1000,
+     "the whole row is background");
+  is_deeply([ Imager::i_img_tiled_count($im->{IMG}) ], [ 0, 176 ],
+	    "reads don't allocate tiles");
+
+  ok($im->box(filled => 1, color => "#0000FF",
+	      xmin => 60, ymin => 10, xmax => 69, ymax => 20),
+     "draw a box crossing a tile boundary");
+  is_deeply([ Imager::i_img_tiled_count($im->{IMG}) ], [ 2, 176 ],
+	    "only the touched tiles allocated");
+  is_color4($im->getpixel(x => 63, y => 10), 0, 0, 255, 0, "box pixel");
+  is_color4($im->getpixel(x => 64, y => 20), 0, 0, 255, 0, "box pixel");
+  is_color4($im->getpixel(x => 70, y => 20), 255, 128, 0, 0,
+	    "new tiles start as the background");
+  ok(!Imager::i_img_tiled_count(Imager->new(xsize => 1, ysize => 1)->{IMG}),
+     "not a tiled image");
+}
+
+for my $bits (8, 16, "double") {
+  for my $channels (1 .. 4) {
+    my $name = "$bits/$channels";
+    my $im = Imager->new(xsize => 150, ysize => 130, tiled => 1,
+			 bits => $bits, channels => $channels);
+    ok($im, "$name: make image")
+      or diag(Imager->errstr);
+    is($im->bits, $bits, "$name: check bits");
+    is($im->getchannels, $channels, "$name: check channels");
+
+    # compare against the contiguous image of the same type
+    my $plain = Imager->new(xsize => 150, ysize => 130, bits => $bits,
+			    channels => $channels);
+    for my $work ($im, $plain) {
+      $work->paste(src => test_image()->convert(preset => "addalpha"),
+		   left => 10, top => 20);
+      $work->box(filled => 1, color => "#4080C0", xmin => 60, ymin => 60,
+		 xmax => 140, ymax => 70);
+      $work->line(x1 => 0, y1 => 129, x2 => 149, y2 => 0, color => "#FF0",
+		  aa => 1);
+      $work->setpixel(x => 149, y => 129,
+		      color => Imager::Color::Float->new(0.3, 0.7, 0.123456, 1));
+    }
+    if ($bits eq "8") {
+      is_image($im, $plain, "$name: same as contiguous image");
+    }
+    else {
+      is_imaged($im, $plain, 0, "$name: same as contiguous image");
+    }
+    is_deeply([ $im->getsamples(y => 100, channels => [ reverse 0 .. $channels-1 ],
+				type => "float") ],
+	      [ $plain->getsamples(y => 100, channels => [ reverse 0 .. $channels-1 ],
+				   type => "float") ],
+	      "$name: check getsamples with channels");
+    is_deeply([ Imager::i_img_tiled_count($im->{IMG}) ], [ 9, 9 ],
+	      "$name: all tiles touched");
+  }
+}
+
+{
+  # samples keep their precision
+  my $im16 = Imager->new(xsize => 10, ysize => 10, tiled => 1, bits => 16,
+			 bg => Imager::Color::Float->new(0.25, 0.5, 0.75, 1.0),
+			 channels => 4);
+  my @samples = map $_ / 65535, 1, 100, 1000, 65534;
+  is($im16->setsamples(y => 1, x => 2, data => \@samples, type => "float"), 4,
+     "set 16-bit samples");
+  my @got = $im16->getsamples(y => 1, x => 2, width => 1, type => "float");
+  is_deeply([ map int($_ * 65535 + 0.5), @got ], [ 1, 100, 1000, 65534 ],
+	    "16-bit samples round trip");
+  is_fcolor4($im16->getpixel(x => 9, y => 9, type => "float"),
+	     0.25, 0.5, 0.75, 1.0, "float background for 16-bit image");
+
+  my $imd = Imager->new(xsize => 10, ysize => 10, tiled => 1,
+			bits => "double");
+  ok($imd->setpixel(x => 3, y => 4,
+		    color => Imager::Color::Float->new(0.1234567, 0, 0)),
+     "set double pixel");
+  my $c = $imd->getpixel(x => 3, y => 4, type => "float");
+  is(($c->rgba)[0], 0.1234567, "double samples round trip exactly");
+  is($imd->bits, "double", "check double bits");
+}
+
+{
+  my $im = Imager->new(xsize => 10, ysize => 10, tiled => 1, channels => 4);
+  image_bounds_checks($im);
+  mask_tests($im, 0.005);
+
+  my $im16 = Imager->new(xsize => 10, ysize => 10, tiled => 1, bits => 16);
+  mask_tests($im16, 1/65535);
+
+  my $imd = Imager->new(xsize => 10, ysize => 10, tiled => 1,
+			bits => "double");
+  mask_tests($imd);
+}
+
+{
+  # errors
+  ok(!Imager->new(xsize => 0, ysize => 10, tiled => 1), "zero width");
+  is(Imager->errstr, "Image sizes must be positive", "check message");
+  ok(!Imager->new(xsize => 10, ysize => 10, tiled => 1, channels => 5),
+     "too many channels");
+  ok(!Imager->new(xsize => 10, ysize => 10, tiled => 1, bits => 12),
+     "bad bits");
+  is(Imager->errstr, "bits must be 8, 16 or $double_bits", "check message");
+  ok(!Imager->new(xsize => 10, ysize => 10, tiled => 1, type => "paletted"),
+     "tiled images are direct");
+  is(Imager->errstr, "new: tiled images must be direct images",
+     "check message");
+  ok(!Imager->new(xsize => 10, ysize => 10, tiled => 1, bg => "nosuchcolor"),
+     "bad background");
+  like(Imager->errstr, qr/^new: bg: /, "check message");
+
+  my $im = Imager->new(xsize => 10, ysize => 10, tiled => 1);
+  Imager::i_clear_error();
+  is_deeply([ Imager::i_gsamp($im->{IMG}, 0, 10, 0, [ 0, 3 ]) ], [],
+	    "bad channel to gsamp");
+  is(Imager->_error_as_msg, "No channel 3 in this image", "check message");
+  is(Imager::i_psamp($im->{IMG}, 0, 5, [ 0, 3 ], [ 0, 0 ]), undef,
+     "bad channel to psamp");
+  is(Imager->_error_as_msg, "No channel 3 in this image", "check message");
+}
+
+{
+  # huge canvases only cost what is drawn
+  my $im = Imager->new(xsize => 100_000, ysize => 100_000, tiled => 1,
+		       channels => 4);
+  ok($im, "make a 100000x100000 image");
+  ok($im->box(filled => 1, color => "#FFF", xmin => 50_000, ymin => 50_000,
+	      xmax => 50_099, ymax => 50_099),
+     "draw on it");
+  my ($allocated, $total) = Imager::i_img_tiled_count($im->{IMG});
+  is($allocated, 4, "only the 4 touched tiles allocated");
+  is($total, 1563 * 1563, "out of many");
+  my $crop = $im->crop(left => 49_990, top => 49_990, width => 120,
+		       height => 120);
+  ok($crop, "crop from the big image");
+  is_color4($crop->getpixel(x => 10, y => 10), 255, 255, 255, 255,
+	    "drawn pixel");
+  is_color4($crop->getpixel(x => 9, y => 9), 0, 0, 0, 0, "background pixel");
+}
+
+done_testing();
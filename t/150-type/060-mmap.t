@@ -0,0 +1,139 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image test_image_16 test_image_double is_image
+                    is_color3 image_bounds_checks);
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/150-type-060-mmap.log");
+
+Imager->new(xsize => 1, ysize => 1, mmap => 1)
+  or plan skip_all => "No memory mapped images: " . Imager->errstr;
+
+my $file = "testout/060-mmap.raw";
+unlink $file;
+
+{
+  # scratch images work like the normal images
+  for my $type ([ 8, test_image() ], [ 16, test_image_16() ],
+		[ "double", test_image_double() ]) {
+    my ($bits, $src) = @$type;
+    my $im = Imager->new(xsize => 150, ysize => 150, bits => $bits,
+			 mmap => 1);
+    ok($im, "$bits: make a scratch image")
+      or diag(Imager->errstr);
+    ok(!$im->virtual, "$bits: not virtual");
+    is($im->bits, $bits, "$bits: check bits");
+    my $plain = Imager->new(xsize => 150, ysize => 150, bits => $bits);
+    for my $work ($im, $plain) {
+      $work->paste(src => $src);
+      $work->box(filled => 1, color => "#FF0", xmin => 20, ymin => 30,
+		 xmax => 90, ymax => 50);
+      $work->filter(type => "gaussian", stddev => 1.5);
+      $work->flip(dir => "h");
+    }
+    is_image($im, $plain, "$bits: same as a normal image");
+  }
+  my $im = Imager->new(xsize => 10, ysize => 10, mmap => 1);
+  image_bounds_checks($im);
+}
+
+{
+  my $im = Imager->new(xsize => 150, ysize => 150, mmap_file => $file);
+  ok($im, "create a file backed image")
+    or diag(Imager->errstr);
+  is(-s $file, 150 * 150 * 3, "file is the size of the image");
+  $im->paste(src => test_image());
+  ok($im->mmap_flush, "flush it");
+  my $raw;
+  ok(test_image()->write(data => \$raw, type => "raw"), "write raw data");
+  ok(slurp($file) eq $raw, "file has the image in raw format");
+
+  my $copy = $im->copy;
+  $copy->box(filled => 1, color => "#FFF");
+  ok($im->mmap_flush, "flush again");
+  ok(slurp($file) eq $raw, "drawing on a copy doesn't touch the file");
+  undef $im;
+
+  my $read = Imager->new(xsize => 150, ysize => 150, mmap_file => $file,
+			 mmap_mode => "read");
+  ok($read, "map the file read only");
+  is_image($read, test_image(), "it has the image");
+  $read->box(filled => 1, color => "#F00");
+  is_color3($read->getpixel(x => 5, y => 5), 255, 0, 0,
+	    "the image can still be drawn on");
+  ok($read->mmap_flush, "flush does nothing");
+  undef $read;
+  ok(slurp($file) eq $raw, "but the file isn't changed");
+
+  my $update = Imager->new(xsize => 150, ysize => 150, mmap_file => $file,
+			   mmap_mode => "update");
+  ok($update, "map the file for update");
+  $update->setpixel(x => 0, y => 0, color => "#0000FF");
+  undef $update;
+  is(substr(slurp($file), 0, 3), "\0\0\xFF", "destroying writes the change");
+}
+
+{
+  # an image after a header
+  open my $fh, ">", $file or die "Cannot create $file: $!";
+  binmode $fh;
+  print $fh "HEADER";
+  close $fh;
+  my $im = Imager->new(xsize => 3000, ysize => 2, channels => 1,
+		       mmap_file => $file, mmap_offset => 6);
+  ok($im, "create at an offset");
+  is(-s $file, 6006, "file extended to fit");
+  $im->box(filled => 1, color => "#808080");
+  ok($im->mmap_flush, "flush");
+  is(slurp($file), "HEADER" . ("\x80" x 6000), "check file contents");
+  undef $im;
+
+  my $im16 = Imager->new(xsize => 10, ysize => 10, bits => 16, channels => 1,
+			 mmap_file => $file, mmap_offset => 6,
+			 mmap_mode => "update");
+  ok($im16, "map part of the file as a 16-bit image");
+  is_deeply([ $im16->getsamples(y => 0, width => 1, type => "16bit") ],
+	    [ 0x8080 ], "check the sample");
+}
+
+{
+  # errors
+  unlink $file;
+  ok(!Imager->new(xsize => 10, ysize => 10, mmap_file => $file,
+		  mmap_mode => "read"), "fail to map a missing file");
+  like(Imager->errstr, qr/^cannot open \Q$file\E: /, "check message");
+  open my $fh, ">", $file or die "Cannot create $file: $!";
+  close $fh;
+  ok(!Imager->new(xsize => 10, ysize => 10, mmap_file => $file,
+		  mmap_mode => "update"), "fail to map a short file");
+  is(Imager->errstr, "file too small for image", "check message");
+  ok(!Imager->new(xsize => 10, ysize => 10, mmap_file => $file,
+		  mmap_mode => "append"), "bad mode");
+  is(Imager->errstr, "unknown value 'append' for mmap_mode",
+     "check message");
+  ok(!Imager->new(xsize => 10, ysize => 10, mmap => 1, bits => 12),
+     "bad bits");
+  ok(!Imager->new(xsize => 10, ysize => 10, mmap => 1, type => "paletted"),
+     "mmap images are direct");
+  is(Imager->errstr, "new: mmap images must be direct images",
+     "check message");
+  my $im = Imager->new(xsize => 10, ysize => 10);
+  ok(!$im->mmap_flush, "can't flush a normal image");
+  is($im->errstr, "mmap_flush: not a memory mapped image", "check message");
+}
+
+unlink $file;
+
+done_testing();
+
+sub slurp {
+  my ($name) = @_;
+
+  open my $fh, "<", $name or die "Cannot open $name: $!";
+  binmode $fh;
+  local $/;
+  return scalar <$fh>;
+}
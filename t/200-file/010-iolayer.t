@@ -973,6 +973,34 @@ SKIP:
   }
 }
 
+{
+  # buffer chain blocks are reused, make sure old data doesn't show
+  # through, and slurp collects every block
+  my $data = pack "C*", map rand(26) + ord("a"), 1 .. 100_000;
+  for my $pass (1 .. 3) {
+    my $io = Imager::IO->new_bufchain;
+    is($io->write($data), length $data, "pass $pass: write");
+    is($io->write("tail"), 4, "pass $pass: write more");
+    ok($io->close == 0, "pass $pass: close");
+    ok(Imager::IO->slurp($io) eq "${data}tail", "pass $pass: slurp");
+    ok(Imager::io_slurp($io) eq "${data}tail", "pass $pass: io_slurp");
+  }
+  {
+    my $io = Imager::IO->new_bufchain;
+    is($io->seek(40_000, SEEK_SET), 40_000, "seek past the end of a new chain");
+    is($io->write("x"), 1, "write");
+    ok($io->close == 0, "close");
+    ok(Imager::IO->slurp($io) eq ("\0" x 40_000) . "x",
+       "the gap is zero filled");
+  }
+  {
+    my $io = Imager::IO->new_bufchain;
+    is($io->write("abc"), 3, "buffered write");
+    is(Imager::IO->slurp($io), "abc", "slurp includes buffered data");
+    is(Imager::IO->slurp(Imager::IO->new_bufchain), "", "slurp empty chain");
+  }
+}
+
 Imager->close_log;
 
 unless ($ENV{IMAGER_KEEP_FILES}) {
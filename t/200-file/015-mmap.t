@@ -0,0 +1,153 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image is_image);
+use IO::Seekable;
+
+# memory mapped file I/O layers
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t015mmap.log");
+
+my $base = pack "C*", map rand(26) + ord("a"), 0 .. 20_001;
+$base .= "\nline two\nline three";
+my $file = "testout/t015mmap.dat";
+{
+  open my $fh, ">", $file or die "Cannot create $file: $!";
+  binmode $fh;
+  print $fh $base;
+  close $fh;
+}
+
+open my $fh, "<", $file or die "Cannot open $file: $!";
+binmode $fh;
+my $test_io = Imager::IO->new_mmap(fileno($fh));
+$test_io
+  or plan skip_all => "memory mapped files not available: " . Imager->_error_as_msg;
+undef $test_io;
+
+{
+  my $io = Imager::IO->new_mmap(fileno($fh));
+  ok($io, "make mmap io");
+  is($io->peekc, ord(substr($base, 0, 1)), "peekc");
+  is($io->getc, ord(substr($base, 0, 1)), "getc");
+  is($io->peekn(20_000), substr($base, 1, 20_000),
+     "peekn more than the buffer size");
+  my $buf;
+  is($io->read($buf, 1000), 1000, "read 1000");
+  is($buf, substr($base, 1, 1000), "check data");
+  is($io->seek(10, SEEK_CUR), 1011, "seek forward");
+  is($io->read2(10), substr($base, 1011, 10), "read2 after seek");
+  is($io->seek(-5, SEEK_CUR), 1016, "seek back");
+  is($io->read2(5), substr($base, 1016, 5), "read2 after seek back");
+  is($io->seek(20_002, SEEK_SET), 20_002, "seek to the lines");
+  is($io->gets, "\n", "gets empty line");
+  is($io->gets, "line two\n", "gets a line");
+  is($io->read($buf, 1000), 10, "short read at end");
+  is($buf, "line three", "check data");
+  ok($io->eof, "at eof");
+  is($io->read($buf, 10), 0, "no more data");
+  is($io->seek(0, SEEK_END), length $base, "seek to end");
+  is($io->seek(-4, SEEK_END), length($base) - 4, "seek from end");
+  is($io->read2(10), "hree", "read after seek from end");
+  is($io->seek(-1, SEEK_SET), -1, "can't seek before start");
+  is($io->seek(length($base) + 10, SEEK_SET), length($base) + 10,
+     "seek past the end is allowed");
+  is($io->read2(10), undef, "but there's nothing to read");
+  is(tell($fh), 0, "file position unchanged by reads");
+}
+
+{
+  # reads larger than the buffer with nothing buffered
+  my $io = Imager::IO->new_mmap(fileno($fh));
+  my $buf;
+  is($io->read($buf, 15_000), 15_000, "read a large chunk");
+  is($buf, substr($base, 0, 15_000), "check data");
+  is($io->read2(10), substr($base, 15_000, 10), "buffered read after");
+}
+
+{
+  # unbuffered
+  my $io = Imager::IO->new_mmap(fileno($fh));
+  is($io->read2(100), substr($base, 0, 100), "buffered read");
+  ok($io->set_buffered(0), "switch to unbuffered");
+  is($io->read2(100), substr($base, 100, 100), "read buffered data");
+  is($io->getc, ord(substr($base, 200, 1)), "getc");
+  is($io->peekc, ord(substr($base, 201, 1)), "peekc");
+  ok($io->set_buffered(1), "back to buffered");
+  is($io->read2(100), substr($base, 201, 100), "buffered read");
+}
+
+{
+  # starts from the current file position
+  seek($fh, 5000, SEEK_SET);
+  my $io = Imager::IO->new_mmap(fileno($fh));
+  is($io->read2(10), substr($base, 5000, 10), "read from the file position");
+  is($io->seek(0, SEEK_CUR), 5010, "position is absolute");
+  seek($fh, 0, SEEK_SET);
+}
+
+{
+  # read only
+  my $io = Imager::IO->new_mmap(fileno($fh));
+  is($io->raw_write("abc"), -1, "raw write fails");
+  $io->write("abc");
+  ok(!$io->flush, "buffered write fails on flush");
+}
+
+{
+  # outlives the file handle
+  open my $fh2, "<", $file or die;
+  my $io = Imager::IO->new_mmap(fileno($fh2));
+  close $fh2;
+  is($io->read2(10), substr($base, 0, 10), "read after closing handle");
+}
+
+{
+  # things that can't be mapped
+  my $empty = "testout/t015empty.dat";
+  open my $efh, ">", $empty or die;
+  close $efh;
+  open $efh, "<", $empty or die;
+  ok(!Imager::IO->new_mmap(fileno($efh)), "can't map an empty file");
+  like(Imager->_error_as_msg, qr/empty/, "check message");
+  close $efh;
+  unlink $empty;
+
+  SKIP:
+  {
+    my $pipe;
+    pipe($pipe, my $write)
+      or skip "no pipe", 2;
+    ok(!Imager::IO->new_mmap(fileno($pipe)), "can't map a pipe");
+    like(Imager->_error_as_msg, qr/regular files/, "check message");
+  }
+}
+
+{
+  # images read through files use the map when asked
+  my $im = test_image();
+  for my $type (qw(pnm bmp tga raw)) {
+    my $name = "testout/t015mmap.$type";
+    my %extra = $type eq "raw" ? ( xsize => $im->getwidth,
+				   ysize => $im->getheight,
+				   raw_interleave => 0 ) : ();
+    ok($im->write(file => $name, type => $type), "$type: write")
+      or diag($im->errstr);
+    my $mapped = Imager->new(file => $name, type => $type, mmap => 1, %extra);
+    ok($mapped, "$type: read mapped")
+      or diag(Imager->errstr);
+    my $plain = Imager->new(file => $name, type => $type, %extra);
+    ok($plain, "$type: read without mapping")
+      or diag(Imager->errstr);
+    is_image($mapped, $plain, "$type: same result");
+    unlink $name unless $ENV{IMAGER_KEEP_FILES};
+  }
+}
+
+close $fh;
+unlink $file;
+
+done_testing();
@@ -0,0 +1,163 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image is_image);
+use IO::Seekable;
+
+# I/O layer buffer sizes
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t020iobuffer.log");
+
+my $base = pack "C*", map rand(26) + ord("a"), 0 .. 200_000;
+
+# a read callback that records the size of each request
+sub reader {
+  my ($data, $ops) = @_;
+  my $pos = 0;
+  return
+    (
+     sub {
+       my ($size) = @_;
+       my $result = substr($$data, $pos, $size);
+       $pos += length $result;
+       push @$ops, $size;
+       return $result;
+     },
+     sub {
+       my ($offset, $whence) = @_;
+       $pos = $whence == SEEK_SET ? $offset
+	 : $whence == SEEK_CUR ? $pos + $offset
+	   : length($$data) + $offset;
+       return $pos;
+     },
+    );
+}
+
+is_deeply([ Imager->get_io_buffer_size ], [ 8192, 8192 ],
+	  "default context buffer sizes");
+
+{
+  my $io = Imager::io_new_bufchain();
+  is_deeply([ $io->buffer_size ], [ 8192, 8192 ], "new io gets the default");
+  ok($io->set_buffer_size(1024), "set a fixed size");
+  is_deeply([ $io->buffer_size ], [ 1024, 1024 ], "check it");
+  ok($io->set_buffer_size(1024, 4096), "set an adaptive size");
+  is_deeply([ $io->buffer_size ], [ 1024, 4096 ], "check it");
+
+  ok(!$io->set_buffer_size(100), "too small");
+  like(Imager->_error_as_msg, qr/buffer size must be from 256/,
+       "check message");
+  ok(!$io->set_buffer_size(1024, 512), "max smaller than size");
+  like(Imager->_error_as_msg, qr/maximum buffer size must be/,
+       "check message");
+  ok(!$io->set_buffer_size(0x8000000), "too large");
+}
+
+{
+  # fixed size read buffer
+  my @ops;
+  my $io = Imager::IO->new_cb(undef, reader(\$base, \@ops), undef);
+  ok($io->set_buffer_size(1024), "set buffer size");
+  is($io->read2(100), substr($base, 0, 100), "read");
+  is_deeply(\@ops, [ 1024 ], "read the new buffer size");
+  ok(!$io->set_buffer_size(2048), "can't resize with data buffered");
+  like(Imager->_error_as_msg, qr/data buffered/, "check message");
+  is($io->read2(924), substr($base, 100, 924), "read the rest of the buffer");
+  ok($io->set_buffer_size(2048), "can resize with the buffer consumed");
+  is($io->read2(100), substr($base, 1024, 100), "read");
+  is_deeply(\@ops, [ 1024, 2048 ], "read the new buffer size");
+}
+
+{
+  # adaptive read buffer
+  my @ops;
+  my $io = Imager::IO->new_cb(undef, reader(\$base, \@ops), undef);
+  ok($io->set_buffer_size(1024, 8192), "set adaptive buffer size");
+  my $read = "";
+  while (defined(my $byte = $io->read2(100))) {
+    $read .= $byte;
+  }
+  is($read, $base, "read all of the data");
+  is_deeply([ @ops[0 .. 14] ],
+	    [ (1024) x 3, (2048) x 4, (4096) x 4, (8192) x 4 ],
+	    "buffer grew during the sequential read");
+  is_deeply([ $io->buffer_size ], [ 8192, 8192 ], "grown to the maximum");
+}
+
+{
+  # seeks restart the count
+  my @ops;
+  my $io = Imager::IO->new_cb(undef, reader(\$base, \@ops), undef);
+  ok($io->set_buffer_size(1024, 8192), "set adaptive buffer size");
+  for my $pos (0, 2000, 4000, 6000, 8000, 10000) {
+    $io->seek($pos, SEEK_SET);
+    $io->read2(10);
+  }
+  is_deeply(\@ops, [ (1024) x 6 ], "no growth for seek and read");
+}
+
+{
+  # adaptive write buffer
+  my @writes;
+  my $io = Imager::io_new_cb(sub { push @writes, length $_[0]; 1 },
+			     undef, undef, undef);
+  ok($io->set_buffer_size(1024, 4096), "set adaptive buffer size");
+  for (1 .. 200) {
+    $io->write("x" x 100);
+  }
+  ok($io->close == 0, "close");
+  my $total = 0;
+  $total += $_ for @writes;
+  is($total, 20_000, "all of the data written");
+  cmp_ok(scalar(@writes), '<', 12, "fewer writes than a fixed buffer");
+  is_deeply([ $io->buffer_size ], [ 4096, 4096 ], "grown to the maximum");
+}
+
+{
+  # context default
+  ok(Imager->set_io_buffer_size(size => 4096, max_size => 65536),
+     "set the default");
+  is_deeply([ Imager->get_io_buffer_size ], [ 4096, 65536 ], "check it");
+  my $io = Imager::io_new_bufchain();
+  is_deeply([ $io->buffer_size ], [ 4096, 65536 ], "new io gets it");
+  ok(Imager->set_io_buffer_size(size => 8192), "restore the default");
+  is_deeply([ Imager->get_io_buffer_size ], [ 8192, 8192 ], "check it");
+
+  ok(!Imager->set_io_buffer_size(size => 10), "too small");
+  like(Imager->errstr, qr/buffer size must be from/, "check message");
+  ok(!Imager->set_io_buffer_size(), "missing size");
+  like(Imager->errstr, qr/size must be a positive integer/, "check message");
+}
+
+{
+  # read and write parameters
+  my $im = test_image();
+  my $data;
+  my @writes;
+  ok($im->write(type => "bmp",
+		callback => sub { $data .= $_[0]; push @writes, length $_[0]; 1 },
+		buffer_size => 1024),
+     "write with a small buffer");
+  cmp_ok($writes[0], '<=', 1024, "used the small buffer");
+
+  my @ops;
+  my ($readcb, $seekcb) = reader(\$data, \@ops);
+  my $back = Imager->new(type => "bmp", callback => $readcb,
+			 seekcb => $seekcb, buffer_size => 512,
+			 max_buffer_size => 65536);
+  ok($back, "read with an adaptive buffer")
+    or diag(Imager->errstr);
+  is_image($back, $im, "check the image");
+  is($ops[0], 512, "started with the small buffer");
+  cmp_ok($ops[-1], '>', 512, "and grew");
+
+  ok(!Imager->new(type => "bmp", callback => $readcb, seekcb => $seekcb,
+		  buffer_size => 1),
+     "invalid buffer size fails");
+  like(Imager->errstr, qr/buffer size must be/, "check message");
+}
+
+done_testing();
@@ -0,0 +1,124 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image test_image_16 is_image);
+
+# vectored writes
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t025writev.log");
+
+my $big = pack "C*", map rand(26) + ord("a"), 1 .. 100_000;
+
+{
+  my $io = Imager::io_new_bufchain();
+  is($io->writev("abc", "", "def"), 6, "small writev");
+  is($io->write("ghi"), 3, "plain write");
+  is($io->writev($big, "jkl"), 100_003, "large writev");
+  is($io->writev(), 0, "empty writev");
+  ok($io->close == 0, "close");
+  is(Imager::io_slurp($io), "abcdefghi${big}jkl", "check data");
+}
+
+{
+  # large blocks go straight to the callback, after buffered data
+  my @writes;
+  my $data = "";
+  my $io = Imager::IO->new_cb(sub { $data .= $_[0]; push @writes, length $_[0]; 1 },
+			      undef, undef, undef);
+  is($io->write("abc"), 3, "buffered write");
+  is($io->writev("de", $big), 100_002, "large writev");
+  is_deeply(\@writes, [ 5, 100_000 ], "buffered data then the block");
+  is($io->writev("fg"), 2, "small writev is buffered");
+  is_deeply(\@writes, [ 5, 100_000 ], "nothing written yet");
+  ok($io->close == 0, "close");
+  is($data, "abcde${big}fg", "check data");
+}
+
+{
+  # file descriptors
+  my $file = "testout/t025writev.dat";
+  open my $fh, ">", $file or die "Cannot create $file: $!";
+  binmode $fh;
+  my $io = Imager::io_new_fd(fileno($fh));
+  is($io->write("head"), 4, "buffered write");
+  is($io->writev(($big) x 40, "tail"), 4_000_004, "many large blocks");
+  ok($io->close == 0, "close");
+  close $fh;
+  open $fh, "<", $file or die;
+  binmode $fh;
+  my $read = do { local $/; <$fh> };
+  close $fh;
+  ok($read eq "head" . ($big x 40) . "tail", "check file content");
+  unlink $file;
+}
+
+{
+  # unbuffered
+  my $io = Imager::io_new_bufchain();
+  ok($io->set_buffered(0), "unbuffered");
+  is($io->writev("abc", "def"), 6, "writev");
+  is(Imager::io_slurp($io), "abcdef", "check data");
+}
+
+{
+  # errors
+  my $io = Imager::io_new_buffer("abcdef");
+  is($io->read2(2), "ab", "read");
+  is($io->writev("x"), -1, "can't writev while reading");
+
+  my $fail = Imager::IO->new_cb(sub { 0 }, undef, undef, undef);
+  is($fail->writev($big), -1, "failed callback write");
+  ok($fail->error, "error is set");
+  is($fail->writev("x"), -1, "later writes fail");
+}
+
+{
+  # writers produce the same output to each kind of layer
+  my $im = test_image()->scale(scalefactor => 4);
+  my $pal = $im->to_paletted;
+  my $mono = Imager->new(xsize => 700, ysize => 500, type => "paletted");
+  $mono->addcolors(colors => [ "#000", "#FFF" ]);
+  $mono->box(filled => 1, color => "#FFF", xmax => 300);
+  my $wide = test_image_16()->scale(scalefactor => 4);
+  $wide->settag(name => "pnm_write_wide_data", value => 1);
+  my $file = "testout/t025writev.img";
+  for my $case ([ rgb => $im ], [ alpha => $im->convert(preset => "addalpha") ],
+		[ pal => $pal ], [ mono => $mono ], [ wide => $wide ],
+		[ crop => $im->crop(left => 1, width => 301) ]) {
+    my ($name, $work) = @$case;
+    for my $type (qw(pnm bmp raw)) {
+      my $data;
+      ok($work->write(data => \$data, type => $type),
+	 "$name/$type: write to data")
+	or diag($work->errstr);
+      my $cb = "";
+      my $count = 0;
+      ok($work->write(callback => sub { $cb .= $_[0]; ++$count; 1 },
+		      type => $type),
+	 "$name/$type: write to callback")
+	or diag($work->errstr);
+      ok($cb eq $data, "$name/$type: same as data");
+      cmp_ok($count, '<', 20, "$name/$type: in few large writes");
+      ok($work->write(file => $file, type => $type),
+	 "$name/$type: write to file")
+	or diag($work->errstr);
+      open my $fh, "<", $file or die;
+      binmode $fh;
+      my $read = do { local $/; <$fh> };
+      close $fh;
+      ok($read eq $data, "$name/$type: file same as data");
+      unlink $file;
+    }
+  }
+
+  my $data;
+  ok($im->write(data => \$data, type => "pnm"), "write ppm");
+  is_image(Imager->new(data => $data), $im, "and it reads back");
+  ok($pal->write(data => \$data, type => "bmp"), "write paletted bmp");
+  is_image(Imager->new(data => $data), $pal, "and it reads back");
+}
+
+done_testing();
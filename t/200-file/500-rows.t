@@ -0,0 +1,163 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::RowSource;
+use Imager::Test qw(test_image test_image_16 is_image);
+
+# streaming row sources and sinks
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t500rows.log");
+
+my $src_im = test_image();
+my $ppm;
+ok($src_im->write(data => \$ppm, type => "pnm"), "write source ppm");
+
+{
+  my $src = Imager->read_rows(data => $ppm);
+  ok($src, "read_rows from ppm data")
+    or diag(Imager->errstr);
+  is($src->getwidth, $src_im->getwidth, "check width");
+  is($src->getheight, $src_im->getheight, "check height");
+  is($src->getchannels, 3, "check channels");
+  my $im = $src->image;
+  ok($im, "read rows into an image");
+  is_image($im, $src_im, "matches the source");
+}
+
+for my $file (qw(penguin-base.ppm maxval_4095_asc.ppm simple.pbm)) {
+  my $whole = Imager->new(file => "testimg/$file");
+  ok($whole, "$file: read whole image")
+    or diag(Imager->errstr);
+  my $src = Imager->read_rows(file => "testimg/$file");
+  ok($src, "$file: read_rows")
+    or diag(Imager->errstr);
+  my $im = $src->image;
+  is_image($im, $whole->to_rgb8->convert(preset => "noalpha"),
+	   "$file: rows match whole image");
+}
+
+{
+  # write rows, output is the same as the whole image writer
+  my $data;
+  my $src = Imager::RowSource->new(image => $src_im);
+  ok($src, "source from an image");
+  ok($src->write(data => \$data, type => "pnm"), "write rows as pnm")
+    or diag(Imager->errstr);
+  is($data, $ppm, "same as the whole image writer");
+}
+
+{
+  # alpha is dropped against black, like the pnm writer
+  my $rgba = test_image()->convert(preset => "addalpha");
+  $rgba->box(filled => 1, xmax => 20, color => [ 255, 0, 0, 128 ]);
+  my $whole;
+  ok($rgba->write(data => \$whole, type => "pnm"), "write rgba as pnm");
+  my $rows;
+  ok(Imager::RowSource->new(image => $rgba)->write(data => \$rows,
+						     type => "pnm"),
+     "write rgba rows as pnm");
+  is($rows, $whole, "same as the whole image writer");
+}
+
+{
+  # scaling matches mixing scale
+  my $rgba = test_image()->convert(preset => "addalpha");
+  $rgba->box(filled => 1, xmax => 40, color => [ 0, 0, 255, 64 ]);
+  for my $case ([ 0.3, 0.3 ], [ 0.5, 0.25 ], [ 3.1, 3.1 ], [ 1, 1 ]) {
+    my ($xs, $ys) = @$case;
+    my $src = Imager::RowSource->new(image => $rgba);
+    my $scaled = $src->scale(xscalefactor => $xs, yscalefactor => $ys);
+    ok($scaled, "scale $xs x $ys")
+      or diag(Imager->errstr);
+    my $expect = $rgba->scale(xscalefactor => $xs, yscalefactor => $ys,
+			      qtype => "mixing");
+    is($scaled->getwidth, $expect->getwidth, "$xs x $ys: width");
+    is($scaled->getheight, $expect->getheight, "$xs x $ys: height");
+    is_image($scaled->image, $expect, "$xs x $ys: matches mixing scale");
+  }
+}
+
+{
+  # convert, stacked on scale
+  my $src = Imager->read_rows(data => $ppm);
+  my $gray = $src->scale(scalefactor => 0.5)->convert(preset => "gray");
+  ok($gray, "scale then convert")
+    or diag(Imager->errstr);
+  is($gray->getchannels, 1, "one channel result");
+  my $expect = $src_im->scale(scalefactor => 0.5, qtype => "mixing")
+    ->convert(preset => "gray");
+  is_image($gray->image, $expect, "matches whole image operations");
+
+  my $matrix = Imager::RowSource->new(image => $src_im)
+    ->convert(matrix => [ [ 0, 0, 1 ], [ 0, 1, 0 ], [ 1, 0, 0 ] ]);
+  ok($matrix, "convert with a matrix");
+  is_image($matrix->image,
+	   $src_im->convert(matrix => [ [ 0, 0, 1 ], [ 0, 1, 0 ], [ 1, 0, 0 ] ]),
+	   "matrix convert matches");
+}
+
+{
+  # higher bit depths are reduced to 8 bits
+  my $im16 = test_image_16();
+  my $src = Imager::RowSource->new(image => $im16);
+  is_image($src->image, $im16->to_rgb8, "16-bit image read as 8-bit rows");
+}
+
+{
+  # errors
+  ok(!Imager->read_rows(file => "testimg/penguin-base.ppm", type => "tga"),
+     "fail to read rows from an unsupported format");
+  like(Imager->errstr, qr/format 'tga' can't be read as rows/,
+       "check message");
+
+  ok(!Imager->read_rows(data => "P6\n10 x\n255\n" . ("\0" x 300),
+			type => "pnm"),
+     "fail on bad header");
+  ok(Imager->errstr, "got a message");
+
+  {
+    my $short = Imager->read_rows(data => substr($ppm, 0, length($ppm) / 2));
+    ok($short, "truncated image opens");
+    ok(!$short->image, "but fails to read");
+    like(Imager->errstr, qr/short read|unexpected end/i, "check message");
+  }
+
+  my $src = Imager::RowSource->new(image => $src_im);
+  ok(!$src->write(data => \my $data, type => "tga"),
+     "fail to write rows to an unsupported format");
+  like(Imager->errstr, qr/format 'tga' can't be written as rows/,
+       "check message");
+
+  {
+    # partly read
+    my $part = Imager::RowSource->new(image => $src_im);
+    my $raw = $part->{SRC};
+    my $io = Imager::io_new_bufchain();
+    my $sink = Imager::i_writepnm_rows_wiol($io, $src_im->getwidth, 5, 3);
+    ok(!Imager::i_rows_copy($raw, $sink), "copy to a too short sink fails");
+    like(Imager->_error_as_msg, qr/rows left but sink expects/,
+	 "check message");
+  }
+
+  ok(!Imager::RowSource->new(image => Imager->new),
+     "can't make a source from an empty image");
+  ok(!Imager::RowSource->new, "or no image");
+}
+
+{
+  # partly read sources can't be scaled
+  my $raw = Imager::i_row_source_img($src_im->{IMG});
+  my $io = Imager::io_new_bufchain();
+  my $sink = Imager::i_writepnm_rows_wiol($io, $src_im->getwidth,
+					  $src_im->getheight, 3);
+  ok(Imager::i_rows_copy($raw, $sink), "read all the rows");
+  my $done = Imager::RowSource->_new($raw);
+  ok(!$done->scale(scalefactor => 0.5), "can't scale a read source");
+  like(Imager->errstr, qr/already been read/, "check message");
+  ok(!$done->convert(preset => "gray"), "can't convert a read source");
+}
+
+done_testing();
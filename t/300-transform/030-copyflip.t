@@ -1,8 +1,8 @@
 #!perl -w
 use strict;
-use Test::More tests => 95;
+use Test::More tests => 197;
 use Imager;
-use Imager::Test qw(is_color3 is_image is_imaged test_image_double test_image isnt_image is_image_similar);
+use Imager::Test qw(is_color3 is_image is_imaged test_image_double test_image isnt_image is_image_similar test_image_16);
 
 #$Imager::DEBUG=1;
 
@@ -277,9 +277,124 @@ sub rot_test {
   # $diff->write(file => "testout/t64rotdiff.png");
 }
 
+{
+  # images stored in memory are rotated and flipped directly, compare
+  # against the same operation through a masked image, which uses the
+  # line accessors
+  my $im = test_image()->crop(width => 149, height => 131);
+  my @images =
+    (
+     [ rgb => $im ],
+     [ rgba => $im->convert(preset => "addalpha") ],
+     [ grey => $im->convert(preset => "grey") ],
+     [ "16-bit" => test_image_16()->crop(width => 77, height => 149) ],
+     [ double => test_image_double()->crop(width => 149, height => 77) ],
+     [ paletted => $im->to_paletted ],
+    );
+  for my $image (@images) {
+    my ($name, $src) = @$image;
+    my $masked = $src->copy->masked;
+    for my $right (90, 180, 270) {
+      is_imaged($src->rotate(right => $right), $masked->rotate(right => $right),
+		0, "$name: rotate $right");
+    }
+    for my $dir (qw(h v vh)) {
+      my $direct = $src->copy;
+      ok($direct->flip(dir => $dir), "$name: flip $dir");
+      my $work = $src->copy;
+      $work->masked->flip(dir => $dir);
+      is_imaged($direct, $work, 0, "$name: flip $dir matches");
+    }
+  }
+
+  # this used to skip the middle row
+  my $pal = $im->to_paletted;
+  $pal->flip(dir => "vh");
+  is_image($pal, $im->to_paletted->rotate(right => 180),
+	   "paletted flip vh with odd height matches rotate 180");
+}
+
+{
+  # 8-bit images are sampled in fixed point, the result should be
+  # within one sample of the floating point sampler
+  my $im = test_image();
+  my @cases =
+    (
+     [ rgb => $im, degrees => 10 ],
+     [ rgba => $im->convert(preset => "addalpha"), degrees => 30,
+       back => "#FF000080" ],
+     [ grey => $im->convert(preset => "grey"), degrees => 45 ],
+    );
+  for my $case (@cases) {
+    my ($name, $src, @opts) = @$case;
+    my $fixed = $src->rotate(@opts);
+    my $float = $src->to_rgb_double->rotate(@opts)->to_rgb8;
+    is_imaged($fixed, $float, 1.01 / 255, "$name: fixed point close to float");
+  }
+  my $matrix = [ 1, 0.1, 0, 0, 1, 0, 0.001, 0.0005, 1 ];
+  is_imaged($im->matrix_transform(matrix => $matrix),
+	    $im->to_rgb_double->matrix_transform(matrix => $matrix)->to_rgb8,
+	    1.01 / 255, "perspective: fixed point close to float");
+}
+
 {
   my $empty = Imager->new;
   ok(!$empty->rotate(degrees => 90), "can't rotate an empty image");
   is($empty->errstr, "rotate: empty input image",
      "check error message");
 }
+
+{
+  # copies share storage until written to
+  my @types =
+    (
+     [ "8-bit", test_image() ],
+     [ "16-bit", test_image_16() ],
+     [ "double", test_image_double() ],
+     [ "paletted", test_image()->to_paletted ],
+     [ "tiled", Imager->new(xsize => 150, ysize => 150, tiled => 1) ],
+    );
+  $types[-1][1]->paste(src => test_image());
+  for my $type (@types) {
+    my ($name, $src) = @$type;
+    my $ref = $src->crop(left => 0, top => 0); # an unshared copy
+    my $copy = $src->copy;
+    $copy->setpixel(x => 10, y => 10, color => "#FF00FF");
+    is_image($src, $ref, "$name: writing to the copy leaves the source");
+    is_color3($copy->getpixel(x => 10, y => 10), 255, 0, 255,
+	      "$name: copy was written");
+
+    my $copy2 = $src->copy;
+    $src->box(filled => 1, color => "#00FF00", xmin => 20, ymin => 20,
+	      xmax => 29, ymax => 29);
+    is_image($copy2, $ref, "$name: writing to the source leaves the copy");
+    is_color3($src->getpixel(x => 25, y => 25), 0, 255, 0,
+	      "$name: source was written");
+    undef $src;
+    undef $type->[1];
+    is_image($copy2, $ref, "$name: copy survives the source");
+
+    my $work = $copy2->copy;
+    $work->flip(dir => "hv");
+    is_image($copy2, $ref, "$name: flip on a copy leaves the original");
+    $work = $copy2->copy;
+    ok($work->filter(type => "gaussian", stddev => 2),
+       "$name: blur a copy");
+    is_image($copy2, $ref, "$name: blur on a copy leaves the original");
+  }
+
+}
+
+{
+  my $tiled = Imager->new(xsize => 150, ysize => 150, tiled => 1);
+  $tiled->box(filled => 1, color => "#FFF", xmin => 0, ymin => 0,
+	      xmax => 70, ymax => 10);
+  my $copy = $tiled->copy;
+  is_deeply([ Imager::i_img_tiled_count($copy->{IMG}) ], [ 2, 9 ],
+	    "tiled: copy references the written tiles");
+  $copy->setpixel(x => 100, y => 100, color => "#F00");
+  is_deeply([ Imager::i_img_tiled_count($tiled->{IMG}) ], [ 2, 9 ],
+	    "tiled: writing a new tile to the copy doesn't touch the source");
+  is_color3($tiled->getpixel(x => 100, y => 100), 0, 0, 0,
+	    "tiled: source still background");
+}
@@ -2,11 +2,11 @@
 use strict;
 use Test::More;
 use Imager;
+use Imager::Test qw(test_image is_image);
 
-eval "use Affix::Infix2Postfix; 1;"
-  or plan skip_all => "No Affix::Infix2Postfix";
+my $have_i2p = eval "use Affix::Infix2Postfix; 1;";
 
-plan tests => 8;
+plan tests => 14;
 
 #$Imager::DEBUG=1;
 
@@ -18,6 +18,8 @@ my $img=Imager->new();
 
 SKIP:
 {
+  $have_i2p
+    or skip("No Affix::Infix2Postfix", 6);
   ok($img, "make image object")
     or skip("can't make image object", 5);
 
@@ -54,3 +56,48 @@ SKIP:
   is($empty->errstr, "transform: empty input image",
      "check error message");
 }
+
+{
+  # opcodes are evaluated for a row at a time, check against the
+  # pixel by pixel result
+  my $im = test_image();
+  my $pal = $im->to_paletted;
+  my @cases =
+    (
+     [ shift => [ qw(x) ], [ qw(y Parm 2 Add) ], [ 0, 0, 10 ],
+       sub { $_[0], $_[1] + 10 } ],
+     [ wave => [ qw(x Parm 2 y Parm 3 Div sin Mult Add) ],
+       [ qw(y Parm 2 x y Add Parm 3 Div cos Mult Add) ], [ 0, 0, 10, 20 ],
+       sub { $_[0] + 10 * sin($_[1] / 20),
+	       $_[1] + 10 * cos(($_[0] + $_[1]) / 20) } ],
+     [ transpose => [ qw(y) ], [ qw(x) ], [ 0, 0 ],
+       sub { $_[1], $_[0] } ],
+     [ stretch => [ qw(x Parm 2 Div) ], [ qw(y Parm 2 Sub) ], [ 0, 0, 0.3 ],
+       sub { $_[0] / 0.3, $_[1] - 0.3 } ],
+    );
+  for my $case (@cases) {
+    my ($name, $xops, $yops, $parm, $func) = @$case;
+    my $out = $im->transform(xopcodes => $xops, yopcodes => $yops,
+			     parm => $parm);
+    my $check = Imager->new(xsize => $im->getwidth, ysize => $im->getheight);
+    for my $y (0 .. $im->getheight - 1) {
+      for my $x (0 .. $im->getwidth - 1) {
+	my ($sx, $sy) = map int, $func->($x, $y);
+	my $color = $im->getpixel(x => $sx, y => $sy) || "#000";
+	$check->setpixel(x => $x, y => $y, color => $color);
+      }
+    }
+    is_image($out, $check, "$name: matches pixel by pixel transform");
+  }
+
+  my $out = $pal->transform(xopcodes => [ qw(y) ], yopcodes => [ qw(x) ],
+			    parm => [ 0, 0 ]);
+  my $rgb = $pal->to_rgb8->transform(xopcodes => [ qw(y) ],
+				     yopcodes => [ qw(x) ], parm => [ 0, 0 ]);
+  is_image($out, $rgb, "paletted source");
+
+  my $empty = Imager->new;
+  ok(!$empty->transform(xopcodes => [ qw(x) ], yopcodes => [ qw(y) ],
+			parm => [ 0, 0 ]),
+     "fail to transform an empty image with opcodes");
+}
@@ -1,6 +1,6 @@
 #!perl -w
 use strict;
-use Test::More tests => 40;
+use Test::More tests => 54;
 BEGIN { use_ok('Imager'); }
 use Imager::Test qw(is_color3);
 
@@ -153,6 +153,73 @@ EOS
      "check error message");
 }
 
+{
+  # the compiler checks the program
+  use Imager::Regops;
+  my $pack = $Imager::Regops::PackCode x 6;
+  my $ret = pack($pack, RBC_RET, 0, 0, 0, 0, 0);
+  ok(!Imager::i_transform2(2, 2, 3, pack($pack, RBC_ADD, 0, 100, 0, 0, 2) . $ret,
+			   [ 0, 0, 0 ], [ undef ], []),
+     "register out of range");
+  like(Imager->_error_as_msg, qr/operand 100 out of range/, "check message");
+  ok(!Imager::i_transform2(2, 2, 3, pack($pack, 1000, 0, 0, 0, 0, 0) . $ret,
+			   [ 0, 0 ], [ undef ], []),
+     "bad opcode");
+  like(Imager->_error_as_msg, qr/bad opcode 1000/, "check message");
+  ok(!Imager::i_transform2(2, 2, 3, pack($pack, RBC_JUMP, 5, 0, 0, 0, 0) . $ret,
+			   [ 0, 0 ], [ undef ], []),
+     "jump out of range");
+  ok(!Imager::i_transform2(2, 2, 3, pack($pack, RBC_RGB, 0, 0, 0, 0, 3) . $ret,
+			   [ 0, 0 ], [ undef ], []),
+     "output register out of range");
+}
+
+{
+  # constant folding and dead code
+  my $out = Imager::transform2({ rpnexpr => <<'EOS', width => 20, height => 10 });
+3 4 * 1 + !a x y + !unused @a 10 * x 10 * @a 13 / 255 * rgb
+EOS
+  ok($out, "folded constants")
+    or diag(Imager->errstr);
+  is_color3($out->getpixel(x => 5, y => 3), 130, 50, 255, "check result");
+
+  my $code = <<'EOS';
+var count:n ; var work:n ; var c:p
+count = 0
+work = mult 2 3
+loop:
+count = add count 1
+work = lt count x
+jumpnz work loop
+work = mult count 10
+c = rgb work y work
+ret c
+EOS
+  my $jumps = Imager::transform2({ assem => $code, width => 20, height => 5 });
+  ok($jumps, "program with a loop")
+    or diag(Imager->errstr);
+  is_color3($jumps->getpixel(x => 7, y => 3), 70, 3, 70, "check loop result");
+  is_color3($jumps->getpixel(x => 0, y => 1), 10, 1, 10, "loop runs once");
+
+  # registers keep their values between pixels, so a constant read
+  # before it's written can't be folded
+  my $early = Imager::transform2({ assem => <<'EOS', width => 2, height => 1 });
+var late:n ; var early:n ; var c:p
+early = add late 0
+late = mult 2 3
+c = rgb early late early
+jump done
+done:
+ret c
+EOS
+  ok($early, "read before constant write")
+    or diag(Imager->errstr);
+  is_color3($early->getpixel(x => 0, y => 0), 0, 6, 0,
+	    "first pixel sees the initial value");
+  is_color3($early->getpixel(x => 1, y => 0), 6, 6, 6,
+	    "later pixels see the written value");
+}
+
 use Imager::Transform;
 
 # some simple tests
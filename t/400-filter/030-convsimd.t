@@ -0,0 +1,88 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image test_image_double is_image is_imaged);
+
+# compare the vector convolution kernels against the scalar kernels
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t400convsimd.log");
+
+my $best = Imager::i_int_conv_kernels_name();
+note "best kernels: $best";
+
+Imager::i_int_simd_set_limit(0);
+is(Imager::i_int_conv_kernels_name(), "scalar", "limit to scalar kernels");
+Imager::i_int_simd_set_limit(2);
+is(Imager::i_int_conv_kernels_name(), $best, "and back to the best");
+
+my @filters =
+  (
+   [ conv => { type => "conv", coef => [ 0.3, 1, 0.3 ] } ],
+   [ sharpen => { type => "conv", coef => [ -0.5, 2, -0.5 ] } ],
+   [ wide => { type => "conv", coef => [ (1) x 101 ] } ],
+   [ gaussian => { type => "gaussian", stddev => 3 } ],
+   [ bigblur => { type => "gaussian", stddev => 40 } ],
+   [ gaussian2 => { type => "gaussian2", stddevX => 1.5, stddevY => 5 } ],
+  );
+
+my $rgba = test_image()->convert(preset => "addalpha");
+$rgba->box(filled => 1, color => [ 0, 0, 0, 0 ], xmin => 20, xmax => 50);
+my @images =
+  (
+   [ rgb => test_image() ],
+   [ rgba => $rgba ],
+   # odd width so the vector kernels have samples left over
+   [ narrow => test_image()->crop(right => 13) ],
+   [ double => test_image_double() ],
+  );
+
+for my $image (@images) {
+  my ($im_name, $im) = @$image;
+  for my $filter (@filters) {
+    my ($name, $opts) = @$filter;
+    my %scalar;
+    my @levels = ( [ scalar => 0 ], [ sse2 => 1 ], [ avx2 => 2 ] );
+    my %results;
+    for my $level (@levels) {
+      my ($level_name, $limit) = @$level;
+      Imager::i_int_simd_set_limit($limit);
+      Imager::i_int_conv_kernels_name() eq $level_name
+	or next;
+      $results{$level_name} = $im->copy->filter(%$opts)
+	or diag("$im_name $name $level_name: ", Imager->errstr);
+    }
+    Imager::i_int_simd_set_limit(2);
+    for my $level_name (grep $_ ne "scalar", sort keys %results) {
+      if ($im->bits eq "double") {
+	is_imaged($results{$level_name}, $results{scalar}, 0,
+		  "$im_name $name: $level_name matches scalar exactly");
+      }
+      else {
+	# the 8-bit vector kernels work in single precision and may
+	# round differently by one
+	is_imaged($results{$level_name}, $results{scalar}, 1.01 / 255,
+		  "$im_name $name: $level_name close to scalar");
+      }
+    }
+  }
+}
+
+{
+  # the direct scalar path matches the generic per-pixel code, which
+  # is used for masked images
+  Imager::i_int_simd_set_limit(0);
+  for my $filter (@filters) {
+    my ($name, $opts) = @$filter;
+    my $direct = test_image()->filter(%$opts);
+    my $generic = test_image();
+    my $mask = $generic->masked;
+    $mask->filter(%$opts);
+    is_image($direct, $generic, "$name: direct matches per-pixel");
+  }
+  Imager::i_int_simd_set_limit(2);
+}
+
+done_testing();
@@ -0,0 +1,129 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image is_image is_imaged);
+
+# the box approximation to the gaussian blur, compared against the
+# exact filter
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t400gaussbox.log");
+
+my $sharp = Imager->new(xsize => 300, ysize => 300, bits => "double");
+$sharp->paste(src => test_image()->scale(scalefactor => 2.5));
+my $noise = Imager->new(xsize => 300, ysize => 300, bits => "double");
+$noise->filter(type => "noise", amount => 255, subtype => 1);
+
+for my $case ([ sharp => $sharp ], [ noise => $noise ]) {
+  my ($name, $im) = @$case;
+  for my $stddev (3, 5, 10, 20) {
+    my $exact = $im->copy;
+    ok($exact->filter(type => "gaussian", stddev => $stddev),
+       "$name $stddev: exact");
+    my $box = $im->copy;
+    ok($box->filter(type => "gaussian", stddev => $stddev, method => "box"),
+       "$name $stddev: box");
+
+    # documented limits
+    is_imaged($box, $exact, 10/255, "$name $stddev: within 10/255");
+    my $border = 3 * $stddev;
+    my %inner =
+      (
+       left => $border,
+       top => $border,
+       right => $im->getwidth - $border,
+       bottom => $im->getheight - $border,
+      );
+    is_imaged($box->crop(%inner), $exact->crop(%inner), 5/255,
+	      "$name $stddev: within 5/255 away from the edges");
+  }
+}
+
+{
+  # 8-bit images, where the exact filter trims the curve at 2 * stddev
+  my $sharp8 = test_image()->scale(scalefactor => 2.5);
+  my $noise8 = Imager->new(xsize => 300, ysize => 300);
+  $noise8->filter(type => "noise", amount => 255, subtype => 1);
+  for my $case ([ sharp => $sharp8 ], [ noise => $noise8 ]) {
+    my ($name, $im) = @$case;
+    for my $limit ([ 10, 10 ], [ 40, 26 ]) {
+      my ($stddev, $diff) = @$limit;
+      my $exact = $im->copy;
+      ok($exact->filter(type => "gaussian", stddev => $stddev),
+	 "8-bit $name $stddev: exact");
+      my $box = $im->copy;
+      ok($box->filter(type => "gaussian", stddev => $stddev,
+		      method => "box"),
+	 "8-bit $name $stddev: box");
+      is_imaged($box, $exact, $diff/255,
+		"8-bit $name $stddev: within $diff/255");
+    }
+  }
+}
+
+{
+  # small stddev falls back to the exact filter
+  my $exact = test_image()->filter(type => "gaussian2",
+				     stddevX => 2, stddevY => 1);
+  my $box = test_image()->filter(type => "gaussian2",
+				   stddevX => 2, stddevY => 1, method => "box");
+  is_image($box, $exact, "small stddev matches exact");
+}
+
+{
+  # a single axis
+  my $box = test_image()->filter(type => "gaussian2", stddevX => 0,
+				   stddevY => 10, method => "box");
+  ok($box, "blur only in Y");
+  my $row = test_image()->crop(height => 1);
+  my $empty = $row->copy;
+  ok($row->filter(type => "gaussian2", stddevX => 0, stddevY => 10,
+		  method => "box"), "Y blur on a single row");
+  is_image($row, $empty, "single row unchanged by Y blur");
+}
+
+{
+  # tall images use narrower strips for the vertical passes
+  my $tall = Imager->new(xsize => 70, ysize => 40000, channels => 1);
+  $tall->filter(type => "noise", amount => 255, subtype => 1);
+  my $y_blur = $tall->copy;
+  ok($y_blur->filter(type => "gaussian2", stddevX => 0, stddevY => 10,
+		     method => "box"), "blur tall image in Y");
+  my $x_blur = $tall->rotate(right => 90);
+  ok($x_blur->filter(type => "gaussian2", stddevX => 10, stddevY => 0,
+		     method => "box"), "blur rotated image in X");
+  is_image($y_blur, $x_blur->rotate(right => 270),
+	   "narrow strips match the rows");
+}
+
+{
+  # threads split the work without changing the result
+  my $serial = test_image()->filter(type => "gaussian", stddev => 8,
+				      method => "box");
+  Imager->set_thread_count(4);
+  my $threaded = test_image()->filter(type => "gaussian", stddev => 8,
+				        method => "box");
+  Imager->set_thread_count(1);
+  is_image($threaded, $serial, "threaded matches serial");
+
+  # masked images take the unthreaded path
+  my $masked_base = test_image();
+  my $mask = $masked_base->masked;
+  $mask->filter(type => "gaussian", stddev => 8, method => "box");
+  is_image($masked_base, $serial, "masked matches");
+}
+
+{
+  my $im = test_image();
+  ok(!$im->filter(type => "gaussian", stddev => 5, method => "fast"),
+     "unknown method fails");
+  like($im->errstr, qr/method must be exact or box/, "check message");
+  ok(!$im->filter(type => "gaussian2", stddevX => -1, stddevY => 5,
+		  method => "box"),
+     "negative stddev fails");
+  like($im->errstr, qr/stddevX must be positive/, "check message");
+}
+
+done_testing();
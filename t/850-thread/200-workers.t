@@ -0,0 +1,299 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Expr::Assem;
+use Imager::Test qw(test_image test_image_16 test_image_double
+		    is_image is_imaged);
+
+# test that splitting work across worker threads doesn't change the
+# result
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t850workers.log");
+
+is(Imager->get_thread_count, 1, "default thread count is 1");
+ok(!Imager->set_thread_count(0), "can't set thread count to 0");
+like(Imager->errstr, qr/thread count must be positive/, "check message");
+ok(!Imager->set_thread_count(1000), "can't set thread count to 1000");
+like(Imager->errstr, qr/thread count must be at most/, "check message");
+ok(!Imager->set_thread_count("abc"), "can't set thread count to abc");
+is(Imager->get_thread_count, 1, "thread count unchanged");
+
+my @filters =
+  (
+   [ conv => { type => "conv", coef => [ 0.3, 1, 0.3 ] } ],
+   [ sharpen => { type => "conv", coef => [ -0.5, 2, -0.5 ] } ],
+   [ gaussian => { type => "gaussian", stddev => 3 } ],
+   [ gaussian2x => { type => "gaussian2", stddevX => 4, stddevY => 0 } ],
+   [ gaussian2y => { type => "gaussian2", stddevX => 0, stddevY => 4 } ],
+   [ gaussian2 => { type => "gaussian2", stddevX => 1.5, stddevY => 5 } ],
+  );
+
+my @images =
+  (
+   [ "8-bit" => test_image()->scale(scalefactor => 2) ],
+   [ "16-bit" => test_image_16() ],
+   [ "double" => test_image_double() ],
+   [ "paletted" => test_image()->to_paletted ],
+   [ "rgba" => test_image()->convert(preset => "addalpha") ],
+  );
+
+for my $image (@images) {
+  my ($im_name, $im) = @$image;
+  for my $filter (@filters) {
+    my ($name, $opts) = @$filter;
+    ok(Imager->set_thread_count(1), "single thread");
+    my $single = $im->copy->filter(%$opts)
+      or diag("$im_name $name single: ", Imager->errstr);
+    ok(Imager->set_thread_count(4), "four threads");
+    is(Imager->get_thread_count, 4, "check thread count");
+    my $multi = $im->copy->filter(%$opts)
+      or diag("$im_name $name multi: ", Imager->errstr);
+    Imager->set_thread_count(1);
+    if ($im->bits eq "double") {
+      is_imaged($multi, $single, 0, "$im_name $name: threaded result matches");
+    }
+    else {
+      is_image($multi, $single, "$im_name $name: threaded result matches");
+    }
+  }
+}
+
+{
+  # scaling splits output rows (and columns for qtype normal)
+  my @scales =
+    (
+     [ mixing => { xpixels => 57, ypixels => 91, type => "nonprop",
+		   qtype => "mixing" } ],
+     [ mixingx => { xpixels => 57, ypixels => 150, type => "nonprop",
+		    qtype => "mixing" } ],
+     [ mixingy => { xpixels => 150, ypixels => 301, type => "nonprop",
+		    qtype => "mixing" } ],
+     [ normal => { xpixels => 57, ypixels => 91, type => "nonprop",
+		   qtype => "normal" } ],
+     [ normalup => { scalefactor => 2.5, qtype => "normal" } ],
+    );
+  for my $image (@images) {
+    my ($im_name, $im) = @$image;
+    for my $scale (@scales) {
+      my ($name, $opts) = @$scale;
+      Imager->set_thread_count(1);
+      my $single = $im->scale(%$opts)
+	or diag("$im_name $name single: ", Imager->errstr);
+      Imager->set_thread_count(4);
+      my $multi = $im->scale(%$opts)
+	or diag("$im_name $name multi: ", Imager->errstr);
+      Imager->set_thread_count(1);
+      is_imaged($multi, $single, 0, "$im_name scale $name: threaded result matches");
+    }
+  }
+}
+
+{
+  # rotate() and matrix_transform() split output rows
+  my @ops =
+    (
+     [ rotate => sub { $_[0]->rotate(degrees => 10, back => "#00FF0080") } ],
+     [ matrix => sub { $_[0]->matrix_transform(matrix => [ 1, 0.1, 0,
+							   0, 1, 0,
+							   0.001, 0.0005, 1 ]) } ],
+    );
+  for my $image (@images) {
+    my ($im_name, $im) = @$image;
+    for my $op (@ops) {
+      my ($name, $code) = @$op;
+      Imager->set_thread_count(1);
+      my $single = $code->($im)
+	or diag("$im_name $name single: ", Imager->errstr);
+      Imager->set_thread_count(4);
+      my $multi = $code->($im)
+	or diag("$im_name $name multi: ", Imager->errstr);
+      Imager->set_thread_count(1);
+      is_imaged($multi, $single, 0, "$im_name $name: threaded result matches");
+    }
+  }
+}
+
+{
+  # transform2 splits output rows, with and without jumps, and with
+  # widths that don't fill the last batch of pixels
+  my @exprs =
+    (
+     [ gradient => rpnexpr => 'x 255 * w / y 255 * h / x y + 256 % rgb' ],
+     [ getp => rpnexpr => 'x y 10 / sin 5 * + y getp1' ],
+    );
+  my $jumps = <<'EOS';
+var count:n ; var work:n ; var c:p
+count = 0
+loop:
+count = add count 1
+work = lt count x
+jumpnz work loop
+c = rgb count y count
+ret c
+EOS
+  push @exprs, [ jumps => assem => $jumps ];
+  my $im = test_image();
+  for my $expr (@exprs) {
+    my ($name, $type, $code) = @$expr;
+    for my $width (150, 64, 1) {
+      Imager->set_thread_count(1);
+      my $single = Imager::transform2({ $type => $code, width => $width,
+					height => 97 }, $im)
+	or diag("transform2 $name single: ", Imager->errstr);
+      Imager->set_thread_count(4);
+      my $multi = Imager::transform2({ $type => $code, width => $width,
+				       height => 97 }, $im)
+	or diag("transform2 $name multi: ", Imager->errstr);
+      Imager->set_thread_count(1);
+      is_image($multi, $single, "transform2 $name $width: threaded result matches");
+    }
+  }
+}
+
+{
+  # registers keep their values between pixels, so a program that
+  # reads a register before writing it sees the previous pixel's value
+  my $count = <<'EOS';
+var acc:n ; var v:n ; var c:p
+acc = add acc 1
+v = mod acc 251
+c = rgb v y x
+ret c
+EOS
+  my $skip = <<'EOS';
+var acc:n ; var t:n ; var c:p
+t = gt x y
+jumpz t skip
+acc = add acc 1
+skip:
+t = mod acc 256
+c = rgb t x y
+ret c
+EOS
+  # pixels are visited a column at a time
+  for my $test ([ count => $count, 243, 37 ], [ skip => $skip, 69, 0 ]) {
+    my ($name, $code, $last, $mid) = @$test;
+    Imager->set_thread_count(1);
+    my $single = Imager::transform2({ assem => $code, width => 150,
+				      height => 97 })
+      or diag("transform2 $name single: ", Imager->errstr);
+    Imager->set_thread_count(4);
+    my $multi = Imager::transform2({ assem => $code, width => 150,
+				     height => 97 })
+      or diag("transform2 $name multi: ", Imager->errstr);
+    Imager->set_thread_count(1);
+    is_image($multi, $single, "transform2 $name: threaded result matches");
+    is(($single->getpixel(x => 149, y => 96)->rgba)[0], $last,
+       "transform2 $name: last pixel");
+    is(($single->getpixel(x => 75, y => 40)->rgba)[0], $mid,
+       "transform2 $name: middle pixel");
+  }
+}
+
+{
+  # closest colour translation splits rows once the image is large
+  # enough to be worth filling the whole inverse colour map
+  my $big = test_image()->scale(xpixels => 600, ypixels => 500);
+  $big->filter(type => "noise", amount => 30, subtype => 1);
+  my $gray = $big->convert(preset => "gray");
+  for my $test ([ rgb => $big, "mediancut" ], [ rgb => $big, "webmap" ],
+		[ gray => $gray, "mediancut" ]) {
+    my ($im_name, $im, $make) = @$test;
+    my %opts = (make_colors => $make, translate => "closest");
+    Imager->set_thread_count(1);
+    my $single = $im->to_paletted(%opts)
+      or diag("$im_name $make single: ", Imager->errstr);
+    Imager->set_thread_count(4);
+    my $multi = $im->to_paletted(%opts)
+      or diag("$im_name $make multi: ", Imager->errstr);
+    Imager->set_thread_count(1);
+    is(_indexes($multi), _indexes($single),
+       "$im_name $make closest: threaded result matches");
+  }
+}
+
+{
+  # error diffusion runs rows as a wavefront, and must match the
+  # serial result exactly, the images are large enough to use threads
+  my $im = test_image()->scale(xpixels => 600, ypixels => 500);
+  $im->filter(type => "noise", amount => 30, subtype => 1);
+  my $narrow = Imager->new(xsize => 20, ysize => 13200);
+  $narrow->filter(type => "noise", amount => 255, subtype => 1);
+  my $short = Imager->new(xsize => 270000, ysize => 1);
+  $short->filter(type => "noise", amount => 255, subtype => 1);
+  my @maps =
+    (
+     [ floyd => errdiff => "floyd" ],
+     [ jarvis => errdiff => "jarvis" ],
+     [ stucki => errdiff => "stucki" ],
+     # entries at or left of the current pixel on the top row are ignored
+     [ custom => errdiff => "custom", errdiff_width => 4, errdiff_height => 3,
+       errdiff_orig => 1, errdiff_map => [ 5, 9, 3, 2,  1, 3, 6, 2,  0, 2, 1, 1 ] ],
+    );
+  my @images =
+    (
+     [ rgb => $im ],
+     [ gray => $im->convert(preset => "gray") ],
+     [ narrow => $narrow ],
+     [ short => $short ],
+    );
+  for my $image (@images) {
+    my ($im_name, $src) = @$image;
+    for my $map (@maps) {
+      my ($name, @opts) = @$map;
+      for my $make ("webmap", "gray") {
+	my %opts = (make_colors => $make, translate => "errdiff", @opts);
+	Imager->set_thread_count(1);
+	my $single = $src->to_paletted(%opts)
+	  or diag("$im_name $name single: ", Imager->errstr);
+	Imager->set_thread_count(4);
+	my $multi = $src->to_paletted(%opts)
+	  or diag("$im_name $name multi: ", Imager->errstr);
+	Imager->set_thread_count(1);
+	is(_indexes($multi), _indexes($single),
+	   "$im_name $name $make errdiff: threaded result matches");
+      }
+    }
+  }
+}
+
+{
+  # a custom map's origin must be within the top row of the map
+  my $im = test_image()->scale(xpixels => 600, ypixels => 500);
+  $im->filter(type => "noise", amount => 30, subtype => 1);
+  for my $orig (-1 .. 5) {
+    my %opts = (make_colors => "webmap", translate => "errdiff",
+		errdiff => "custom", errdiff_width => 3, errdiff_height => 2,
+		errdiff_orig => $orig, errdiff_map => [ 0, 1, 7, 3, 5, 1 ]);
+    Imager->set_thread_count(1);
+    my $single = $im->to_paletted(%opts);
+    my $single_err = $im->errstr;
+    Imager->set_thread_count(4);
+    my $multi = $im->to_paletted(%opts);
+    my $multi_err = $im->errstr;
+    Imager->set_thread_count(1);
+    if ($orig >= 0 && $orig < 3) {
+      ok($single && $multi, "errdiff_orig $orig: accepted")
+	or diag("errdiff_orig $orig: $single_err / $multi_err");
+      is(_indexes($multi), _indexes($single),
+	 "errdiff_orig $orig: threaded result matches");
+    }
+    else {
+      ok(!$single && !$multi, "errdiff_orig $orig: rejected");
+      is($multi_err, "errdiff_orig must be from 0 to 2",
+	 "errdiff_orig $orig: check message");
+    }
+  }
+}
+
+done_testing();
+
+sub _indexes {
+  my ($im) = @_;
+
+  return join "", map pack("C*", $im->getscanline(y => $_, type => "index")),
+    0 .. $im->getheight - 1;
+}
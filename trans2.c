@@ -1,4 +1,5 @@
 #include "imager.h"
+#include "imageri.h"
 #include "regmach.h"
 
 /*
@@ -26,6 +27,127 @@ trans2.c - entry point for the general transformation engine
 This (short) file implements the transform2() function, just iterating 
 over the image - most of the work is done in L<regmach.c>
 
+The program is compiled once with i_rm_compile(), and the output is
+produced a row at a time, written with a single i_plin() call.
+Programs without jumps are run for a batch of pixels at once with
+i_rm_prog_run_lanes(), others are run a pixel at a time.
+
+Registers keep their values from one pixel to the next.  Most
+programs write every register before reading it, and for those rows
+are split across the context's worker threads when the input images
+allow it.  Programs that can read a register before writing it see
+the value left by the previous pixel, so they're run a pixel at a
+time, in column order, with a single set of registers.
+
+=over
+
+=cut
+*/
+
+typedef struct {
+  const i_rm_prog *prog;
+  i_img *out;
+  i_img **in_imgs;
+} trans2_state;
+
+/*
+=item trans2_band(state, start_y, end_y)
+
+Produce rows C<start_y> to C<end_y>-1 of the output image, with a
+private set of registers.
+
+=cut
+*/
+
+static void
+trans2_band(void *p, i_img_dim start_y, i_img_dim end_y) {
+  trans2_state *state = p;
+  const i_rm_prog *prog = state->prog;
+  i_img_dim width = state->out->xsize;
+  i_color *line = im_band_alloc(sizeof(i_color) * width);
+  i_img_dim x, y;
+
+  if (prog->has_jumps) {
+    double *n_regs = im_band_alloc(sizeof(double) * prog->n_regs_count);
+    i_color *c_regs = im_band_alloc(sizeof(i_color) * (prog->c_regs_count + 1));
+
+    memcpy(n_regs, prog->n_regs, sizeof(double) * prog->n_regs_count);
+    memcpy(c_regs, prog->c_regs, sizeof(i_color) * prog->c_regs_count);
+    for (y = start_y; y < end_y; ++y) {
+      n_regs[1] = y;
+      for (x = 0; x < width; ++x) {
+	n_regs[0] = x;
+	line[x] = i_rm_prog_run(prog, n_regs, c_regs, state->in_imgs);
+      }
+      i_plin(state->out, 0, width, y, line);
+    }
+    im_band_free(n_regs);
+    im_band_free(c_regs);
+  }
+  else {
+    double *n_lanes = im_band_alloc(sizeof(double) * prog->n_regs_count * RM_LANES);
+    i_color *c_lanes = im_band_alloc(sizeof(i_color) * (prog->c_regs_count + 1) * RM_LANES);
+
+    i_rm_prog_init_lanes(prog, n_lanes, c_lanes);
+    for (y = start_y; y < end_y; ++y) {
+      for (x = 0; x < width; x += RM_LANES) {
+	int count = width - x < RM_LANES ? width - x : RM_LANES;
+	int i;
+	for (i = 0; i < count; ++i) {
+	  n_lanes[i] = x + i;
+	  n_lanes[RM_LANES + i] = y;
+	}
+	i_rm_prog_run_lanes(prog, n_lanes, c_lanes, count, state->in_imgs,
+			    line + x);
+      }
+      i_plin(state->out, 0, width, y, line);
+    }
+    im_band_free(n_lanes);
+    im_band_free(c_lanes);
+  }
+
+  im_band_free(line);
+}
+
+/*
+=item trans2_serial(state)
+
+Produce the whole output image a pixel at a time, column by column,
+with a single set of registers, for programs that depend on the
+register values left by the previous pixel.
+
+=cut
+*/
+
+static void
+trans2_serial(trans2_state *state) {
+  const i_rm_prog *prog = state->prog;
+  i_img *out = state->out;
+  double *n_regs = mymalloc(sizeof(double) * prog->n_regs_count);
+  i_color *c_regs = mymalloc(sizeof(i_color) * (prog->c_regs_count + 1));
+  i_img_dim x, y;
+
+  memcpy(n_regs, prog->n_regs, sizeof(double) * prog->n_regs_count);
+  memcpy(c_regs, prog->c_regs, sizeof(i_color) * prog->c_regs_count);
+  for (x = 0; x < out->xsize; ++x) {
+    for (y = 0; y < out->ysize; ++y) {
+      i_color val;
+      n_regs[0] = x;
+      n_regs[1] = y;
+      val = i_rm_prog_run(prog, n_regs, c_regs, state->in_imgs);
+      i_ppix(out, x, y, &val);
+    }
+  }
+  myfree(n_regs);
+  myfree(c_regs);
+}
+
+/*
+=item i_transform2(width, height, channels, ops, ops_count, n_regs, n_regs_count, c_regs, c_regs_count, in_imgs, in_imgs_count)
+
+Create a new image by running the register machine program C<ops>
+for every pixel.
+
 =cut
 */
 
@@ -36,49 +158,72 @@ i_img* i_transform2(i_img_dim width, i_img_dim height, int channels,
 		    i_img **in_imgs, int in_imgs_count)
 {
   i_img *new_img;
-  i_img_dim x, y;
-  i_color val;
+  i_rm_prog *prog;
+  trans2_state state;
+  int threaded;
   int i;
-  int need_images;
 
   i_clear_error();
+
+  if (n_regs_count < 2) {
+    i_push_error(0, "transform2: at least 2 numeric registers required");
+    return NULL;
+  }
+
+  prog = i_rm_compile(ops, ops_count, n_regs, n_regs_count,
+		      c_regs, c_regs_count);
+  if (!prog)
+    return NULL;
   
   /* since the number of images is variable and the image numbers
      for getp? are fixed, we can check them here instead of in the 
      register machine - this will help performance */
-  need_images = 0;
-  for (i = 0; i < ops_count; ++i) {
-    switch (ops[i].code) {
-    case rbc_getp1:
-    case rbc_getp2:
-    case rbc_getp3:
-      if (ops[i].code - rbc_getp1 + 1 > need_images) {
-        need_images = ops[i].code - rbc_getp1 + 1;
-      }
-    }
-  }
-  
-  if (need_images > in_imgs_count) {
+  if (prog->need_images > in_imgs_count) {
     i_push_errorf(0, "not enough images, code requires %d, %d supplied", 
-                  need_images, in_imgs_count);
+                  prog->need_images, in_imgs_count);
+    i_rm_prog_free(prog);
     return NULL;
   }
 
   new_img = i_img_empty_ch(NULL, width, height, channels);
-  for (x = 0; x < width; ++x) {
-    for (y = 0; y < height; ++y) {
-      n_regs[0] = x;
-      n_regs[1] = y;
-      val = i_rm_run(ops, ops_count, n_regs, n_regs_count, c_regs, c_regs_count, 
-		   in_imgs, in_imgs_count);
-      i_ppix(new_img, x, y, &val);
-    }
+  if (!new_img) {
+    i_rm_prog_free(prog);
+    return NULL;
   }
+
+  /* print must write in order, and the inputs must be safe to read
+     from several threads */
+  threaded = 1;
+  for (i = 0; i < ops_count; ++i) {
+    if (ops[i].code == rbc_print)
+      threaded = 0;
+  }
+  for (i = 0; i < prog->need_images; ++i) {
+    if (!i_img_band_safe(in_imgs[i]))
+      threaded = 0;
+  }
+
+  state.prog = prog;
+  state.out = new_img;
+  state.in_imgs = in_imgs;
+  if (prog->keeps_state) {
+    trans2_serial(&state);
+  }
+  else if (threaded) {
+    im_run_bands(new_img->context, 0, height, trans2_band, &state);
+  }
+  else {
+    trans2_band(&state, 0, height);
+  }
+
+  i_rm_prog_free(prog);
   
   return new_img;
 }
 
 /*
+=back
+
 =head1 AUTHOR
 
 Tony Cook <tony@develop-help.com>
@@ -0,0 +1,36 @@
+/*
+  worker pool for builds without thread support, bands are always
+  processed on the calling thread
+*/
+
+#define IMAGER_NO_CONTEXT
+#include "imageri.h"
+
+/* documented in workpthr.c */
+
+void
+im_workers_destroy(im_workers_t *w) {
+  (void)w;
+}
+
+void
+im_run_bands(pIMCTX, i_img_dim start, i_img_dim end,
+	     im_band_func_t func, void *data) {
+  (void)aIMCTX;
+
+  func(data, start, end);
+}
+
+void
+im_run_wavefront(pIMCTX, i_img_dim width, i_img_dim height,
+		 i_img_dim step, i_img_dim lead, im_wave_func_t func,
+		 void *data) {
+  i_img_dim x, y;
+  (void)aIMCTX;
+  (void)lead;
+
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; x += step)
+      func(data, y, x, x + step < width ? x + step : width);
+  }
+}
@@ -0,0 +1,413 @@
+/*
+=head1 NAME
+
+workpthr.c - pthreads worker pool for splitting image processing into bands
+
+=head1 SYNOPSIS
+
+  static void
+  do_band(void *p, i_img_dim start_y, i_img_dim end_y) {
+    ... process rows start_y to end_y-1 ...
+  }
+
+  im_run_bands(aIMCTX, 0, im->ysize, do_band, &state);
+
+=head1 DESCRIPTION
+
+Each context owns a pool of worker threads, created the first time
+work is split across threads and resized if the context thread count
+changes.
+
+The calling thread takes part in the work, so a thread count of N
+creates N-1 worker threads.
+
+Work is handed out in chunks of rows from a shared counter, so bands
+that take different amounts of time still balance across the threads.
+
+Band functions run on the worker threads, so they must not push
+errors, log, allocate with mymalloc() or call back into perl, and they
+must only write to the rows they're given.  Use im_band_alloc() and
+im_band_free() for working memory.
+
+=over
+
+=cut
+*/
+
+#define IMAGER_NO_CONTEXT
+#include "imageri.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+/* number of chunks each thread should get, more means better balance
+   but more lock traffic */
+#define CHUNKS_PER_THREAD 4
+
+struct im_workers_tag {
+  pthread_mutex_t mutex;
+
+  /* signalled when a new job is posted or the pool is shutting down */
+  pthread_cond_t work_cond;
+
+  /* signalled when the last running chunk of a job completes */
+  pthread_cond_t done_cond;
+
+  /* the thread count requested and the total threads actually
+     available, including the caller */
+  int requested;
+  int thread_count;
+  int worker_count;
+  pthread_t *threads;
+
+  /* the process that created the threads */
+  pid_t pid;
+
+  int quit;
+  int busy;
+
+  /* the current job */
+  unsigned long job_id;
+  im_band_func_t func;
+  void *data;
+  i_img_dim next;
+  i_img_dim end;
+  i_img_dim chunk;
+
+  /* number of chunks currently being processed */
+  int running;
+};
+
+/* called with the mutex held, returns with the mutex held */
+static void
+run_chunks(im_workers_t *w) {
+  while (w->next < w->end) {
+    im_band_func_t func = w->func;
+    void *data = w->data;
+    i_img_dim start = w->next;
+    i_img_dim end = start + w->chunk;
+
+    if (end > w->end)
+      end = w->end;
+    w->next = end;
+    ++w->running;
+
+    pthread_mutex_unlock(&w->mutex);
+    func(data, start, end);
+    pthread_mutex_lock(&w->mutex);
+
+    if (--w->running == 0 && w->next >= w->end)
+      pthread_cond_broadcast(&w->done_cond);
+  }
+}
+
+static void *
+worker_main(void *p) {
+  im_workers_t *w = p;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&w->mutex);
+  while (1) {
+    while (!w->quit && w->job_id == seen)
+      pthread_cond_wait(&w->work_cond, &w->mutex);
+    if (w->quit)
+      break;
+    seen = w->job_id;
+    run_chunks(w);
+  }
+  pthread_mutex_unlock(&w->mutex);
+
+  return NULL;
+}
+
+static im_workers_t *
+workers_new(int thread_count) {
+  im_workers_t *w = malloc(sizeof(im_workers_t));
+  sigset_t all, old;
+  int i;
+
+  if (!w)
+    return NULL;
+
+  w->threads = malloc(sizeof(pthread_t) * (thread_count - 1));
+  if (!w->threads) {
+    free(w);
+    return NULL;
+  }
+  if (pthread_mutex_init(&w->mutex, NULL) != 0) {
+    free(w->threads);
+    free(w);
+    return NULL;
+  }
+  pthread_cond_init(&w->work_cond, NULL);
+  pthread_cond_init(&w->done_cond, NULL);
+  w->pid = getpid();
+  w->requested = thread_count;
+  w->quit = 0;
+  w->busy = 0;
+  w->job_id = 0;
+  w->func = NULL;
+  w->data = NULL;
+  w->next = w->end = 0;
+  w->chunk = 1;
+  w->running = 0;
+
+  /* signals should only be delivered to the perl thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  w->worker_count = 0;
+  for (i = 0; i < thread_count - 1; ++i) {
+    if (pthread_create(w->threads + i, NULL, worker_main, w) != 0)
+      break;
+    ++w->worker_count;
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  /* if we couldn't create all the threads, make do with what we have */
+  w->thread_count = w->worker_count + 1;
+
+  return w;
+}
+
+/*
+=item im_workers_destroy(workers)
+
+Stop the worker threads and release the pool.
+
+Called when the owning context is released.
+
+=cut
+*/
+
+void
+im_workers_destroy(im_workers_t *w) {
+  int i;
+
+  if (!w)
+    return;
+
+  if (w->pid != getpid()) {
+    /* we're in a forked child, the threads don't exist here and the
+       mutex may have been held by one of them at the fork */
+    free(w->threads);
+    free(w);
+    return;
+  }
+
+  pthread_mutex_lock(&w->mutex);
+  w->quit = 1;
+  pthread_cond_broadcast(&w->work_cond);
+  pthread_mutex_unlock(&w->mutex);
+
+  for (i = 0; i < w->worker_count; ++i)
+    pthread_join(w->threads[i], NULL);
+
+  pthread_cond_destroy(&w->work_cond);
+  pthread_cond_destroy(&w->done_cond);
+  pthread_mutex_destroy(&w->mutex);
+  free(w->threads);
+  free(w);
+}
+
+/* fetch the pool for the context, creating or resizing it as needed */
+static im_workers_t *
+context_workers(pIMCTX) {
+  im_workers_t *w = aIMCTX->workers;
+
+  if (w && (w->pid != getpid() || w->requested != aIMCTX->thread_count)) {
+    im_workers_destroy(w);
+    w = aIMCTX->workers = NULL;
+  }
+
+  if (!w)
+    w = aIMCTX->workers = workers_new(aIMCTX->thread_count);
+
+  return w;
+}
+
+/*
+=item im_run_bands(ctx, start, end, func, data)
+
+Call C<func(data, band_start, band_end)> for bands of rows covering
+C<start> to C<end>-1, spread across the context's worker threads.
+
+If the context thread count is 1, the pool cannot be created, or the
+pool is already in use, C<func> is called once for the whole range on
+the calling thread.
+
+Returns when all of the bands have been processed.
+
+=cut
+*/
+
+void
+im_run_bands(pIMCTX, i_img_dim start, i_img_dim end,
+	     im_band_func_t func, void *data) {
+  im_workers_t *w;
+  i_img_dim chunk;
+
+  if (aIMCTX->thread_count <= 1 || end - start < 2
+      || (w = context_workers(aIMCTX)) == NULL || w->worker_count == 0) {
+    func(data, start, end);
+    return;
+  }
+
+  pthread_mutex_lock(&w->mutex);
+  if (w->busy) {
+    /* a band function tried to use the pool */
+    pthread_mutex_unlock(&w->mutex);
+    func(data, start, end);
+    return;
+  }
+
+  chunk = (end - start + w->thread_count * CHUNKS_PER_THREAD - 1)
+    / (w->thread_count * CHUNKS_PER_THREAD);
+  w->busy = 1;
+  w->func = func;
+  w->data = data;
+  w->next = start;
+  w->end = end;
+  w->chunk = chunk;
+  ++w->job_id;
+  pthread_cond_broadcast(&w->work_cond);
+
+  run_chunks(w);
+  while (w->running)
+    pthread_cond_wait(&w->done_cond, &w->mutex);
+
+  w->func = NULL;
+  w->data = NULL;
+  w->busy = 0;
+  pthread_mutex_unlock(&w->mutex);
+}
+
+typedef struct {
+  pthread_mutex_t mutex;
+
+  /* signalled when a row makes progress */
+  pthread_cond_t cond;
+
+  i_img_dim width;
+  i_img_dim height;
+  i_img_dim step;
+  i_img_dim lead;
+  im_wave_func_t func;
+  void *data;
+
+  /* the next row to hand out */
+  i_img_dim next;
+
+  /* number of columns finished in each row */
+  i_img_dim *done;
+} wave_state;
+
+/* process every segment on the calling thread */
+static void
+wave_serial(i_img_dim width, i_img_dim height, i_img_dim step,
+	    im_wave_func_t func, void *data) {
+  i_img_dim x, y;
+
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; x += step)
+      func(data, y, x, x + step < width ? x + step : width);
+  }
+}
+
+/* run as a band function on each thread, taking rows in order until
+   they run out */
+static void
+wave_band(void *p, i_img_dim start, i_img_dim end) {
+  wave_state *state = p;
+  (void)start;
+  (void)end;
+
+  pthread_mutex_lock(&state->mutex);
+  while (state->next < state->height) {
+    i_img_dim y = state->next++;
+    i_img_dim x, x_end;
+
+    for (x = 0; x < state->width; x = x_end) {
+      x_end = x + state->step;
+      if (x_end > state->width)
+	x_end = state->width;
+      if (y > 0) {
+	i_img_dim need = x_end + state->lead;
+	if (need > state->width)
+	  need = state->width;
+	while (state->done[y-1] < need)
+	  pthread_cond_wait(&state->cond, &state->mutex);
+      }
+      pthread_mutex_unlock(&state->mutex);
+
+      state->func(state->data, y, x, x_end);
+
+      pthread_mutex_lock(&state->mutex);
+      state->done[y] = x_end;
+      pthread_cond_broadcast(&state->cond);
+    }
+  }
+  pthread_mutex_unlock(&state->mutex);
+}
+
+/*
+=item im_run_wavefront(ctx, width, height, step, lead, func, data)
+
+Call C<func(data, y, x_start, x_end)> for segments of up to C<step>
+columns covering every row from 0 to C<height>-1, for work where each
+row depends on the rows above it.
+
+Segments within a row are processed in order, and a segment isn't
+started until the row above has finished C<lead> columns past the end
+of the segment, so the rows proceed as a diagonal wavefront across
+the worker threads.
+
+Rows are handed out in order, so at most thread count rows are in
+progress at once and every row before those is finished.
+
+=cut
+*/
+
+void
+im_run_wavefront(pIMCTX, i_img_dim width, i_img_dim height,
+		 i_img_dim step, i_img_dim lead, im_wave_func_t func,
+		 void *data) {
+  wave_state state;
+
+  if (aIMCTX->thread_count <= 1 || height < 2
+      || (state.done = malloc(sizeof(i_img_dim) * height)) == NULL) {
+    wave_serial(width, height, step, func, data);
+    return;
+  }
+  if (pthread_mutex_init(&state.mutex, NULL) != 0) {
+    free(state.done);
+    wave_serial(width, height, step, func, data);
+    return;
+  }
+  pthread_cond_init(&state.cond, NULL);
+  memset(state.done, 0, sizeof(i_img_dim) * height);
+  state.width = width;
+  state.height = height;
+  state.step = step;
+  state.lead = lead;
+  state.func = func;
+  state.data = data;
+  state.next = 0;
+
+  im_run_bands(aIMCTX, 0, aIMCTX->thread_count, wave_band, &state);
+
+  pthread_cond_destroy(&state.cond);
+  pthread_mutex_destroy(&state.mutex);
+  free(state.done);
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+worknull.c, context.c
+
+=cut
+*/